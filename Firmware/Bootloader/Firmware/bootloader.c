@@ -27,10 +27,159 @@ _CONFIG4(DSBOREN_OFF & DSWDTEN_OFF & DSSWEN_ON & RTCBAT_ON & PLLDIV_NODIV & I2C2
 #define WRITE_FLASH 3
 #define ERASE_FLASH 4
 #define START_USER  6
+#define GET_VERSION 7
+
+#define BOOTLOADER_VERSION  2
+
+// Bulk commands received on EP1 OUT.  Each command starts with an 8-byte
+// header (command, reserved, TBLPAG, offset, and instruction count, with the
+// 16-bit fields sent least-significant byte first); BULK_WRITE_ROW is followed
+// by a full row of instructions packed three bytes each.  Every command is
+// answered with a 4-byte reply on EP1 IN (the CRC for BULK_CRC, a status for
+// the others).
+#define BULK_WRITE_ROW  1
+#define BULK_CRC        2
+#define BULK_ERASE_PAGE 3
+
+#define BULK_OK         0
+#define BULK_ERROR      1
+
+#define ROW_INSTRUCTIONS    64
+#define ROW_BYTES           (3*ROW_INSTRUCTIONS)
+#define BULK_HEADER_LENGTH  8
+#define BULK_BUFFER_LENGTH  (BULK_HEADER_LENGTH+ROW_BYTES+MAX_PACKET_SIZE)
 
 BYTE BOOT_QUIT;
 WORD32 BOOT_COUNTDOWN;
 
+BYTE BULK_buffer[BULK_BUFFER_LENGTH];
+BYTE EP1_IN_buffer[4];
+unsigned int BULK_count;
+
+const unsigned long __attribute__ ((space(auto_psv))) CRC32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+void ErasePage(unsigned int page, unsigned int offset) {
+    unsigned int temp;
+
+    NVMCON = 0x4042;                // set up NVMCON to erase a page of program memory
+    temp = TBLPAG;                  // save the value of TBLPAG
+    TBLPAG = page;
+    __builtin_tblwtl(offset, 0x0000);
+    __asm__("DISI #16");            // disable interrupts for 16 cycles
+    __builtin_write_NVM();          // issue the unlock sequence and perform the write
+    while (NVMCONbits.WR==1) {}     // wait until the write is complete
+    NVMCONbits.WREN = 0;            // disable further writes to program memory
+    TBLPAG = temp;                  // restore original value to TBLPAG
+}
+
+// Program num instructions starting at page:offset from data, taking each
+// instruction from the first three bytes of every stride bytes; the rest of
+// the row containing offset is left blank
+void WriteRow(unsigned int page, unsigned int offset, BYTE *data, unsigned int num, unsigned int stride) {
+    unsigned int temp, row, i;
+    WORD word;
+
+    NVMCON = 0x4001;                // set up NVMCON to program a row of program memory
+    temp = TBLPAG;                  // save the value of TBLPAG
+    TBLPAG = page;
+    row = offset&0xFF80;
+    for (i = 0; i<128; i += 2) {
+        __builtin_tblwtl(row + i, 0xFFFF);
+        __builtin_tblwth(row + i + 1, 0x00FF);
+    }
+    for (i = 0; i<num; i++, offset += 2, data += stride) {
+        word.b[0] = data[0];
+        word.b[1] = data[1];
+        __builtin_tblwtl(offset, word.w);
+        __builtin_tblwth(offset, (unsigned int)data[2]);
+    }
+    __asm__("DISI #16");            // disable interrupts for 16 cycles
+    __builtin_write_NVM();          // issue the unlock sequence and perform the write
+    while (NVMCONbits.WR==1) {}     // wait until the write is done
+    NVMCONbits.WREN = 0;            // disable further writes to program memory
+    TBLPAG = temp;                  // restore original value to TBLPAG
+}
+
+// Compute the CRC-32 (as computed by zlib.crc32) of num instructions starting
+// at page:offset, each taken as three bytes, least-significant byte first
+unsigned long CRCFlash(unsigned int page, unsigned int offset, unsigned int num) {
+    unsigned int temp, i, j;
+    unsigned long crc, data;
+
+    temp = TBLPAG;                  // save the value of TBLPAG
+    TBLPAG = page;
+    crc = 0xFFFFFFFF;
+    for (i = 0; i<num; i++) {
+        data = ((unsigned long)__builtin_tblrdh(offset)<<16)|__builtin_tblrdl(offset);
+        for (j = 0; j<6; j++) {     // process the three bytes a nibble at a time
+            crc = (crc>>4)^CRC32_table[(crc^data)&0x0F];
+            data >>= 4;
+        }
+        offset += 2;
+        if (offset==0)
+            TBLPAG++;
+    }
+    TBLPAG = temp;                  // restore original value to TBLPAG
+    return ~crc;
+}
+
+// Called on SET_CONFIGURATION to set up the bulk endpoint pair on EP1
+void ConfigureEndpoints(void) {
+    U1EP1 = ENDPT_NON_CONTROL;
+    BULK_count = 0;
+    BD[EP1OUT].bytecount = MAX_PACKET_SIZE;
+    BD[EP1OUT].address = BULK_buffer;       // EP1 OUT packets are gathered into the bulk command buffer
+    BD[EP1OUT].status = 0x88;               // set UOWN bit (USB can write), expect DATA0
+    BD[EP1IN].address = EP1_IN_buffer;      // EP1 IN gets a buffer
+    BD[EP1IN].status = 0x48;                // clear UOWN bit (MCU can write), so the first reply goes as DATA0
+}
+
+void BulkOut(void) {
+    WORD32 reply;
+    unsigned int page, offset, num;
+
+    BULK_count += USB_buffer_desc.bytecount;
+    if ((USB_buffer_desc.bytecount==MAX_PACKET_SIZE) && (BULK_count<=BULK_HEADER_LENGTH+ROW_BYTES)) {
+        BD[EP1OUT].address = BULK_buffer + BULK_count;  // a full packet, so the command continues in the next one
+    } else {                                            // a short packet ends the command
+        page = BULK_buffer[2]|(BULK_buffer[3]<<8);
+        offset = BULK_buffer[4]|(BULK_buffer[5]<<8);
+        num = BULK_buffer[6]|(BULK_buffer[7]<<8);
+        reply.ul = BULK_OK;
+        switch ((BULK_count>=BULK_HEADER_LENGTH) ? BULK_buffer[0]:0) {
+            case BULK_WRITE_ROW:
+                if ((BULK_count==BULK_HEADER_LENGTH+ROW_BYTES) && !(offset&0x7F))
+                    WriteRow(page, offset, BULK_buffer + BULK_HEADER_LENGTH, ROW_INSTRUCTIONS, 3);
+                else
+                    reply.ul = BULK_ERROR;
+                break;
+            case BULK_CRC:
+                reply.ul = CRCFlash(page, offset, num);
+                break;
+            case BULK_ERASE_PAGE:
+                ErasePage(page, offset);
+                break;
+            default:
+                reply.ul = BULK_ERROR;
+        }
+        EP1_IN_buffer[0] = reply.b[0];
+        EP1_IN_buffer[1] = reply.b[1];
+        EP1_IN_buffer[2] = reply.b[2];
+        EP1_IN_buffer[3] = reply.b[3];
+        BD[EP1IN].bytecount = 4;
+        BD[EP1IN].status = ((BD[EP1IN].status^0x40)&0x40)|0x88;    // toggle the DATA01 bit, clear the PIDs bits, and set the UOWN and DTS bits
+        BULK_count = 0;
+        BD[EP1OUT].address = BULK_buffer;
+    }
+    BD[EP1OUT].bytecount = MAX_PACKET_SIZE;
+    BD[EP1OUT].status = ((USB_buffer_desc.status^0x40)&0x40)|0x88;    // expect the opposite DATA01 value next, set the UOWN and DTS bits
+}
+
 //void ClassRequests(void) {
 //    switch (USB_setup.bRequest) {
 //        default:
@@ -66,15 +215,7 @@ void VendorRequests(void) {
             USB_request.setup.wLength.w = USB_setup.wLength.w;
             break;
         case ERASE_FLASH:
-            NVMCON = 0x4042;                // set up NVMCON to erase a page of program memory
-            temp = TBLPAG;                  // save the value of TBLPAG
-            TBLPAG = USB_setup.wValue.w;
-            __builtin_tblwtl(USB_setup.wIndex.w, 0x0000);
-            __asm__("DISI #16");            // disable interrupts for 16 cycles
-            __builtin_write_NVM();          // issue the unlock sequence and perform the write
-            while (NVMCONbits.WR==1) {}     // wait until the write is complete
-            NVMCONbits.WREN = 0;            // disable further writes to program memory
-            TBLPAG = temp;                  // restore original value to TBLPAG
+            ErasePage(USB_setup.wValue.w, USB_setup.wIndex.w);
             BD[EP0IN].bytecount = 0x00;     // set EP0 IN byte count to 0
             BD[EP0IN].status = 0xC8;        // send packet as DATA1, set UOWN bit
             break;
@@ -85,6 +226,11 @@ void VendorRequests(void) {
             BD[EP0IN].bytecount = 0x00;     // set EP0 IN byte count to 0
             BD[EP0IN].status = 0xC8;        // send packet as DATA1, set UOWN bit
             break;
+        case GET_VERSION:
+            BD[EP0IN].address[0] = BOOTLOADER_VERSION;
+            BD[EP0IN].bytecount = 0x01;     // set EP0 IN byte count to 1
+            BD[EP0IN].status = 0xC8;        // send packet as DATA1, set UOWN bit
+            break;
         default:
             USB_error_flags |= 0x01;        // set Request Error Flag
     }
@@ -98,32 +244,9 @@ void VendorRequestsIn(void) {
 }
 
 void VendorRequestsOut(void) {
-    unsigned int temp, row, i;
-    WORD data;
-
     switch (USB_request.setup.bRequest) {
         case WRITE_FLASH:
-            NVMCON = 0x4001;                // set up NVMCON to program a row of program memory
-            temp = TBLPAG;                  // save the value of TBLPAG
-            TBLPAG = USB_request.setup.wValue.w;
-            row = USB_request.setup.wIndex.w&0xFFF8;
-            for (i = 0; i<128; i += 2) {
-                __builtin_tblwtl(row + i, 0xFFFF);
-                __builtin_tblwth(row + i + 1, 0x00FF);
-            }
-            for (i = 0; i<USB_request.setup.wLength.w; USB_request.setup.wIndex.w += 2) {
-                data.b[0] = BD[EP0OUT].address[i++];
-                data.b[1] = BD[EP0OUT].address[i++];
-                __builtin_tblwtl(USB_request.setup.wIndex.w, data.w);
-                data.b[0] = BD[EP0OUT].address[i++];
-                data.b[1] = BD[EP0OUT].address[i++];
-                __builtin_tblwth(USB_request.setup.wIndex.w, data.w);
-            }
-            __asm__("DISI #16");            // disable interrupts for 16 cycles
-            __builtin_write_NVM();          // issue the unlock sequence and perform the write
-            while (NVMCONbits.WR==1) {}     // wait until the write is done
-            NVMCONbits.WREN = 0;            // disable further writes to program memory
-            TBLPAG = temp;                  // restore original value to TBLPAG
+            WriteRow(USB_request.setup.wValue.w, USB_request.setup.wIndex.w, BD[EP0OUT].address, USB_request.setup.wLength.w>>2, 4);
             break;
         default:
             USB_error_flags |= 0x01;                    // set Request Error Flag
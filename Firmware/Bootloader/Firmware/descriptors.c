@@ -25,7 +25,7 @@ BYTE __attribute__ ((space(auto_psv))) Device[] = {
 BYTE __attribute__ ((space(auto_psv))) Configuration1[] = {
     0x09,       // bLength
     CONFIGURATION,    // bDescriptorType
-    0x12,       // wTotalLength (low byte)
+    0x20,       // wTotalLength (low byte)
     0x00,       // wTotalLength (high byte)
     NUM_INTERFACES,   // bNumInterfaces
     0x01,       // bConfigurationValue
@@ -36,11 +36,25 @@ BYTE __attribute__ ((space(auto_psv))) Configuration1[] = {
     INTERFACE,  // bDescriptorType
     0x00,       // bInterfaceNumber
     0x00,       // bAlternateSetting
-    0x00,       // bNumEndpoints (excluding EP0)
+    0x02,       // bNumEndpoints (excluding EP0)
     0xFF,       // bInterfaceClass (vendor specific class code)
     0x00,       // bInterfaceSubClass
     0xFF,       // bInterfaceProtocol (vendor specific protocol used)
-    0x00        // iInterface (none)
+    0x00,       // iInterface (none)
+    0x07,       // bLength (Endpoint1 OUT descriptor starts here)
+    ENDPOINT,   // bDescriptorType
+    0x01,       // bEndpointAddress (EP1 OUT)
+    0x02,       // bmAttributes (bulk)
+    MAX_PACKET_SIZE,    // wMaxPacketSize (low byte)
+    0x00,       // wMaxPacketSize (high byte)
+    0x00,       // bInterval (ignored for bulk endpoints)
+    0x07,       // bLength (Endpoint1 IN descriptor starts here)
+    ENDPOINT,   // bDescriptorType
+    0x81,       // bEndpointAddress (EP1 IN)
+    0x02,       // bmAttributes (bulk)
+    MAX_PACKET_SIZE,    // wMaxPacketSize (low byte)
+    0x00,       // wMaxPacketSize (high byte)
+    0x00        // bInterval (ignored for bulk endpoints)
 };
 
 BYTE __attribute__ ((space(auto_psv))) String0[] = {
@@ -382,6 +382,7 @@ void StandardRequests(void) {
                         break;
                     default:
                         USB_USWSTAT = CONFIG_STATE;
+                        ConfigureEndpoints();   // set up the endpoints used by this configuration
 #ifdef SHOW_ENUM_STATUS
                         PORTB &= 0xE0;
                         PORTBbits.RB3 = 1;
@@ -490,6 +491,9 @@ void ProcessOutToken(void) {
             BD[EP0IN].bytecount = 0x00;      // set EP0 IN byte count to 0
             BD[EP0IN].status = 0xC8;         // send packet as DATA1, set UOWN bit
             break;
+        case EP1:
+            BulkOut();
+            break;
     }
 }
 
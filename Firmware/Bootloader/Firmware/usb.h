@@ -213,5 +213,7 @@ extern void SendDataPacket(void);
 extern void VendorRequests(void);
 extern void VendorRequestsIn(void);
 extern void VendorRequestsOut(void);
+extern void ConfigureEndpoints(void);
+extern void BulkOut(void);
 
 #endif
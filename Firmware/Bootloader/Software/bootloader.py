@@ -8,6 +8,12 @@ class bootloader:
         self.WRITE_FLASH = 3
         self.ERASE_FLASH = 4
         self.START_USER = 6
+        self.GET_VERSION = 7
+        self.BULK_WRITE_ROW = 1
+        self.BULK_CRC = 2
+        self.BULK_ERASE_PAGE = 3
+        self.BULK_OUT = 0x01
+        self.BULK_IN = 0x81
         self.dev = usb.core.find(idVendor = 0x6666, idProduct = 0x4321)
         if self.dev is None:
             print('No USB device found matching idVendor = 0x6666 and idProduct = 0x4321.')
@@ -45,3 +51,30 @@ class bootloader:
             self.dev.ctrl_transfer(0x40, self.START_USER, 0, 2)
         except usb.core.USBError:
             print('Unable to send START_USER vendor request.')
+
+    def get_version(self):
+        try:
+            ret = self.dev.ctrl_transfer(0xC0, self.GET_VERSION, 0, 0, 1)
+        except usb.core.USBError:
+            return 1    # bootloaders predating GET_VERSION stall the request
+        else:
+            return int(ret[0])
+
+    def bulk_command(self, command, address, num_instructions, data = None):
+        header = [command, 0, (address >> 16) & 0xFF, address >> 24, address & 0xFF, (address >> 8) & 0xFF, num_instructions & 0xFF, num_instructions >> 8]
+        try:
+            self.dev.write(self.BULK_OUT, header + (list(data) if data is not None else []))
+            ret = self.dev.read(self.BULK_IN, 4)
+        except usb.core.USBError:
+            print('Unable to send bulk command {0:d}.'.format(command))
+        else:
+            return int(ret[0]) + (int(ret[1]) << 8) + (int(ret[2]) << 16) + (int(ret[3]) << 24)
+
+    def write_row(self, address, data):
+        return self.bulk_command(self.BULK_WRITE_ROW, address, len(data) // 3, data)
+
+    def erase_page(self, address):
+        return self.bulk_command(self.BULK_ERASE_PAGE, address, 0)
+
+    def crc_flash(self, address, num_instructions):
+        return self.bulk_command(self.BULK_CRC, address, num_instructions)
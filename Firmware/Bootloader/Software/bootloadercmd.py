@@ -1,6 +1,6 @@
 #!/usr/bin/env python3
 
-import os, sys
+import os, sys, zlib
 import bootloader
 
 class bootloadercmd:
@@ -58,6 +58,7 @@ class bootloadercmd:
         self.display_bootloader = False
 
         self.connected = False
+        self.version = 1
         self.connect()
 
     def display_progress(self, fraction = 0., width = 30, ch = '#'):
@@ -67,16 +68,62 @@ class bootloadercmd:
         sys.stdout.write(progressbar)
         sys.stdout.flush()
 
+    def packed(self, address, num_instructions):
+        bytes = []
+        for i in range(address, address + 2 * num_instructions, 2):
+            bytes.append(self.flash[i] & 0xFF)
+            bytes.append(self.flash[i] >> 8)
+            bytes.append(self.flash[i + 1] & 0xFF)
+        return bytes
+
+    def image_end(self):
+        # The last page of application memory is left alone when the image 
+        # leaves it blank, so that data that the application keeps there 
+        # (such as the smu_base unit ID) survives a firmware update
+        page = self.lastpage - 0x400
+        for address in range(page, self.lastpage, 2):
+            if (self.flash[address] != 0xFFFF) or (self.flash[address + 1] != 0xFF):
+                return self.lastpage
+        return page
+
     def write_device(self):
-        if self.connected == True:
+        end = self.image_end()
+        if (self.connected == True) and (self.version >= 2):
+            blank_crc = zlib.crc32(b'\xFF' * 1536)
             print('Erasing program memory...')
-            for address in range(0x1000, self.lastpage, 0x400):
+            pages = []
+            for address in range(0x1000, end, 0x400):
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
+                if self.packed(address, 512) != [0xFF] * 1536:
+                    pages.append(address)
+                elif self.bootloader.crc_flash(address, 512) == blank_crc:
+                    continue
+                self.bootloader.erase_page(address)
+            print('\nWriting program memory...')
+            for page in pages:
+                self.display_progress(float(page - 0x1000) / float(end - 0x1000))
+                for address in range(page, page + 0x400, 0x80):
+                    bytes = self.packed(address, 64)
+                    if bytes == [0xFF] * 192:
+                        continue
+                    if self.bootloader.write_row(address, bytes) != 0:
+                        print('\nWrite failed at location 0x{0:05X} in program memory.'.format(address))
+                        return
+            sys.stdout.write('\n')
+            if self.verify_on_write == True:
+                if self.verify() == 0:
+                    print('Write completed successfully.')
+            else:
+                print('Write completed, but not verified.')
+        elif self.connected == True:
+            print('Erasing program memory...')
+            for address in range(0x1000, end, 0x400):
                 self.bootloader.erase_flash(address)
-                self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
             print('\nWriting program memory...')
-            for address in range(0x1000, self.lastpage, 32):
+            for address in range(0x1000, end, 32):
                 if (address % 512) == 0:
-                    self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+                    self.display_progress(float(address - 0x1000) / float(end - 0x1000))
                 bytes = []
                 for i in range(32):
                     bytes.append((self.flash[address + i]) & 0xFF)
@@ -96,6 +143,46 @@ class bootloadercmd:
         else:
             print('Could not write device.\nNo connection to a PIC24FJ USB bootloader device.')
     
+    def update_device(self):
+        end = self.image_end()
+        if (self.connected == True) and (self.version >= 2):
+            print('Comparing program memory...')
+            pages = []
+            for address in range(0x1000, end, 0x400):
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
+                if self.bootloader.crc_flash(address, 512) != zlib.crc32(bytearray(self.packed(address, 512))):
+                    pages.append(address)
+            print('\n{0:d} of {1:d} pages differ.'.format(len(pages), (end - 0x1000) // 0x400))
+            if len(pages) > 0:
+                print('Updating program memory...')
+                for n, page in enumerate(pages):
+                    self.display_progress(float(n) / float(len(pages)))
+                    self.bootloader.erase_page(page)
+                    for address in range(page, page + 0x400, 0x80):
+                        bytes = self.packed(address, 64)
+                        if bytes == [0xFF] * 192:
+                            continue
+                        if self.bootloader.write_row(address, bytes) != 0:
+                            print('\nWrite failed at location 0x{0:05X} in program memory.'.format(address))
+                            return
+                self.display_progress(1.)
+                sys.stdout.write('\n')
+            # Check the whole image in spans of 0x8000 instructions (the most 
+            # that a single BULK_CRC command can cover)
+            for address in range(0x1000, end, 0x10000):
+                num_instructions = (min(address + 0x10000, end) - address) // 2
+                crc = self.bootloader.crc_flash(address, num_instructions)
+                expected = zlib.crc32(bytearray(self.packed(address, num_instructions)))
+                if crc != expected:
+                    print('Update failed.\nRead CRC 0x{0:08X} for the image starting at location 0x{1:05X} in program memory, expecting 0x{2:08X}.'.format(crc if crc is not None else 0, address, expected))
+                    return
+            print('Update completed successfully.')
+        elif self.connected == True:
+            print('Bootloader does not support CRC requests; writing entire device.')
+            self.write_device()
+        else:
+            print('Could not update device.\nNo connection to a PIC24FJ USB bootloader device.')
+
     def read_device(self):
         if self.connected == True:
             print('Reading program memory...')
@@ -110,11 +197,23 @@ class bootloadercmd:
             print('Could not read device.\nNo connection to a PIC24FJ USB bootloader device.')
 
     def verify(self):
-        if self.connected == True:
+        end = self.image_end()
+        if (self.connected == True) and (self.version >= 2):
             print('Verifying program memory...')
-            for address in range(0x1000, self.lastpage, 64):
+            for address in range(0x1000, end, 0x400):
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
+                crc = self.bootloader.crc_flash(address, 512)
+                expected = zlib.crc32(bytearray(self.packed(address, 512)))
+                if crc != expected:
+                    print('\nVerification failed.\nRead CRC 0x{0:08X} for the page at location 0x{1:05X} in program memory, expecting 0x{2:08X}.'.format(crc if crc is not None else 0, address, expected))
+                    return -1
+            print('\nVerification succeeded.')
+            return 0
+        elif self.connected == True:
+            print('Verifying program memory...')
+            for address in range(0x1000, end, 64):
                 if (address % 512) == 0:
-                    self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+                    self.display_progress(float(address - 0x1000) / float(end - 0x1000))
                 bytes = self.bootloader.read_flash(address, 64)
                 for i in range(32):
                     if (bytes[2 * i] + 256 * bytes[2 * i + 1]) != self.flash[address + i]:
@@ -166,6 +265,7 @@ class bootloadercmd:
             ret = self.bootloader.read_flash(0xFF0000, 2)
             key = '{:02X}{:02X}'.format(ret[1], ret[0])
             self.lastpage = self.pic_table[key].lastpage
+            self.version = self.bootloader.get_version()
             print('Connected to a PIC24FJ USB bootloader device ({:s}).'.format(self.pic_table[key].name))
         else:
             self.connected = False
@@ -322,7 +422,7 @@ NAME
 SYNOPSIS
 
     bootloadercmd.py [-B|+B] [-V|+V] [-i <hex_file>]
-                     [-e] [-b] [-r] [-w] [-v]
+                     [-e] [-b] [-r] [-w] [-u] [-v]
                      [-x <hex_file>] [-d <dump_file>]
                      [-h|--help]
 
@@ -352,10 +452,21 @@ OPTIONS
 
     -w    Erase the program memory of the connected PIC24FJ USB bootloader 
           device, write the contents of the flash memory buffer, and verify 
-          the device if verify on write is enabled.
+          the device if verify on write is enabled.  With a version 2 or 
+          later bootloader, rows are written over its bulk endpoints and 
+          only pages holding part of the flash memory buffer (or not 
+          already blank on the device) are erased.
+
+    -u    Update the connected PIC24FJ USB bootloader device with the 
+          contents of the flash memory buffer, erasing and writing only those 
+          pages whose CRC-32 on the device differs from that of the buffer, 
+          and then checking the CRC-32 of the whole image.  Falls back to -w 
+          with bootloaders that predate version 2.
 
     -v    Verify that the contents of program memory of the connected PIC24FJ 
-          USB bootloader device match those of the flash memory buffer.
+          USB bootloader device match those of the flash memory buffer.  
+          With a version 2 or later bootloader, each page is checked by 
+          comparing a CRC-32 computed on the device against the buffer.
 
     -x <hex_file>
           Export the contents of the flash memory buffer to a hex file 
@@ -397,6 +508,8 @@ def main(argv):
             boot.dump_flash(argv[i])
         elif argv[i] == '-w':
             boot.write_device()
+        elif argv[i] == '-u':
+            boot.update_device()
         elif argv[i] == '-e':
             boot.erase()
         elif argv[i] == '-r':
@@ -206,13 +206,24 @@ class bootloadergui:
     def exit(self):
         sys.exit(0)
 
+    def image_end(self):
+        # The last page of application memory is left alone when the image 
+        # leaves it blank, so that data that the application keeps there 
+        # (such as the smu_base unit ID) survives a firmware update
+        page = self.lastpage - 0x400
+        for address in range(page, self.lastpage, 2):
+            if (self.flash[address] != 0xFFFF) or (self.flash[address + 1] != 0xFF):
+                return self.lastpage
+        return page
+
     def write_device(self):
+        end = self.image_end()
         self.display_warning('Erasing program memory...')
-        for address in range(0x1000, self.lastpage, 0x400):
+        for address in range(0x1000, end, 0x400):
             self.bootloader.erase_flash(address)
-            self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+            self.display_progress(float(address - 0x1000) / float(end - 0x1000))
         self.display_warning('Writing program memory...')
-        for address in range(0x1000, self.lastpage, 32):
+        for address in range(0x1000, end, 32):
             bytes = []
             for i in range(32):
                 bytes.append((self.flash[address + i]) & 0xFF)
@@ -224,7 +235,7 @@ class bootloadergui:
                 continue
             self.bootloader.write_flash(address, bytes)
             if (address % 512) == 0:
-                self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
         if self.verify_on_write.get() == 1:
             if self.verify() == 0:
                 self.display_message('Write completed successfully.')
@@ -245,10 +256,11 @@ class bootloadergui:
         self.display_progress()
     
     def verify(self):
+        end = self.image_end()
         self.display_warning('Verifying program memory...')
-        for address in range(0x1000, self.lastpage, 64):
+        for address in range(0x1000, end, 64):
             if (address % 512) == 0:
-                self.display_progress(float(address - 0x1000) / float(self.lastpage - 0x1000))
+                self.display_progress(float(address - 0x1000) / float(end - 0x1000))
             bytes = self.bootloader.read_flash(address, 64)
             for i in range(32):
                 if (bytes[2 * i] + 256 * bytes[2 * i + 1]) != self.flash[address + i]:
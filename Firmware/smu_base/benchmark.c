@@ -0,0 +1,140 @@
+#include <string.h>
+#include "benchmark.h"
+#include "parser.h"
+#include "cdc.h"
+#include "smu_base.h"
+
+uint16_t bench_cycles[BENCH_CASES];
+
+uint32_t bench_overhead;
+
+// Replies to the commands dispatched by the benchmarks are discarded
+// through a null channel
+PARSER_CHANNEL_T bench_channel;
+
+uint16_t bench_tx_space(void) {
+    return 0xFFFF;
+}
+
+void bench_record(uint16_t index, uint32_t cycles, uint16_t count) {
+    cycles /= count;
+    bench_cycles[index] = (cycles > 0xFFFF) ? 0xFFFF : (uint16_t)cycles;
+}
+
+void bench_dispatch(uint16_t index, char *command) {
+    uint32_t start, elapsed;
+    uint16_t i;
+
+    elapsed = 0;
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        strcpy(bench_channel.cmd_buffer, command);
+        start = timer_read();
+        parser_dispatch(&bench_channel);
+        elapsed += timer_read() - start - bench_overhead;
+    }
+    bench_record(index, elapsed, BENCH_ITERATIONS);
+}
+
+void bench_run(void) {
+    PARSER_CHANNEL_T *channel;
+    uint32_t start;
+    uint16_t i, saved_tail, saved_count, saved_utxen, saved_u1txie;
+    char str[24], *token, *remainder;
+    int32_t ch1val, ch2val;
+
+    channel = parser_channel;
+
+    bench_channel.in_waiting = dummy_in_waiting;
+    bench_channel.getch = dummy_getc;
+    bench_channel.putch = dummy_putc;
+    bench_channel.putstr = dummy_puts;
+    bench_channel.tx_space = bench_tx_space;
+    bench_channel.task = (STATE_HANDLER_T)NULL;
+    bench_channel.adc24_stream = TRUE;
+    bench_channel.adc24_stream_seq = 0;
+    bench_channel.block_handler = (PARSER_BLOCK_HANDLER_T)NULL;
+
+    // Measure the cost of reading the timer itself, to be subtracted from
+    // each measurement
+    start = timer_read();
+    bench_overhead = timer_read() - start;
+
+    start = timer_read();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        strcpy(str, "DAC16:CH1 9000,7000");
+        remainder = (char *)NULL;
+        token = str_tok_r(str, ":, ", &remainder);
+        while (token)
+            token = str_tok_r((char *)NULL, ":, ", &remainder);
+    }
+    bench_record(BENCH_STR_TOK_R, timer_read() - start - bench_overhead, BENCH_ITERATIONS);
+
+    bench_dispatch(BENCH_DISPATCH, "UI:LED1?");
+    bench_dispatch(BENCH_DISPATCH_DEEP, "ADC24:STREAM?");
+
+    parser_channel = &bench_channel;
+
+    start = timer_read();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+        hex2str_alt(0xBEEF + i, str);
+    bench_record(BENCH_HEX2STR, timer_read() - start - bench_overhead, BENCH_ITERATIONS);
+
+    start = timer_read();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        hex2str_alt(0xBEEF + i, str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(0x0012, str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(0xCAFE - i, str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(0xFFFF, str);
+        parser_puts(str);
+        parser_puts("\r\n");
+    }
+    bench_record(BENCH_REPLY, timer_read() - start - bench_overhead, BENCH_ITERATIONS);
+
+    // Queue bytes with cdc_putc() only if they fit without waiting, held
+    // back from the USB module, and then withdraw them
+    if (cdc_tx_buffer_space() >= BENCH_BYTES) {
+        cdc_tx_hold();
+        start = timer_read();
+        for (i = 0; i < BENCH_BYTES; i++)
+            cdc_putc('0' + i);
+        bench_record(BENCH_CDC_PUTC, timer_read() - start - bench_overhead, BENCH_BYTES);
+        cdc_tx_rollback(BENCH_BYTES);
+    } else
+        bench_cycles[BENCH_CDC_PUTC] = 0;
+
+    // Likewise for U1putc(), with the UART1 TX interrupt masked so that none
+    // of the bytes reach the BLE module
+    if (ble_tx_buffer_space() >= BENCH_BYTES) {
+        saved_u1txie = IEC0bits.U1TXIE;
+        IEC0bits.U1TXIE = 0;
+        saved_utxen = U1STAbits.UTXEN;
+        saved_tail = U1TXbuffer.tail;
+        saved_count = U1TXbuffer.count;
+        start = timer_read();
+        for (i = 0; i < BENCH_BYTES; i++)
+            U1putc('0' + i);
+        bench_record(BENCH_U1PUTC, timer_read() - start - bench_overhead, BENCH_BYTES);
+        U1TXbuffer.tail = saved_tail;
+        U1TXbuffer.count = saved_count;
+        U1STAbits.UTXEN = saved_utxen;
+        IEC0bits.U1TXIE = saved_u1txie;
+    } else
+        bench_cycles[BENCH_U1PUTC] = 0;
+
+    // Reading a frame takes the ADS1292's latest conversion, so a stream
+    // running at the same time loses one frame per read
+    start = timer_read();
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        adc24_read_data(&ch1val, &ch2val);
+        parser_send_adc24_frame(&bench_channel, ch1val, ch2val);
+    }
+    bench_record(BENCH_ADC24_FRAME, timer_read() - start - bench_overhead, BENCH_FRAMES);
+
+    parser_channel = channel;
+}
@@ -0,0 +1,27 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdint.h>
+
+// Micro-benchmarks of the command parsing, reply formatting, and buffering 
+// paths that run while streaming, each timed in instruction cycles with the 
+// Timer2/3 timebase and reported as the average cost of one operation
+#define BENCH_STR_TOK_R     0   // tokenizing "DAC16:CH1 9000,7000"
+#define BENCH_DISPATCH      1   // dispatching UI:LED1? (shallow tables)
+#define BENCH_DISPATCH_DEEP 2   // dispatching ADC24:STREAM? (deep tables)
+#define BENCH_HEX2STR       3   // formatting one value with hex2str_alt()
+#define BENCH_REPLY         4   // formatting a four-value reply line
+#define BENCH_CDC_PUTC      5   // queuing one byte with cdc_putc()
+#define BENCH_U1PUTC        6   // queuing one byte with U1putc()
+#define BENCH_ADC24_FRAME   7   // reading and framing one ADC24 sample pair
+#define BENCH_CASES         8
+
+#define BENCH_ITERATIONS    64
+#define BENCH_BYTES         32
+#define BENCH_FRAMES        8
+
+extern uint16_t bench_cycles[BENCH_CASES];
+
+void bench_run(void);
+
+#endif
@@ -1,5 +1,6 @@
 #include "pic24fj.h"
 #include "cdc.h"
+#include "trace.h"
 
 uint8_t EP1_IN_buffer[10];
 uint8_t EP2_OUT_buffer[MAX_PACKET_SIZE];
@@ -23,6 +24,10 @@ struct CDC_ring_buffer {
 
 uint8_t TXbuf[TX_BUFFER_SIZE], RXbuf[RX_BUFFER_SIZE];
 
+// Set by cdc_tx_hold() to keep queued bytes from the USB module, along with
+// the number of bytes that were queued before it
+uint16_t CDC_TX_held, CDC_TX_held_count;
+
 void cdc_set_line_coding_out_callback(void) {
     CDC_line_coding.dwDTERate.b[0] = BD[EP0OUT].address[0];
     CDC_line_coding.dwDTERate.b[1] = BD[EP0OUT].address[1];
@@ -90,6 +95,7 @@ void init_cdc(void) {
     CDC_TX_buffer.head = 0;
     CDC_TX_buffer.tail = 0;
     CDC_TX_buffer.count = 0;
+    CDC_TX_held = 0;
 
     CDC_RX_buffer.data = RXbuf;
     CDC_RX_buffer.length = RX_BUFFER_SIZE;
@@ -102,6 +108,8 @@ void cdc_tx_service(void) {
     uint8_t packet_length, i;
 
     if (!(BD[EP2IN].status & UOWN)) {   // see if UOWN bit of EP2 IN status register is clear (i.e., PIC owns EP2 IN buffer)
+        if (CDC_TX_held)
+            return;
         if (CDC_TX_buffer.count < MAX_PACKET_SIZE) 
             packet_length = CDC_TX_buffer.count;
         else
@@ -113,6 +121,8 @@ void cdc_tx_service(void) {
                 CDC_TX_buffer.head = 0;
         }
         CDC_TX_buffer.count -= packet_length;
+        if (packet_length)
+            trace_log(TRACE_CDC_TX, packet_length);
         BD[EP2IN].bytecount = packet_length;
         BD[EP2IN].status = ((BD[EP2IN].status ^ DTS) & DTS) | UOWN | DTSEN; // toggle DATA01 bit, clear the PIDs bits, and set the UOWN and DTS bits
     }
@@ -130,10 +140,13 @@ void cdc_rx_service(void) {
                     CDC_RX_buffer.tail = 0;
             }
             CDC_RX_buffer.count += BD[EP2OUT].bytecount;
+            trace_log(TRACE_CDC_RX, BD[EP2OUT].bytecount);
             BD[EP2OUT].bytecount = 64;
             BD[EP2OUT].status = ((BD[EP2OUT].status ^ DTS) & DTS) | UOWN | DTSEN;   // toggle DATA01 bit, clear the PIDs bits, and set the UOWN and DTS bits
-        } else
+        } else {
+            trace_log(TRACE_CDC_RX_FULL, BD[EP2OUT].bytecount);
             USB_error_flags |= REQUEST_ERROR;
+        }
     }
 }
 
@@ -160,6 +173,30 @@ void cdc_putc(uint8_t ch) {
     enable_interrupts();
 }
 
+// Keeps the bytes queued from now on from being handed to the USB module
+// until cdc_tx_rollback(), so that they can be withdrawn; used to time
+// cdc_putc() without sending anything.  The caller must queue no more bytes
+// than cdc_tx_buffer_space(), or cdc_putc() would wait forever.
+void cdc_tx_hold(void) {
+    disable_interrupts();
+    CDC_TX_held = 1;
+    CDC_TX_held_count = CDC_TX_buffer.count;
+    enable_interrupts();
+}
+
+// Removes the last count bytes queued by cdc_putc() since cdc_tx_hold(),
+// none of which have been handed to the USB module, and lets the bytes 
+// queued before it be sent again
+void cdc_tx_rollback(uint16_t count) {
+    disable_interrupts();
+    if (count > CDC_TX_buffer.count - CDC_TX_held_count)
+        count = CDC_TX_buffer.count - CDC_TX_held_count;
+    CDC_TX_buffer.tail = (CDC_TX_buffer.tail >= count) ? CDC_TX_buffer.tail - count : CDC_TX_buffer.tail + CDC_TX_buffer.length - count;
+    CDC_TX_buffer.count -= count;
+    CDC_TX_held = 0;
+    enable_interrupts();
+}
+
 uint8_t cdc_getc(void) {
     uint8_t ch;
 
@@ -61,6 +61,8 @@ void init_cdc(void);
 uint16_t cdc_in_waiting(void);
 uint16_t cdc_tx_buffer_space(void);
 void cdc_putc(uint8_t ch);
+void cdc_tx_hold(void);
+void cdc_tx_rollback(uint16_t count);
 uint8_t cdc_getc(void);
 void cdc_puts(uint8_t *str);
 void cdc_gets(uint8_t *str, uint16_t len);
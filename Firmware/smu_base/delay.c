@@ -0,0 +1,41 @@
+#include "delay.h"
+#include "hal.h"
+#include "smu_base.h"
+#include "trace.h"
+
+uint16_t timeout_counts[TIMEOUTS];
+uint16_t timeout_pending;
+
+void delay_us(uint16_t us) {
+    uint32_t start, ticks;
+
+    ticks = (uint32_t)us * TIMER_TICKS_PER_US;
+    start = tmr23_read();
+    while (tmr23_read() - start < ticks) {}
+}
+
+void delay_ms(uint16_t ms) {
+    uint32_t start, ticks;
+
+    ticks = (uint32_t)ms * 1000 * TIMER_TICKS_PER_US;
+    start = tmr23_read();
+    while (tmr23_read() - start < ticks) {}
+}
+
+// Deadlines are compared by the sign of their difference from the current 
+// time, which is correct across the rollover of the timebase for timeouts 
+// of up to half its period (134 s)
+void timeout_start(TIMEOUT_T *timeout, uint32_t us) {
+    *timeout = tmr23_read() + us * TIMER_TICKS_PER_US;
+}
+
+uint16_t timeout_expired(TIMEOUT_T *timeout) {
+    return ((int32_t)(tmr23_read() - *timeout) >= 0) ? TRUE : FALSE;
+}
+
+void timeout_error(uint16_t which) {
+    if (timeout_counts[which] != 0xFFFF)
+        timeout_counts[which]++;
+    timeout_pending = TRUE;
+    trace_log(TRACE_TIMEOUT, which);
+}
@@ -0,0 +1,44 @@
+#ifndef _DELAY_H_
+#define _DELAY_H_
+
+#include <stdint.h>
+
+// Delays and timeouts measured with the Timer2/3 timebase.  The delays
+// only spin; a timeout is a deadline set by timeout_start() and polled with
+// timeout_expired().
+
+// Spin-waits that give up after a timeout, each logging a TRACE_TIMEOUT 
+// event with its code, counting in timeout_counts[], and setting 
+// timeout_pending, which the parser clears before each command and checks 
+// to flag the command's reply
+#define TIMEOUT_SPI1        0   // SPI1 (DAC16) exchange
+#define TIMEOUT_SPI2        1   // SPI2 (ADC24) exchange
+#define TIMEOUT_SDADC       2   // sigma-delta ADC conversion
+#define TIMEOUT_DRDY        3   // ADS1292 DRDY
+#define TIMEOUT_NVM         4   // flash erase or write
+#define TIMEOUT_U1TX        5   // room in the UART1 TX buffer (byte dropped)
+#define TIMEOUT_U1RX        6   // a byte in the UART1 RX buffer (0 returned)
+#define TIMEOUT_USB_SE0     7   // end of SE0 at USB initialization
+#define TIMEOUTS            8
+
+// Limits of the waits, in microseconds
+#define TIMEOUT_SPI_US      100
+#define TIMEOUT_SDADC_US    5000
+#define TIMEOUT_DRDY_US     20000
+#define TIMEOUT_NVM_US      100000
+#define TIMEOUT_U1_US       100000
+#define TIMEOUT_USB_SE0_US  100000
+
+typedef uint32_t TIMEOUT_T;
+
+extern uint16_t timeout_counts[TIMEOUTS];
+extern uint16_t timeout_pending;
+
+void delay_us(uint16_t us);
+void delay_ms(uint16_t ms);
+
+void timeout_start(TIMEOUT_T *timeout, uint32_t us);
+uint16_t timeout_expired(TIMEOUT_T *timeout);
+void timeout_error(uint16_t which);
+
+#endif
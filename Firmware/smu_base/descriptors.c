@@ -2,7 +2,9 @@
 #include "usb.h"
 #include <stdint.h>
 
-uint8_t __attribute__ ((space(auto_psv))) Device[] = {
+// Kept in RAM, so that init_unit_id() can leave out the serial number of a 
+// board whose unit ID has not been set
+uint8_t Device[] = {
     0x12,       // bLength
     DEVICE,     // bDescriptorType
     0x00,       // bcdUSB (low byte)
@@ -19,7 +21,7 @@ uint8_t __attribute__ ((space(auto_psv))) Device[] = {
     0x00,       // bcdDevice (high byte)
     0x01,       // iManufacturer
     0x02,       // iProduct
-    0x00,       // iSerialNumber (none)
+    0x03,       // iSerialNumber (DEVICE_SERIAL_INDEX)
     NUM_CONFIGURATIONS    // bNumConfigurations
 };
 
@@ -121,9 +123,17 @@ uint8_t __attribute__ ((space(auto_psv))) String2[] = {
     'D', 0, 'e', 0, 'v', 0, 'i', 0, 'c', 0, 'e', 0
 };
 
+// Kept in RAM, so that init_unit_id() can fill in the unit ID's hex digits
+uint8_t String3[] = {
+    18,         // bLength
+    STRING,     // bDescriptorType
+    'F', 0, 'F', 0, 'F', 0, 'F', 0, 'F', 0, 'F', 0, 'F', 0, 'F', 0
+};
+
 uint8_t __attribute__ ((space(auto_psv))) *Strings[] = {
     String0, 
     String1, 
-    String2
+    String2, 
+    String3
 };
 
@@ -0,0 +1,279 @@
+#include "fft.h"
+#include "smu_base.h"
+#include "hal.h"
+#include "hist.h"
+#include "lockin.h"
+
+// The first half of a Hann window of FFT_POINTS, in Q15; the second half
+// mirrors it
+const int16_t fft_window[FFT_POINTS / 2 + 1] = {
+          0,     20,     79,    177,    315,    491,    705,    958,
+       1247,   1573,   1935,   2331,   2761,   3224,   3719,   4244,
+       4799,   5381,   5990,   6624,   7281,   7961,   8660,   9379,
+      10114,  10864,  11628,  12403,  13187,  13980,  14778,  15580,
+      16383,  17187,  17989,  18787,  19580,  20364,  21139,  21903,
+      22653,  23388,  24107,  24806,  25486,  26143,  26777,  27386,
+      27968,  28523,  29048,  29543,  30006,  30436,  30832,  31194,
+      31520,  31809,  32062,  32276,  32452,  32590,  32688,  32747,
+      32767
+};
+
+uint16_t fft_source, fft_shift, fft_averages;
+uint16_t fft_state;
+uint32_t fft_power[FFT_BINS];
+int16_t fft_exponent;
+uint16_t fft_blocks, fft_clipped;
+
+// The FFT transforms fft_hist_buffer.block in place as FFT_POINTS / 2 complex
+// points (the even samples real and the odd ones imaginary); the number of
+// samples in it, the first sample of the run, and the ADC16 results still
+// to discard
+FFT_HIST_BUFFER_T fft_hist_buffer;
+uint16_t fft_count;
+int32_t fft_origin;
+uint16_t fft_settle;
+
+void init_fft(void) {
+    uint16_t k;
+
+    fft_source = FFT_SRC_ADC24_CH1;
+    fft_shift = 0;
+    fft_averages = 16;
+    fft_state = FFT_IDLE;
+    for (k = 0; k < FFT_BINS; k++)
+        fft_power[k] = 0;
+    fft_exponent = 0;
+    fft_blocks = 0;
+    fft_clipped = 0;
+}
+
+// The real and imaginary parts of exp(2 pi j k / FFT_POINTS), in Q15, from 
+// the lock-in's table of twice as many points
+int16_t fft_cos(uint16_t k) {
+    return lockin_sine[(uint8_t)(2 * k + 64)];
+}
+
+int16_t fft_sin(uint16_t k) {
+    return lockin_sine[(uint8_t)(2 * k)];
+}
+
+// Scales the block down by 2 until every part is below 2^13, so that the
+// next stage cannot overflow (a butterfly grows a part by at most
+// 1 + sqrt(2)); returns the block's exponent with the steps added to it
+int16_t fft_normalize(int16_t exponent) {
+    uint16_t i;
+    int16_t val, max;
+
+    max = 0;
+    for (i = 0; i < FFT_POINTS; i++) {
+        val = fft_hist_buffer.block[i];
+        if (val < 0)
+            val = -val;
+        if (val > max)
+            max = val;
+    }
+    while (max >= 0x2000) {
+        for (i = 0; i < FFT_POINTS; i++)
+            fft_hist_buffer.block[i] >>= 1;
+        max >>= 1;
+        exponent++;
+    }
+    return exponent;
+}
+
+// Adds the power of each bin of the transformed block, scaled by
+// 2^exponent, to the sums, first bringing the block and the sums to a
+// common exponent, and keeps the sums below 2^30.  With every part of the
+// block below 2^13, the parts of a bin stay below 2^15 and its power below
+// 2^30, so that all of the products fit the 16 x 16-bit multiplier.  The bins of the real
+// FFT come from the complex points Z[k] of the even and odd samples as
+// X[k] = (Z[k] + Z*[N - k]) / 2 - j W^k (Z[k] - Z*[N - k]) / 2, where
+// W = exp(-2 pi j / FFT_POINTS) and N = FFT_POINTS / 2.
+void fft_accumulate(int16_t exponent) {
+    uint16_t k, n, shift;
+    int16_t ar, ai, br, bi, er, ei, fr, fi, wr, wi, xr, xi;
+    uint32_t power, max;
+
+    if (fft_blocks == 0)
+        fft_exponent = exponent;
+    else if (exponent > fft_exponent) {
+        shift = 2 * (exponent - fft_exponent);
+        for (k = 0; k < FFT_BINS; k++)
+            fft_power[k] = (shift < 32) ? fft_power[k] >> shift : 0;
+        fft_exponent = exponent;
+    }
+    shift = 2 * (fft_exponent - exponent);
+
+    max = 0;
+    for (k = 0; k < FFT_BINS; k++) {
+        n = (FFT_POINTS / 2 - k) & (FFT_POINTS / 2 - 1);
+        ar = fft_hist_buffer.block[2 * k];
+        ai = fft_hist_buffer.block[2 * k + 1];
+        br = fft_hist_buffer.block[2 * n];
+        bi = -fft_hist_buffer.block[2 * n + 1];
+        er = (ar + br) >> 1;
+        ei = (ai + bi) >> 1;
+        fr = (ai - bi) >> 1;
+        fi = (br - ar) >> 1;
+        wr = fft_cos(k);
+        wi = -fft_sin(k);
+        xr = er + (int16_t)(((int32_t)wr * fr - (int32_t)wi * fi) >> 15);
+        xi = ei + (int16_t)(((int32_t)wr * fi + (int32_t)wi * fr) >> 15);
+        power = (uint32_t)((int32_t)xr * xr) + (uint32_t)((int32_t)xi * xi);
+        if (shift)
+            power = (shift < 32) ? power >> shift : 0;
+        fft_power[k] += power;
+        if (fft_power[k] > max)
+            max = fft_power[k];
+    }
+    while (max >= 0x40000000) {
+        for (k = 0; k < FFT_BINS; k++)
+            fft_power[k] >>= 2;
+        max >>= 2;
+        fft_exponent++;
+    }
+    fft_blocks++;
+}
+
+// Windows a full block, transforms it in place by a radix-2, decimation in
+// time FFT, and adds its power to the sums
+void fft_transform(void) {
+    uint16_t i, j, k, m, size, half, step;
+    int16_t wr, wi, tr, ti, val, exponent;
+
+    for (i = 0; i < FFT_POINTS; i++)
+        fft_hist_buffer.block[i] = ((int32_t)fft_hist_buffer.block[i] * 
+                         fft_window[(i <= FFT_POINTS / 2) ? i : FFT_POINTS - i]) >> 15;
+
+    // Put the complex points in bit-reversed order
+    j = 0;
+    for (i = 0; i < FFT_POINTS / 2 - 1; i++) {
+        if (i < j) {
+            val = fft_hist_buffer.block[2 * i];
+            fft_hist_buffer.block[2 * i] = fft_hist_buffer.block[2 * j];
+            fft_hist_buffer.block[2 * j] = val;
+            val = fft_hist_buffer.block[2 * i + 1];
+            fft_hist_buffer.block[2 * i + 1] = fft_hist_buffer.block[2 * j + 1];
+            fft_hist_buffer.block[2 * j + 1] = val;
+        }
+        k = FFT_POINTS / 4;
+        while (k <= j) {
+            j -= k;
+            k >>= 1;
+        }
+        j += k;
+    }
+
+    exponent = 0;
+    for (size = 2; size <= FFT_POINTS / 2; size <<= 1) {
+        exponent = fft_normalize(exponent);
+        half = size >> 1;
+        step = FFT_POINTS / size;
+        for (m = 0; m < half; m++) {
+            wr = fft_cos(m * step);
+            wi = -fft_sin(m * step);
+            for (i = m; i < FFT_POINTS / 2; i += size) {
+                j = i + half;
+                tr = ((int32_t)wr * fft_hist_buffer.block[2 * j] - 
+                      (int32_t)wi * fft_hist_buffer.block[2 * j + 1]) >> 15;
+                ti = ((int32_t)wr * fft_hist_buffer.block[2 * j + 1] + 
+                      (int32_t)wi * fft_hist_buffer.block[2 * j]) >> 15;
+                fft_hist_buffer.block[2 * j] = fft_hist_buffer.block[2 * i] - tr;
+                fft_hist_buffer.block[2 * j + 1] = fft_hist_buffer.block[2 * i + 1] - ti;
+                fft_hist_buffer.block[2 * i] += tr;
+                fft_hist_buffer.block[2 * i + 1] += ti;
+            }
+        }
+    }
+    exponent = fft_normalize(exponent);
+
+    fft_accumulate(exponent);
+}
+
+// Clears the sums and starts taking blocks of the selected channel
+void fft_start(void) {
+    uint16_t k;
+
+    fft_stop();
+    hist_stop();
+    hist_clear();                   // the block overwrites the bins
+
+    for (k = 0; k < FFT_BINS; k++)
+        fft_power[k] = 0;
+    fft_exponent = 0;
+    fft_blocks = 0;
+    fft_clipped = 0;
+    fft_count = 0;
+    fft_state = FFT_RUNNING;
+    if (fft_source < FFT_SRC_ADC16_CH1)
+        adc24_start();
+    else {
+        SD1CON3bits.SDCH = fft_source - FFT_SRC_ADC16_CH1;
+        fft_settle = HIST_ADC16_SETTLE;
+    }
+}
+
+// Stops taking blocks, leaving the sums in place
+void fft_stop(void) {
+    if ((fft_state == FFT_RUNNING) && (fft_source < FFT_SRC_ADC16_CH1))
+        adc24_stop();
+    fft_state = FFT_IDLE;
+}
+
+void fft_add(int32_t val) {
+    if ((fft_blocks == 0) && (fft_count == 0))
+        fft_origin = val;
+    val = (val - fft_origin) >> fft_shift;
+    if (val > 0x7FFF) {
+        val = 0x7FFF;
+        fft_clipped++;
+    } else if (val < -0x7FFF) {
+        val = -0x7FFF;
+        fft_clipped++;
+    }
+    fft_hist_buffer.block[fft_count++] = (int16_t)val;
+    if (fft_count < FFT_POINTS)
+        return;
+
+    fft_count = 0;
+    fft_transform();
+    if (fft_averages && (fft_blocks == fft_averages)) {
+        if (fft_source < FFT_SRC_ADC16_CH1)
+            adc24_stop();
+        fft_state = FFT_DONE;
+    }
+}
+
+// Returns 1 while an ADC24 spectrum runs
+uint16_t fft_adc24_wanted(void) {
+    return ((fft_state != FFT_RUNNING) || (fft_source >= FFT_SRC_ADC16_CH1)) ? 0 : 1;
+}
+
+// Takes each ADC24 frame read while an ADC24 spectrum runs
+void fft_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    if ((fft_state != FFT_RUNNING) || (fft_source >= FFT_SRC_ADC16_CH1))
+        return;
+    fft_add((fft_source == FFT_SRC_ADC24_CH1) ? ch1val : ch2val);
+}
+
+// Takes each ADC16 result that has come in while an ADC16 spectrum runs,
+// as hist_service() does; call from the main loop
+void fft_service(void) {
+    uint16_t channel;
+
+    if ((fft_state != FFT_RUNNING) || (fft_source < FFT_SRC_ADC16_CH1))
+        return;
+
+    channel = fft_source - FFT_SRC_ADC16_CH1;
+    if (SD1CON3bits.SDCH != channel) {
+        SD1CON3bits.SDCH = channel;
+        fft_settle = HIST_ADC16_SETTLE;
+    }
+    if (!sdadc1_ready())
+        return;
+    if (fft_settle) {
+        fft_settle--;
+        return;
+    }
+    fft_add((int32_t)(int16_t)SD1RESH - (int32_t)adc16_get_offset());
+}
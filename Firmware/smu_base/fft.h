@@ -0,0 +1,45 @@
+#ifndef _FFT_H_
+#define _FFT_H_
+
+#include <stdint.h>
+#include "hist.h"
+
+// Power spectrum: windows blocks of FFT_POINTS samples of one ADC channel,
+// transforms them with a block-floating-point FFT, and averages their power
+// into FFT_BINS bins, which hold fft_power[k] * 4^fft_exponent.  Runs for
+// fft_averages blocks, or with 0, until stopped.
+#define FFT_POINTS          128
+#define FFT_BINS            64
+#define FFT_SHIFT_MAX       16
+
+#define FFT_SRC_ADC24_CH1   0
+#define FFT_SRC_ADC24_CH2   1
+#define FFT_SRC_ADC16_CH1   2
+#define FFT_SRC_ADC16_CH2   3
+
+#define FFT_IDLE            0
+#define FFT_RUNNING         1
+#define FFT_DONE            2
+
+// The block being filled shares its memory with the histogram's bins, since 
+// starting either one stops the other
+typedef union {
+    int16_t block[FFT_POINTS];
+    uint32_t bins[HIST_BINS_MAX];
+} FFT_HIST_BUFFER_T;
+
+extern FFT_HIST_BUFFER_T fft_hist_buffer;
+extern uint16_t fft_source, fft_shift, fft_averages;
+extern uint16_t fft_state;
+extern uint32_t fft_power[FFT_BINS];
+extern int16_t fft_exponent;
+extern uint16_t fft_blocks, fft_clipped;
+
+void init_fft(void);
+void fft_start(void);
+void fft_stop(void);
+uint16_t fft_adc24_wanted(void);
+void fft_adc24_frame(int32_t ch1val, int32_t ch2val);
+void fft_service(void);
+
+#endif
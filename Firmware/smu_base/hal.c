@@ -0,0 +1,160 @@
+#include "pic24fj.h"
+#include "hal.h"
+#include "perf.h"
+#include "delay.h"
+
+// SPI1 (DAC16) and SPI2 (ADC24), which spi_config() sets up with their 
+// enhanced buffers enabled: send a byte and return the byte received in 
+// exchange
+uint8_t spi1_exchange(uint8_t ch) {
+    TIMEOUT_T timeout;
+
+    SPI1BUF = (uint16_t)ch;
+    PERF_BEGIN(PERF_WAIT_SPI1);
+    timeout_start(&timeout, TIMEOUT_SPI_US);
+    while (SPI1STATbits.SRXMPT == 1) {
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_SPI1);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_SPI1);
+    return (uint8_t)SPI1BUF;
+}
+
+uint8_t spi2_exchange(uint8_t ch) {
+    TIMEOUT_T timeout;
+
+    SPI2BUF = (uint16_t)ch;
+    PERF_BEGIN(PERF_WAIT_SPI2);
+    timeout_start(&timeout, TIMEOUT_SPI_US);
+    while (SPI2STATbits.SRXMPT == 1) {
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_SPI2);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_SPI2);
+    return (uint8_t)SPI2BUF;
+}
+
+// Exchange length bytes, keeping the transmit FIFO topped up so that the 
+// bytes go out back to back.  Sends zeros if tx is NULL and discards the 
+// bytes received if rx is NULL; tx and rx may be the same buffer.
+void spi1_transfer(uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint16_t sent, received;
+    uint8_t ch;
+    TIMEOUT_T timeout;
+
+    sent = 0;
+    received = 0;
+    PERF_BEGIN(PERF_WAIT_SPI1);
+    timeout_start(&timeout, TIMEOUT_SPI_US);
+    while (received < length) {
+        if ((sent < length) && (sent - received < SPI_FIFO_DEPTH) && (SPI1STATbits.SPITBF == 0)) {
+            SPI1BUF = tx ? (uint16_t)tx[sent] : 0;
+            sent++;
+        }
+        if (SPI1STATbits.SRXMPT == 0) {
+            ch = (uint8_t)SPI1BUF;
+            if (rx)
+                rx[received] = ch;
+            received++;
+            timeout_start(&timeout, TIMEOUT_SPI_US);
+        } else if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_SPI1);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_SPI1);
+}
+
+void spi2_transfer(uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint16_t sent, received;
+    uint8_t ch;
+    TIMEOUT_T timeout;
+
+    sent = 0;
+    received = 0;
+    PERF_BEGIN(PERF_WAIT_SPI2);
+    timeout_start(&timeout, TIMEOUT_SPI_US);
+    while (received < length) {
+        if ((sent < length) && (sent - received < SPI_FIFO_DEPTH) && (SPI2STATbits.SPITBF == 0)) {
+            SPI2BUF = tx ? (uint16_t)tx[sent] : 0;
+            sent++;
+        }
+        if (SPI2STATbits.SRXMPT == 0) {
+            ch = (uint8_t)SPI2BUF;
+            if (rx)
+                rx[received] = ch;
+            received++;
+            timeout_start(&timeout, TIMEOUT_SPI_US);
+        } else if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_SPI2);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_SPI2);
+}
+
+// 16-bit sigma-delta ADC: wait for the next result to be ready in SD1RESH
+void sdadc1_wait(void) {
+    TIMEOUT_T timeout;
+
+    IFS6bits.SDA1IF = 0;
+    PERF_BEGIN(PERF_WAIT_SDADC);
+    timeout_start(&timeout, TIMEOUT_SDADC_US);
+    while (IFS6bits.SDA1IF == 0) {
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_SDADC);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_SDADC);
+}
+
+// Returns 1, lowering the flag, if a result has come into SD1RESH since the 
+// last one was taken, or 0 if not, without waiting
+uint16_t sdadc1_ready(void) {
+    if (IFS6bits.SDA1IF == 0)
+        return 0;
+    IFS6bits.SDA1IF = 0;
+    return 1;
+}
+
+// UART1 (BLE module)
+uint16_t uart1_tx_ready(void) {
+    return U1STAbits.UTXBF == 0;
+}
+
+void uart1_tx(uint8_t ch) {
+    U1TXREG = (uint16_t)ch;
+}
+
+uint16_t uart1_rx_ready(void) {
+    return U1STAbits.URXDA == 1;
+}
+
+uint8_t uart1_rx(void) {
+    return (uint8_t)U1RXREG;
+}
+
+// Program memory: the linker places _PROGRAM_END just past the last 
+// instruction of the application
+extern uint16_t _PROGRAM_END __attribute__((space(prog)));
+
+uint32_t flash_program_end(void) {
+    return __builtin_tbladdress(&_PROGRAM_END);
+}
+
+// Timer2/3 (32-bit timebase): reading TMR2 latches TMR3 into TMR3HLD, so 
+// the two halves are read coherently, with interrupts held off in between 
+// so that an ISR's read cannot latch TMR3HLD again
+uint32_t tmr23_read(void) {
+    uint16_t lsw, msw;
+
+    __asm__("disi #4");             // disable interrupts for 4 cycles
+    lsw = TMR2;
+    msw = TMR3HLD;
+    return ((uint32_t)msw << 16) | lsw;
+}
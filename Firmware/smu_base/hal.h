@@ -0,0 +1,31 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <stdint.h>
+
+// Hardware abstraction layer: the peripheral operations whose behavior, and 
+// not just their configuration, the drivers in smu_base.c depend on.  hal.c 
+// implements them with the PIC24FJ's SFRs; the host build in host/ links 
+// host/sim.c in its place, which implements them with simulated peripherals.
+
+// Depth of the SPI transmit and receive FIFOs in enhanced buffer mode
+#define SPI_FIFO_DEPTH      8
+
+uint8_t spi1_exchange(uint8_t ch);
+uint8_t spi2_exchange(uint8_t ch);
+void spi1_transfer(uint8_t *tx, uint8_t *rx, uint16_t length);
+void spi2_transfer(uint8_t *tx, uint8_t *rx, uint16_t length);
+
+void sdadc1_wait(void);
+uint16_t sdadc1_ready(void);
+
+uint16_t uart1_tx_ready(void);
+void uart1_tx(uint8_t ch);
+uint16_t uart1_rx_ready(void);
+uint8_t uart1_rx(void);
+
+uint32_t tmr23_read(void);
+
+uint32_t flash_program_end(void);
+
+#endif
@@ -0,0 +1,117 @@
+#include "hist.h"
+#include "smu_base.h"
+#include "hal.h"
+#include "fft.h"
+
+uint16_t hist_source, hist_shift, hist_bins;
+int32_t hist_low;
+uint16_t hist_state;
+uint32_t hist_under, hist_over, hist_samples;
+
+// ADC16 results still to discard before counting
+uint16_t hist_settle;
+
+void hist_clear(void) {
+    uint16_t i;
+
+    for (i = 0; i < HIST_BINS_MAX; i++)
+        fft_hist_buffer.bins[i] = 0;
+    hist_under = 0;
+    hist_over = 0;
+    hist_samples = 0;
+}
+
+void init_hist(void) {
+    hist_source = HIST_SRC_ADC24_CH1;
+    hist_low = -32;
+    hist_shift = 0;
+    hist_bins = HIST_BINS_MAX;
+    hist_state = HIST_IDLE;
+    hist_clear();
+}
+
+// Sets the start of the first bin, the width of each bin as a power of 2,
+// and the number of bins; returns 0, or 1 if the width or the number of
+// bins is out of range
+uint16_t hist_set_range(int32_t low, uint16_t shift, uint16_t bins) {
+    if ((shift > HIST_SHIFT_MAX) || (bins == 0) || (bins > HIST_BINS_MAX))
+        return 1;
+    hist_low = low;
+    hist_shift = shift;
+    hist_bins = bins;
+    return 0;
+}
+
+// Clears the counts and starts counting samples of the selected channel
+void hist_start(void) {
+    hist_stop();
+    fft_stop();
+
+    hist_clear();
+    hist_state = HIST_RUNNING;
+    if (hist_source < HIST_SRC_ADC16_CH1)
+        adc24_start();
+    else {
+        SD1CON3bits.SDCH = hist_source - HIST_SRC_ADC16_CH1;
+        hist_settle = HIST_ADC16_SETTLE;
+    }
+}
+
+// Stops counting, leaving the counts in place
+void hist_stop(void) {
+    if (hist_state == HIST_IDLE)
+        return;
+    hist_state = HIST_IDLE;
+    if (hist_source < HIST_SRC_ADC16_CH1)
+        adc24_stop();
+}
+
+void hist_add(int32_t val) {
+    uint32_t bin;
+
+    hist_samples++;
+    if (val < hist_low) {
+        hist_under++;
+        return;
+    }
+    bin = ((uint32_t)val - (uint32_t)hist_low) >> hist_shift;
+    if (bin >= hist_bins)
+        hist_over++;
+    else
+        fft_hist_buffer.bins[bin]++;
+}
+
+// Returns 1 while an ADC24 histogram runs
+uint16_t hist_adc24_wanted(void) {
+    return ((hist_state == HIST_IDLE) || (hist_source >= HIST_SRC_ADC16_CH1)) ? 0 : 1;
+}
+
+// Takes each ADC24 frame read while an ADC24 histogram runs
+void hist_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    if ((hist_state == HIST_IDLE) || (hist_source >= HIST_SRC_ADC16_CH1))
+        return;
+    hist_add((hist_source == HIST_SRC_ADC24_CH1) ? ch1val : ch2val);
+}
+
+// Takes each ADC16 result that has come in while an ADC16 histogram runs,
+// selecting its input again if an ADC16 measurement has moved it; call from
+// the main loop
+void hist_service(void) {
+    uint16_t channel;
+
+    if ((hist_state == HIST_IDLE) || (hist_source < HIST_SRC_ADC16_CH1))
+        return;
+
+    channel = hist_source - HIST_SRC_ADC16_CH1;
+    if (SD1CON3bits.SDCH != channel) {
+        SD1CON3bits.SDCH = channel;
+        hist_settle = HIST_ADC16_SETTLE;
+    }
+    if (!sdadc1_ready())
+        return;
+    if (hist_settle) {
+        hist_settle--;
+        return;
+    }
+    hist_add((int32_t)(int16_t)SD1RESH - (int32_t)adc16_get_offset());
+}
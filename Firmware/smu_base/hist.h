@@ -0,0 +1,36 @@
+#ifndef _HIST_H_
+#define _HIST_H_
+
+#include <stdint.h>
+
+// Histogram: counts each sample of one ADC channel into hist_bins bins of
+// 2^hist_shift codes from hist_low, counting the samples outside them apart.
+#define HIST_SRC_ADC24_CH1  0
+#define HIST_SRC_ADC24_CH2  1
+#define HIST_SRC_ADC16_CH1  2
+#define HIST_SRC_ADC16_CH2  3
+
+#define HIST_BINS_MAX       64
+#define HIST_SHIFT_MAX      24
+
+// Results discarded after selecting an ADC16 input, as in adc16_meas_ch1()
+#define HIST_ADC16_SETTLE   5
+
+#define HIST_IDLE           0
+#define HIST_RUNNING        1
+
+extern uint16_t hist_source, hist_shift, hist_bins;
+extern int32_t hist_low;
+extern uint16_t hist_state;
+extern uint32_t hist_under, hist_over, hist_samples;
+
+void init_hist(void);
+void hist_clear(void);
+uint16_t hist_set_range(int32_t low, uint16_t shift, uint16_t bins);
+void hist_start(void);
+void hist_stop(void);
+uint16_t hist_adc24_wanted(void);
+void hist_adc24_frame(int32_t ch1val, int32_t ch2val);
+void hist_service(void);
+
+#endif
@@ -0,0 +1,174 @@
+#include <time.h>
+#include "pic24fj.h"
+#include "sim.h"
+#include "../smu_base.h"
+#include "../parser.h"
+#include "../cdc.h"
+#include "../benchmark.h"
+#include "../perf.h"
+
+// Benchmark harness for the host build.  Each case sends a command over the
+// simulated CDC link and runs the parser until the whole reply has come
+// back, reporting the host time taken per command (the cost of the parsing
+// and formatting code) and the simulated time on the board (the cost of the
+// peripheral transfers it makes).
+
+#define BENCH_REPLY_LENGTH  2048
+#define BENCH_NO_REPLY      0xFFFF
+
+uint8_t bench_reply[BENCH_REPLY_LENGTH];
+
+uint64_t bench_host_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Runs the firmware's main loop until length bytes of reply have arrived, 
+// until a reply line has arrived if length is 0, or until the command has 
+// been taken in if length is BENCH_NO_REPLY; returns the reply length
+uint16_t bench_loop(uint16_t length) {
+    uint16_t count, i;
+
+    if (length == BENCH_NO_REPLY) {
+        do {
+            parser_state();
+            sim_service();
+        } while (cdc_in_waiting());
+        return 0;
+    }
+
+    count = 0;
+    for (i = 0; i < 10000; i++) {
+        parser_state();
+        sim_service();
+        count += sim_cdc_read(bench_reply + count, BENCH_REPLY_LENGTH - 1 - count);
+        if (length ? (count >= length) : (count && (bench_reply[count - 1] == '\n')))
+            break;
+    }
+    bench_reply[count] = '\0';
+    return count;
+}
+
+uint16_t bench_command(char *cmd, uint16_t length) {
+    sim_cdc_write((uint8_t *)cmd, strlen(cmd));
+    sim_cdc_write((uint8_t *)"\r", 1);
+    return bench_loop(length);
+}
+
+void bench_report(char *name, uint32_t iterations, uint64_t host_ns, uint64_t sim_ns) {
+    printf("%-28s %8u %12.1f %12.1f\n", name, iterations,
+           (double)host_ns / iterations, (double)sim_ns / iterations / 1000.);
+}
+
+void bench_case(char *name, char *cmd, uint16_t length, uint32_t iterations) {
+    uint64_t host_start, sim_start;
+    uint32_t i;
+
+    if ((bench_command(cmd, length) == 0) && (length != BENCH_NO_REPLY)) {
+        printf("%-28s no reply\n", name);
+        return;
+    }
+    host_start = bench_host_ns();
+    sim_start = sim_time_ns;
+    for (i = 0; i < iterations; i++)
+        bench_command(cmd, length);
+    bench_report(name, iterations, bench_host_ns() - host_start, sim_time_ns - sim_start);
+}
+
+// Counts ADC24 stream frames arriving over the CDC link
+void bench_stream(uint32_t frames) {
+    uint64_t host_start, sim_start;
+    uint32_t count;
+    uint16_t n;
+
+    bench_command("ADC24:STREAM ON", BENCH_NO_REPLY);
+    host_start = bench_host_ns();
+    sim_start = sim_time_ns;
+    count = 0;
+    while (count < frames * ADC24_STREAM_FRAME_LENGTH) {
+        parser_state();
+        sim_service();
+        while ((n = sim_cdc_read(bench_reply, BENCH_REPLY_LENGTH)))
+            count += n;
+    }
+    bench_report("ADC24:STREAM frame", frames, bench_host_ns() - host_start, sim_time_ns - sim_start);
+    bench_command("ADC24:STREAM OFF", BENCH_NO_REPLY);
+    while (sim_cdc_read(bench_reply, BENCH_REPLY_LENGTH)) {}
+}
+
+// Time to compute the CRC-32 of a 192-byte flash row
+void bench_crc(uint32_t iterations) {
+    uint64_t host_start;
+    uint32_t i, crc;
+    uint16_t j;
+
+    crc = 0xFFFFFFFF;
+    host_start = bench_host_ns();
+    for (i = 0; i < iterations; i++)
+        for (j = 0; j < FLASH_ROW_BYTES; j++)
+            crc = crc32_update(crc, (uint8_t)j);
+    bench_report("crc32_update (row)", iterations, bench_host_ns() - host_start, 0);
+    if (crc == 0)
+        printf("\n");
+}
+
+// Runs the firmware's own micro-benchmarks (BENCH:RUN) and prints the cycle
+// counts it reports, which on the host are in units of 62.5 ns of host plus
+// simulated time
+void bench_firmware(void) {
+    static char *names[BENCH_CASES] = { "str_tok_r (command)", "dispatch UI:LED1?", 
+                                        "dispatch ADC24:STREAM?", "hex2str_alt", 
+                                        "4-value reply", "cdc_putc (byte)", 
+                                        "U1putc (byte)", "ADC24 frame" };
+    char *token;
+    uint16_t i;
+
+    bench_command("BENCH:RUN", BENCH_NO_REPLY);
+    bench_command("BENCH:RESULTS?", 0);
+    printf("\n%-28s %8s\n", "BENCH:RESULTS?", "cycles");
+    token = strtok((char *)bench_reply, ",\r\n");
+    for (i = 0; (i < BENCH_CASES) && token; i++) {
+        printf("%-28s %8lu\n", names[i], strtoul(token, (char **)NULL, 16));
+        token = strtok((char *)NULL, ",\r\n");
+    }
+}
+
+// Prints what the profiling probes accumulated over the whole run
+void bench_perf(void) {
+    static char *names[PERF_PROBES] = { "usb_service", "parser_state", "dispatch", 
+                                        "stream", "wait DRDY", "wait SPI1", 
+                                        "wait SPI2", "wait SD ADC", "wait NVM" };
+    uint16_t i;
+
+    printf("\n%-28s %8s %12s %10s %10s\n", "PERF?", "count", "mean", "min", "max");
+    for (i = 0; i < PERF_PROBES; i++)
+        if (perf_probes[i].count)
+            printf("%-28s %8u %12.1f %10u %10u\n", names[i], perf_probes[i].count, 
+                   (double)perf_probes[i].total / perf_probes[i].count, 
+                   perf_probes[i].min, perf_probes[i].max);
+}
+
+int main(int argc, char **argv) {
+    uint32_t n;
+
+    n = (argc > 1) ? strtoul(argv[1], (char **)NULL, 10) : 1000;
+
+    init_sim();
+    init_smu_base();
+    init_parser();
+
+    printf("%-28s %8s %12s %12s\n", "case", "n", "host ns/op", "sim us/op");
+    bench_case("UI:LED1?", "UI:LED1?", 0, 10 * n);
+    bench_case("DAC16:CH1", "DAC16:CH1 9000,7000", BENCH_NO_REPLY, 10 * n);
+    bench_case("DAC16:ALL", "DAC16:ALL 1000,2000,3000,4000", BENCH_NO_REPLY, 10 * n);
+    bench_case("ADC16:CH1?", "ADC16:CH1?", 0, n);
+    bench_case("ADC24:BOTH?", "ADC24:BOTH?", 0, n);
+    bench_case("FLASH:READBIN (512 instr)", "FLASH:READBIN 1,0,200", 3 * 512 + 7, n);
+    bench_stream(n);
+    bench_crc(10 * n);
+    bench_firmware();
+    bench_perf();
+    return 0;
+}
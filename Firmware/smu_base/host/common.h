@@ -0,0 +1,43 @@
+#ifndef _COMMON_H_
+#define _COMMON_H_
+
+// Host build stand-in for ../lib/common.h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// xc16-specific attributes and inline assembly have no host equivalent
+#define interrupt
+#define auto_psv
+#define space(x)
+#define __asm__(x)
+
+typedef union {
+    int16_t i;
+    uint16_t w;
+    uint8_t b[2];
+} WORD;
+
+typedef union {
+    int32_t l;
+    uint32_t ul;
+    uint16_t w[2];
+    uint8_t b[4];
+} WORD32;
+
+typedef union {
+    int64_t ll;
+    uint64_t ull;
+    uint16_t w[4];
+    uint8_t b[8];
+} WORD64;
+
+// The simulated peripherals run in the same thread as the firmware, so 
+// there is nothing to mask
+#define disable_interrupts()
+#define enable_interrupts()
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef _PIC24FJ_H_
+#define _PIC24FJ_H_
+
+// Simulated register layer for the host build.  Stands in for the xc16 
+// device header, declaring the SFRs used by the firmware core as ordinary 
+// variables (defined in sim.c), each with its bit fields where the firmware 
+// uses them.  Registers whose reads reflect what the hardware is doing (the 
+// port registers, through which pins driven by the simulated peripherals are 
+// read) are accessed through sim_read_port(), and the table read/write and 
+// NVM builtins operate on a simulated program memory.
+
+#include "common.h"
+
+#define SFR_WORD(name)  extern volatile uint16_t name;
+#define SFR_BITS(name, fields) \
+    typedef struct { fields } name##BITS; \
+    typedef union { uint16_t w; name##BITS bits; } name##_SFR_T; \
+    extern volatile name##_SFR_T name##_sfr;
+
+#define BITS16(p) \
+    uint16_t p##0:1; uint16_t p##1:1; uint16_t p##2:1; uint16_t p##3:1; \
+    uint16_t p##4:1; uint16_t p##5:1; uint16_t p##6:1; uint16_t p##7:1; \
+    uint16_t p##8:1; uint16_t p##9:1; uint16_t p##10:1; uint16_t p##11:1; \
+    uint16_t p##12:1; uint16_t p##13:1; uint16_t p##14:1; uint16_t p##15:1;
+
+// I/O ports.  A port and its latch share storage, as writes to a PORT 
+// register go to its latch; reading a port through sim_read_port() first 
+// updates the bits of its input pins from the simulated peripherals.
+#define SFR_PORT(p) \
+    typedef struct { BITS16(R##p) } PORT##p##BITS; \
+    typedef struct { BITS16(LAT##p) } LAT##p##BITS; \
+    typedef union { uint16_t w; PORT##p##BITS port; LAT##p##BITS lat; } PORT##p##_SFR_T; \
+    extern volatile PORT##p##_SFR_T PORT##p##_sfr; \
+    SFR_BITS(TRIS##p, BITS16(TRIS##p)) \
+    SFR_BITS(ANS##p, BITS16(ANS##p))
+
+#define SIM_PORTB           1
+#define SIM_PORTC           2
+#define SIM_PORTD           3
+#define SIM_PORTE           4
+#define SIM_PORTF           5
+#define SIM_PORTG           6
+
+volatile void *sim_read_port(uint16_t port);
+
+SFR_PORT(B)
+SFR_PORT(C)
+SFR_PORT(D)
+SFR_PORT(E)
+SFR_PORT(F)
+SFR_PORT(G)
+
+#define PORTB               (((volatile PORTB_SFR_T *)sim_read_port(SIM_PORTB))->w)
+#define PORTC               (((volatile PORTC_SFR_T *)sim_read_port(SIM_PORTC))->w)
+#define PORTD               (((volatile PORTD_SFR_T *)sim_read_port(SIM_PORTD))->w)
+#define PORTE               (((volatile PORTE_SFR_T *)sim_read_port(SIM_PORTE))->w)
+#define PORTF               (((volatile PORTF_SFR_T *)sim_read_port(SIM_PORTF))->w)
+#define PORTG               (((volatile PORTG_SFR_T *)sim_read_port(SIM_PORTG))->w)
+#define PORTBbits           (((volatile PORTB_SFR_T *)sim_read_port(SIM_PORTB))->port)
+#define PORTCbits           (((volatile PORTC_SFR_T *)sim_read_port(SIM_PORTC))->port)
+#define PORTDbits           (((volatile PORTD_SFR_T *)sim_read_port(SIM_PORTD))->port)
+#define PORTEbits           (((volatile PORTE_SFR_T *)sim_read_port(SIM_PORTE))->port)
+#define PORTFbits           (((volatile PORTF_SFR_T *)sim_read_port(SIM_PORTF))->port)
+#define PORTGbits           (((volatile PORTG_SFR_T *)sim_read_port(SIM_PORTG))->port)
+
+#define LATB                PORTB_sfr.w
+#define LATC                PORTC_sfr.w
+#define LATD                PORTD_sfr.w
+#define LATE                PORTE_sfr.w
+#define LATF                PORTF_sfr.w
+#define LATG                PORTG_sfr.w
+#define LATBbits            PORTB_sfr.lat
+#define LATCbits            PORTC_sfr.lat
+#define LATDbits            PORTD_sfr.lat
+#define LATEbits            PORTE_sfr.lat
+#define LATFbits            PORTF_sfr.lat
+#define LATGbits            PORTG_sfr.lat
+
+#define TRISB               TRISB_sfr.w
+#define TRISC               TRISC_sfr.w
+#define TRISD               TRISD_sfr.w
+#define TRISE               TRISE_sfr.w
+#define TRISF               TRISF_sfr.w
+#define TRISG               TRISG_sfr.w
+#define TRISBbits           TRISB_sfr.bits
+#define TRISCbits           TRISC_sfr.bits
+#define TRISDbits           TRISD_sfr.bits
+#define TRISEbits           TRISE_sfr.bits
+#define TRISFbits           TRISF_sfr.bits
+#define TRISGbits           TRISG_sfr.bits
+
+#define ANSB                ANSB_sfr.w
+#define ANSC                ANSC_sfr.w
+#define ANSD                ANSD_sfr.w
+#define ANSE                ANSE_sfr.w
+#define ANSF                ANSF_sfr.w
+#define ANSG                ANSG_sfr.w
+#define ANSBbits            ANSB_sfr.bits
+#define ANSCbits            ANSC_sfr.bits
+#define ANSDbits            ANSD_sfr.bits
+#define ANSEbits            ANSE_sfr.bits
+#define ANSFbits            ANSF_sfr.bits
+#define ANSGbits            ANSG_sfr.bits
+
+// Oscillator
+SFR_WORD(CLKDIV)
+SFR_BITS(OSCCON, uint16_t OSWEN:1; uint16_t SOSCEN:1; uint16_t :14;)
+SFR_BITS(OSCTUN, uint16_t TUN:6; uint16_t :9; uint16_t STEN:1;)
+
+#define OSCCON              OSCCON_sfr.w
+#define OSCCONbits          OSCCON_sfr.bits
+#define OSCTUN              OSCTUN_sfr.w
+#define OSCTUNbits          OSCTUN_sfr.bits
+
+// Peripheral pin select (RPORn and RPINRn are indexed as byte arrays)
+extern volatile uint16_t RPOR_sfr[16], RPINR_sfr[32];
+
+#define RPOR0               RPOR_sfr[0]
+#define RPINR0              RPINR_sfr[0]
+
+// Interrupt flags and enables
+SFR_BITS(IFS0, uint16_t :3; uint16_t T1IF:1; uint16_t :3; uint16_t T2IF:1; uint16_t T3IF:1; uint16_t :2; uint16_t U1RXIF:1; uint16_t U1TXIF:1; uint16_t :3;)
+SFR_BITS(IEC0, uint16_t :3; uint16_t T1IE:1; uint16_t :3; uint16_t T2IE:1; uint16_t T3IE:1; uint16_t :2; uint16_t U1RXIE:1; uint16_t U1TXIE:1; uint16_t :3;)
+SFR_BITS(IFS1, uint16_t :4; uint16_t INT1IF:1; uint16_t :7; uint16_t T5IF:1; uint16_t INT2IF:1; uint16_t :2;)
+SFR_BITS(IEC1, uint16_t :4; uint16_t INT1IE:1; uint16_t :7; uint16_t T5IE:1; uint16_t INT2IE:1; uint16_t :2;)
+SFR_BITS(IFS3, uint16_t :5; uint16_t INT3IF:1; uint16_t :10;)
+SFR_BITS(IEC3, uint16_t :5; uint16_t INT3IE:1; uint16_t :10;)
+SFR_BITS(IPC0, uint16_t :12; uint16_t T1IP:3; uint16_t :1;)
+SFR_BITS(IPC5, uint16_t INT1IP:3; uint16_t :13;)
+SFR_BITS(IPC7, uint16_t T5IP:3; uint16_t :1; uint16_t INT2IP:3; uint16_t :9;)
+SFR_BITS(IPC13, uint16_t :4; uint16_t INT3IP:3; uint16_t :9;)
+SFR_BITS(INTCON2, uint16_t INT0EP:1; uint16_t INT1EP:1; uint16_t INT2EP:1; uint16_t INT3EP:1; uint16_t :12;)
+SFR_BITS(IFS6, uint16_t SDA1IF:1; uint16_t :15;)
+
+#define IFS0                IFS0_sfr.w
+#define IFS0bits            IFS0_sfr.bits
+#define IEC0                IEC0_sfr.w
+#define IEC0bits            IEC0_sfr.bits
+#define IFS1                IFS1_sfr.w
+#define IFS1bits            IFS1_sfr.bits
+#define IEC1                IEC1_sfr.w
+#define IEC1bits            IEC1_sfr.bits
+#define IFS3                IFS3_sfr.w
+#define IFS3bits            IFS3_sfr.bits
+#define IEC3                IEC3_sfr.w
+#define IEC3bits            IEC3_sfr.bits
+#define IPC0                IPC0_sfr.w
+#define IPC0bits            IPC0_sfr.bits
+#define IPC5                IPC5_sfr.w
+#define IPC5bits            IPC5_sfr.bits
+#define IPC7                IPC7_sfr.w
+#define IPC7bits            IPC7_sfr.bits
+#define IPC13               IPC13_sfr.w
+#define IPC13bits           IPC13_sfr.bits
+#define INTCON2             INTCON2_sfr.w
+#define INTCON2bits         INTCON2_sfr.bits
+#define IFS6                IFS6_sfr.w
+#define IFS6bits            IFS6_sfr.bits
+
+// Timer1 and Timer5 (pace the pattern generator and the logic capture; 
+// their interrupts are run from sim_service())
+SFR_WORD(T1CON)
+SFR_WORD(TMR1)
+SFR_WORD(PR1)
+SFR_WORD(T5CON)
+SFR_WORD(TMR5)
+SFR_WORD(PR5)
+
+// Timer2/3 (the 32-bit timebase is read through tmr23_read())
+SFR_BITS(T2CON, uint16_t :1; uint16_t TCS:1; uint16_t :1; uint16_t T32:1; uint16_t TCKPS:2; uint16_t TGATE:1; uint16_t :6; uint16_t TSIDL:1; uint16_t :1; uint16_t TON:1;)
+SFR_WORD(T3CON)
+SFR_WORD(TMR2)
+SFR_WORD(TMR3)
+SFR_WORD(TMR3HLD)
+SFR_WORD(PR2)
+SFR_WORD(PR3)
+
+#define T2CON               T2CON_sfr.w
+#define T2CONbits           T2CON_sfr.bits
+
+// 12-bit DACs
+SFR_WORD(DAC1CON)
+SFR_WORD(DAC1DAT)
+SFR_WORD(DAC2CON)
+SFR_WORD(DAC2DAT)
+
+// 16-bit sigma-delta ADC
+SFR_BITS(SD1CON1, uint16_t PWRLVL:1; uint16_t :1; uint16_t SDREFP:1; uint16_t SDREFN:1; uint16_t VOSCAL:1; uint16_t :1; uint16_t DITHER:2; uint16_t SDGAIN:3; uint16_t :1; uint16_t SDRST:1; uint16_t SDSIDL:1; uint16_t :1; uint16_t SDON:1;)
+SFR_BITS(SD1CON3, uint16_t SDCH:3; uint16_t :3; uint16_t SDCS:2; uint16_t SDOSR:3; uint16_t :2; uint16_t SDDIV:3;)
+SFR_WORD(SD1CON2)
+SFR_WORD(SD1RESH)
+SFR_WORD(SD1RESL)
+
+#define SD1CON1             SD1CON1_sfr.w
+#define SD1CON1bits         SD1CON1_sfr.bits
+#define SD1CON3             SD1CON3_sfr.w
+#define SD1CON3bits         SD1CON3_sfr.bits
+
+// SPI1 and SPI2 (exchanges go through spi1/spi2_exchange() and _transfer())
+SFR_WORD(SPI1CON1)
+SFR_WORD(SPI1CON2)
+SFR_WORD(SPI1STAT)
+SFR_WORD(SPI2CON1)
+SFR_WORD(SPI2CON2)
+SFR_WORD(SPI2STAT)
+
+// Output compare 1 (the ADS1292 clock), 2 to 7 (PWM, with Timer4), and 8 
+// (the exported sync clock)
+SFR_WORD(OC1CON1)
+SFR_WORD(OC1CON2)
+SFR_WORD(OC1R)
+SFR_WORD(OC1RS)
+SFR_WORD(OC2CON1)
+SFR_WORD(OC2CON2)
+SFR_WORD(OC2R)
+SFR_WORD(OC2RS)
+SFR_WORD(OC2TMR)
+SFR_WORD(OC3CON1)
+SFR_WORD(OC3CON2)
+SFR_WORD(OC3R)
+SFR_WORD(OC3RS)
+SFR_WORD(OC3TMR)
+SFR_WORD(OC4CON1)
+SFR_WORD(OC4CON2)
+SFR_WORD(OC4R)
+SFR_WORD(OC4RS)
+SFR_WORD(OC4TMR)
+SFR_WORD(OC5CON1)
+SFR_WORD(OC5CON2)
+SFR_WORD(OC5R)
+SFR_WORD(OC5RS)
+SFR_WORD(OC5TMR)
+SFR_WORD(OC6CON1)
+SFR_WORD(OC6CON2)
+SFR_WORD(OC6R)
+SFR_WORD(OC6RS)
+SFR_WORD(OC6TMR)
+SFR_WORD(OC7CON1)
+SFR_WORD(OC7CON2)
+SFR_WORD(OC7R)
+SFR_WORD(OC7RS)
+SFR_WORD(OC7TMR)
+SFR_WORD(OC8CON1)
+SFR_WORD(OC8CON2)
+SFR_WORD(OC8R)
+SFR_WORD(OC8RS)
+SFR_WORD(T4CON)
+SFR_WORD(TMR4)
+SFR_WORD(PR4)
+
+// UART1 (transfers go through the uart1_*() functions)
+SFR_BITS(U1MODE, uint16_t STSEL:1; uint16_t PDSEL:2; uint16_t BRGH:1; uint16_t URXINV:1; uint16_t ABAUD:1; uint16_t LPBACK:1; uint16_t WAKE:1; uint16_t UEN:2; uint16_t :1; uint16_t RTSMD:1; uint16_t IREN:1; uint16_t USIDL:1; uint16_t :1; uint16_t UARTEN:1;)
+SFR_BITS(U1STA, uint16_t URXDA:1; uint16_t OERR:1; uint16_t FERR:1; uint16_t PERR:1; uint16_t RIDLE:1; uint16_t ADDEN:1; uint16_t URXISEL:2; uint16_t TRMT:1; uint16_t UTXBF:1; uint16_t UTXEN:1; uint16_t UTXBRK:1; uint16_t :1; uint16_t UTXISEL0:1; uint16_t UTXINV:1; uint16_t UTXISEL1:1;)
+SFR_WORD(U1BRG)
+
+#define U1MODE              U1MODE_sfr.w
+#define U1MODEbits          U1MODE_sfr.bits
+#define U1STA               U1STA_sfr.w
+#define U1STAbits           U1STA_sfr.bits
+
+// Program memory (the table read/write and NVM builtins act on sim.c's 
+// simulated program memory)
+SFR_WORD(TBLPAG)
+SFR_BITS(NVMCON, uint16_t NVMOP:4; uint16_t :8; uint16_t ERASE:1; uint16_t WRERR:1; uint16_t WREN:1; uint16_t WR:1;)
+
+#define NVMCON              NVMCON_sfr.w
+#define NVMCONbits          NVMCON_sfr.bits
+
+uint16_t sim_tblrdl(uint16_t offset);
+uint16_t sim_tblrdh(uint16_t offset);
+void sim_tblwtl(uint16_t offset, uint16_t val);
+void sim_tblwth(uint16_t offset, uint16_t val);
+void sim_write_nvm(void);
+
+#define __builtin_tblrdl(offset)        sim_tblrdl(offset)
+#define __builtin_tblrdh(offset)        sim_tblrdh(offset)
+#define __builtin_tblwtl(offset, val)   sim_tblwtl(offset, val)
+#define __builtin_tblwth(offset, val)   sim_tblwth(offset, val)
+#define __builtin_write_NVM()           sim_write_nvm()
+#define __builtin_write_OSCCONL(val)    (OSCCON = (OSCCON & 0xFF00) | ((val) & 0xFF))
+
+#define Nop()
+#define ClrWdt()
+
+#endif
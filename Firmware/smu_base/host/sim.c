@@ -0,0 +1,728 @@
+#include <time.h>
+#include "pic24fj.h"
+#include "sim.h"
+#include "../hal.h"
+#include "../smu_base.h"
+#include "../cdc.h"
+
+#define SIM_QUEUE_LENGTH    65536
+
+#define FLASH_INSTRUCTIONS  0xAC00
+#define FLASH_BLANK         0xFFFFFF
+
+// ADS1292 commands (see smu_base.h) are decoded byte by byte as they arrive
+#define ADS_IDLE            0
+#define ADS_RREG_COUNT      1
+#define ADS_RREG_DATA       2
+#define ADS_WREG_COUNT      3
+#define ADS_WREG_DATA       4
+#define ADS_RDATA           5
+
+typedef struct {
+    uint8_t data[SIM_QUEUE_LENGTH];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+} SIM_QUEUE_T;
+
+uint64_t sim_time_ns;
+uint64_t sim_host_start_ns;
+uint64_t sim_sdadc1_next;
+
+// Register storage for the simulated register layer (see pic24fj.h)
+volatile PORTB_SFR_T PORTB_sfr;
+volatile PORTC_SFR_T PORTC_sfr;
+volatile PORTD_SFR_T PORTD_sfr;
+volatile PORTE_SFR_T PORTE_sfr;
+volatile PORTF_SFR_T PORTF_sfr;
+volatile PORTG_SFR_T PORTG_sfr;
+volatile TRISB_SFR_T TRISB_sfr;
+volatile TRISC_SFR_T TRISC_sfr;
+volatile TRISD_SFR_T TRISD_sfr;
+volatile TRISE_SFR_T TRISE_sfr;
+volatile TRISF_SFR_T TRISF_sfr;
+volatile TRISG_SFR_T TRISG_sfr;
+volatile ANSB_SFR_T ANSB_sfr;
+volatile ANSC_SFR_T ANSC_sfr;
+volatile ANSD_SFR_T ANSD_sfr;
+volatile ANSE_SFR_T ANSE_sfr;
+volatile ANSF_SFR_T ANSF_sfr;
+volatile ANSG_SFR_T ANSG_sfr;
+volatile uint16_t CLKDIV;
+volatile OSCCON_SFR_T OSCCON_sfr;
+volatile OSCTUN_SFR_T OSCTUN_sfr;
+volatile uint16_t RPOR_sfr[16], RPINR_sfr[32];
+volatile IFS0_SFR_T IFS0_sfr;
+volatile IEC0_SFR_T IEC0_sfr;
+volatile IFS1_SFR_T IFS1_sfr;
+volatile IEC1_SFR_T IEC1_sfr;
+volatile IFS3_SFR_T IFS3_sfr;
+volatile IEC3_SFR_T IEC3_sfr;
+volatile IPC0_SFR_T IPC0_sfr;
+volatile IPC5_SFR_T IPC5_sfr;
+volatile IPC7_SFR_T IPC7_sfr;
+volatile IPC13_SFR_T IPC13_sfr;
+volatile INTCON2_SFR_T INTCON2_sfr;
+volatile IFS6_SFR_T IFS6_sfr;
+volatile uint16_t T1CON, TMR1, PR1;
+volatile uint16_t T5CON, TMR5, PR5;
+volatile T2CON_SFR_T T2CON_sfr;
+volatile uint16_t T3CON, TMR2, TMR3, TMR3HLD, PR2, PR3;
+volatile uint16_t DAC1CON, DAC1DAT, DAC2CON, DAC2DAT;
+volatile SD1CON1_SFR_T SD1CON1_sfr;
+volatile SD1CON3_SFR_T SD1CON3_sfr;
+volatile uint16_t SD1CON2, SD1RESH, SD1RESL;
+volatile uint16_t SPI1CON1, SPI1CON2, SPI1STAT;
+volatile uint16_t SPI2CON1, SPI2CON2, SPI2STAT;
+volatile uint16_t OC1CON1, OC1CON2, OC1R, OC1RS;
+volatile uint16_t OC2CON1, OC2CON2, OC2R, OC2RS, OC2TMR;
+volatile uint16_t OC3CON1, OC3CON2, OC3R, OC3RS, OC3TMR;
+volatile uint16_t OC4CON1, OC4CON2, OC4R, OC4RS, OC4TMR;
+volatile uint16_t OC5CON1, OC5CON2, OC5R, OC5RS, OC5TMR;
+volatile uint16_t OC6CON1, OC6CON2, OC6R, OC6RS, OC6TMR;
+volatile uint16_t OC7CON1, OC7CON2, OC7R, OC7RS, OC7TMR;
+volatile uint16_t OC8CON1, OC8CON2, OC8R, OC8RS;
+volatile uint16_t T4CON, TMR4, PR4;
+volatile U1MODE_SFR_T U1MODE_sfr;
+volatile U1STA_SFR_T U1STA_sfr;
+volatile uint16_t U1BRG;
+volatile uint16_t TBLPAG;
+volatile NVMCON_SFR_T NVMCON_sfr;
+
+// Program memory and its write latches
+uint32_t sim_flash[FLASH_INSTRUCTIONS];
+uint32_t sim_flash_latch[FLASH_ROW_INSTRUCTIONS];
+uint32_t sim_flash_address;
+
+// DAC8564 model
+struct {
+    uint8_t frame[3];
+    uint16_t count;
+    uint16_t buffer[4];
+    uint16_t output[4];
+} dac8564;
+
+// ADS1292 model
+struct {
+    uint8_t regs[12];
+    uint16_t state;
+    uint16_t index;
+    uint16_t count;
+    uint8_t data[9];
+    uint16_t running;
+    uint16_t drdy;
+    uint64_t next_conversion;
+    int32_t offset[2];
+} ads1292;
+
+SIM_SOURCE_T adc16_source, adc24_source;
+uint16_t sim_sw1;
+uint32_t sim_noise_state;
+
+SIM_QUEUE_T cdc_rx, cdc_tx, ble_rx, ble_tx;
+
+void _U1TXInterrupt(void);
+void _U1RXInterrupt(void);
+void _T1Interrupt(void);
+void _T5Interrupt(void);
+void _INT1Interrupt(void);
+
+uint64_t sim_host_ns(void);
+
+// Queue functions
+void sim_queue_reset(SIM_QUEUE_T *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->count = 0;
+}
+
+void sim_queue_put(SIM_QUEUE_T *queue, uint8_t ch) {
+    if (queue->count == SIM_QUEUE_LENGTH)   // drop the oldest byte if the
+        queue->head = (queue->head + 1) % SIM_QUEUE_LENGTH; //   host end has
+    else                                                    //   stopped reading
+        queue->count++;
+    queue->data[queue->tail] = ch;
+    queue->tail = (queue->tail + 1) % SIM_QUEUE_LENGTH;
+}
+
+uint8_t sim_queue_get(SIM_QUEUE_T *queue) {
+    uint8_t ch;
+
+    if (queue->count == 0)
+        return 0;
+    ch = queue->data[queue->head];
+    queue->head = (queue->head + 1) % SIM_QUEUE_LENGTH;
+    queue->count--;
+    return ch;
+}
+
+// A small, repeatable source of measurement noise
+int32_t sim_noise(int32_t amplitude) {
+    sim_noise_state = sim_noise_state * 1664525 + 1013904223;
+    return (int32_t)((sim_noise_state >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// By default, each ADC channel reads back the difference between its pair
+// of DAC16 outputs (DAC1 - DAC0 for CH1, DAC3 - DAC2 for CH2), so that
+// commands driving the DAC16 see a response
+int32_t sim_dac16_loopback(uint16_t channel, uint64_t time_ns) {
+    if (channel == 0)
+        return (int32_t)dac8564.output[1] - (int32_t)dac8564.output[0];
+    else
+        return (int32_t)dac8564.output[3] - (int32_t)dac8564.output[2];
+}
+
+int32_t sim_adc16_default(uint16_t channel, uint64_t time_ns) {
+    return sim_dac16_loopback(channel, time_ns) / 4;
+}
+
+int32_t sim_adc24_default(uint16_t channel, uint64_t time_ns) {
+    return 64 * sim_dac16_loopback(channel, time_ns);
+}
+
+void sim_set_adc16_source(SIM_SOURCE_T source) {
+    adc16_source = source ? source : sim_adc16_default;
+}
+
+void sim_set_adc24_source(SIM_SOURCE_T source) {
+    adc24_source = source ? source : sim_adc24_default;
+}
+
+uint16_t sim_dac16_output(uint16_t dac) {
+    return dac8564.output[dac & 3];
+}
+
+void sim_set_sw1(uint16_t val) {
+    sim_sw1 = val;
+}
+
+// Functions for the ADS1292 model
+void ads1292_reset(void) {
+    memset(ads1292.regs, 0, sizeof(ads1292.regs));
+    ads1292.regs[ADC24_REG_ID] = 0x53;
+    ads1292.regs[ADC24_REG_CONFIG1] = 0x02;
+    ads1292.regs[ADC24_REG_CONFIG2] = 0x80;
+    ads1292.regs[ADC24_REG_LOFF] = 0x10;
+    ads1292.regs[ADC24_REG_RESP2] = 0x02;
+    ads1292.regs[ADC24_REG_GPIO] = 0x0C;
+    ads1292.state = ADS_IDLE;
+    ads1292.running = FALSE;
+    ads1292.drdy = FALSE;
+}
+
+// Conversion period for the data rate set in CONFIG1, scaled from the
+// datasheet's 512-kHz modulator clock to the 551.7-kHz clock from OC1
+uint64_t ads1292_period_ns(void) {
+    return (uint64_t)1000000000 * 5120 / (125 * 5517) / (1 << (ads1292.regs[ADC24_REG_CONFIG1] & 0x07));
+}
+
+int32_t ads1292_channel(uint16_t channel) {
+    static const int32_t gains[8] = { 6, 1, 2, 3, 4, 8, 12, 6 };
+    uint8_t chset;
+    int32_t val;
+
+    chset = ads1292.regs[ADC24_REG_CH1SET + channel];
+    if ((chset & 0x0F) == 0x01)         // inputs shorted
+        val = 0;
+    else
+        val = adc24_source(channel, sim_time_ns) * gains[(chset >> 4) & 0x07];
+    val += ads1292.offset[channel] + sim_noise(8);
+    if (val > 0x7FFFFF)
+        val = 0x7FFFFF;
+    if (val < -0x800000)
+        val = -0x800000;
+    return val;
+}
+
+// Brings the model up to date with the START pin and, when conversions are
+// running and the firmware is waiting for DRDY, skips ahead to the next
+// conversion (the time the firmware would have spent polling)
+void ads1292_update(void) {
+    uint16_t running;
+
+    running = LATGbits.LATG8;
+    if (running && !ads1292.running)
+        ads1292.next_conversion = sim_time_ns + ads1292_period_ns();
+    ads1292.running = running;
+    if (!running)
+        ads1292.drdy = FALSE;
+    else if (!ads1292.drdy) {
+        if (sim_time_ns < ads1292.next_conversion)
+            sim_time_ns = ads1292.next_conversion;
+        ads1292.next_conversion += ads1292_period_ns();
+        ads1292.drdy = TRUE;
+    }
+}
+
+uint8_t ads1292_exchange(uint8_t mosi) {
+    int32_t val;
+    uint8_t miso;
+
+    miso = 0;
+    switch (ads1292.state) {
+        case ADS_IDLE:
+            if ((mosi & 0xE0) == ADC24_CMD_RREG) {
+                ads1292.index = mosi & 0x1F;
+                ads1292.state = ADS_RREG_COUNT;
+            } else if ((mosi & 0xE0) == ADC24_CMD_WREG) {
+                ads1292.index = mosi & 0x1F;
+                ads1292.state = ADS_WREG_COUNT;
+            } else if (mosi == ADC24_CMD_RDATA) {
+                ads1292.data[0] = 0xC0;
+                ads1292.data[1] = 0x00;
+                ads1292.data[2] = 0x00;
+                val = ads1292_channel(0);
+                ads1292.data[3] = (uint8_t)(val >> 16);
+                ads1292.data[4] = (uint8_t)(val >> 8);
+                ads1292.data[5] = (uint8_t)val;
+                val = ads1292_channel(1);
+                ads1292.data[6] = (uint8_t)(val >> 16);
+                ads1292.data[7] = (uint8_t)(val >> 8);
+                ads1292.data[8] = (uint8_t)val;
+                ads1292.drdy = FALSE;
+                ads1292.count = 0;
+                ads1292.state = ADS_RDATA;
+            } else if (mosi == ADC24_CMD_RESET) {
+                ads1292_reset();
+            }
+            break;
+        case ADS_RREG_COUNT:
+        case ADS_WREG_COUNT:
+            ads1292.count = (mosi & 0x1F) + 1;
+            ads1292.state = (ads1292.state == ADS_RREG_COUNT) ? ADS_RREG_DATA : ADS_WREG_DATA;
+            break;
+        case ADS_RREG_DATA:
+            miso = (ads1292.index < sizeof(ads1292.regs)) ? ads1292.regs[ads1292.index] : 0;
+            ads1292.index++;
+            if (--ads1292.count == 0)
+                ads1292.state = ADS_IDLE;
+            break;
+        case ADS_WREG_DATA:
+            if ((ads1292.index > ADC24_REG_ID) && (ads1292.index < sizeof(ads1292.regs)))
+                ads1292.regs[ads1292.index] = mosi;
+            ads1292.index++;
+            if (--ads1292.count == 0)
+                ads1292.state = ADS_IDLE;
+            break;
+        case ADS_RDATA:
+            miso = ads1292.data[ads1292.count++];
+            if (ads1292.count == sizeof(ads1292.data))
+                ads1292.state = ADS_IDLE;
+            break;
+    }
+    return miso;
+}
+
+// Functions for the DAC8564 model
+uint8_t dac8564_exchange(uint8_t mosi) {
+    uint16_t dac, i;
+
+    dac8564.frame[dac8564.count++] = mosi;
+    if (dac8564.count == 3) {
+        dac8564.count = 0;
+        dac = (dac8564.frame[0] >> 1) & 0x03;
+        dac8564.buffer[dac] = ((uint16_t)dac8564.frame[1] << 8) | dac8564.frame[2];
+        switch ((dac8564.frame[0] >> 4) & 0x03) {
+            case 1:                     // load the addressed DAC
+                dac8564.output[dac] = dac8564.buffer[dac];
+                break;
+            case 2:                     // load all DACs simultaneously
+                for (i = 0; i < 4; i++)
+                    dac8564.output[i] = dac8564.buffer[i];
+                break;
+        }
+    }
+    return 0;
+}
+
+// Simulated register layer
+volatile void *sim_read_port(uint16_t port) {
+    switch (port) {
+        case SIM_PORTB:
+            PORTB_sfr.port.RB5 = 0;     // BLE module always ready to receive
+            return &PORTB_sfr;
+        case SIM_PORTC:
+            PORTC_sfr.port.RC15 = sim_sw1;
+            return &PORTC_sfr;
+        case SIM_PORTD:
+            return &PORTD_sfr;
+        case SIM_PORTE:
+            return &PORTE_sfr;
+        case SIM_PORTF:
+            ads1292_update();
+            PORTF_sfr.port.RF3 = !ads1292.drdy;
+            return &PORTF_sfr;
+        default:
+            return &PORTG_sfr;
+    }
+}
+
+uint32_t sim_flash_index(uint16_t offset) {
+    return ((((uint32_t)TBLPAG) << 16) | offset) >> 1;
+}
+
+uint16_t sim_tblrdl(uint16_t offset) {
+    uint32_t i;
+
+    if ((TBLPAG == 0xFF) && (offset == 0))
+        return 0x4889;                  // DEVID of a PIC24FJ128GC006
+    i = sim_flash_index(offset);
+    return (i < FLASH_INSTRUCTIONS) ? (uint16_t)sim_flash[i] : 0;
+}
+
+uint16_t sim_tblrdh(uint16_t offset) {
+    uint32_t i;
+
+    i = sim_flash_index(offset);
+    return (i < FLASH_INSTRUCTIONS) ? (uint16_t)(sim_flash[i] >> 16) : 0;
+}
+
+void sim_tblwtl(uint16_t offset, uint16_t val) {
+    uint32_t *latch;
+
+    sim_flash_address = sim_flash_index(offset);
+    latch = &sim_flash_latch[sim_flash_address % FLASH_ROW_INSTRUCTIONS];
+    *latch = (*latch & 0xFF0000) | val;
+}
+
+void sim_tblwth(uint16_t offset, uint16_t val) {
+    uint32_t *latch;
+
+    sim_flash_address = sim_flash_index(offset);
+    latch = &sim_flash_latch[sim_flash_address % FLASH_ROW_INSTRUCTIONS];
+    *latch = (*latch & 0x00FFFF) | ((uint32_t)(val & 0xFF) << 16);
+}
+
+void sim_write_nvm(void) {
+    uint32_t base, i;
+
+    if (NVMCONbits.WREN == 0)
+        return;
+    switch (NVMCONbits.NVMOP) {
+        case 0x2:                       // erase a page
+            base = sim_flash_address & ~(uint32_t)(FLASH_PAGE_INSTRUCTIONS - 1);
+            for (i = base; (i < base + FLASH_PAGE_INSTRUCTIONS) && (i < FLASH_INSTRUCTIONS); i++)
+                sim_flash[i] = FLASH_BLANK;
+            sim_time_ns += 20000000;
+            break;
+        case 0x1:                       // program a row
+            base = sim_flash_address & ~(uint32_t)(FLASH_ROW_INSTRUCTIONS - 1);
+            for (i = 0; (i < FLASH_ROW_INSTRUCTIONS) && (base + i < FLASH_INSTRUCTIONS); i++)
+                sim_flash[base + i] &= sim_flash_latch[i];
+            sim_time_ns += 1500000;
+            break;
+    }
+    for (i = 0; i < FLASH_ROW_INSTRUCTIONS; i++)
+        sim_flash_latch[i] = FLASH_BLANK;
+}
+
+// Hardware abstraction layer (see hal.h)
+
+// Time taken to shift 8 bits at the SCK frequency that SPIxCON1 selects 
+// (FCY divided by the primary and secondary prescale ratios)
+uint32_t sim_spi_byte_ns(uint16_t con1) {
+    static const uint16_t primary[4] = { 64, 16, 4, 1 };
+
+    return 500 * primary[con1 & 0x03] * (8 - ((con1 >> 2) & 0x07));
+}
+
+uint8_t spi1_exchange(uint8_t ch) {
+    sim_time_ns += sim_spi_byte_ns(SPI1CON1);
+    return dac8564_exchange(ch);
+}
+
+uint8_t spi2_exchange(uint8_t ch) {
+    sim_time_ns += sim_spi_byte_ns(SPI2CON1);
+    ads1292_update();
+    return ads1292_exchange(ch);
+}
+
+void spi1_transfer(uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint16_t i;
+    uint8_t ch;
+
+    for (i = 0; i < length; i++) {
+        ch = spi1_exchange(tx ? tx[i] : 0);
+        if (rx)
+            rx[i] = ch;
+    }
+}
+
+void spi2_transfer(uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint16_t i;
+    uint8_t ch;
+
+    for (i = 0; i < length; i++) {
+        ch = spi2_exchange(tx ? tx[i] : 0);
+        if (rx)
+            rx[i] = ch;
+    }
+}
+
+// Puts a conversion of the selected sigma-delta ADC input, taken at the 
+// specified time, in SD1RESH
+#define SDADC1_PERIOD_NS    1024000     // one conversion at 976.5625 S/s
+
+void sdadc1_convert(uint64_t time_ns) {
+    int32_t val;
+
+    if (SD1CON1bits.VOSCAL)
+        val = -37;
+    else if (SD1CON3bits.SDCH == 3)
+        val = 31500 - 37;
+    else
+        val = adc16_source(SD1CON3bits.SDCH, time_ns) - 37;
+    val += sim_noise(2);
+    if (val > 32767)
+        val = 32767;
+    if (val < -32768)
+        val = -32768;
+    SD1RESH = (uint16_t)val;
+}
+
+void sdadc1_wait(void) {
+    sim_time_ns += SDADC1_PERIOD_NS;
+    sim_sdadc1_next = sim_time_ns + SDADC1_PERIOD_NS;
+    sdadc1_convert(sim_time_ns);
+    IFS6bits.SDA1IF = 1;
+}
+
+// Converts once per conversion period of board time, as the free-running 
+// sigma-delta ADC does, without advancing the time; a result not taken 
+// before the next conversion is lost
+uint16_t sdadc1_ready(void) {
+    uint64_t now, time_ns;
+
+    now = sim_time_ns + sim_host_ns() - sim_host_start_ns;
+    if (now < sim_sdadc1_next)
+        return 0;
+    time_ns = now - (now - sim_sdadc1_next) % SDADC1_PERIOD_NS;
+    sim_sdadc1_next = time_ns + SDADC1_PERIOD_NS;
+    sdadc1_convert(time_ns);
+    IFS6bits.SDA1IF = 0;
+    return 1;
+}
+
+uint16_t uart1_tx_ready(void) {
+    return TRUE;
+}
+
+void uart1_tx(uint8_t ch) {
+    sim_queue_put(&ble_tx, ch);
+}
+
+uint16_t uart1_rx_ready(void) {
+    return ble_rx.count != 0;
+}
+
+uint8_t uart1_rx(void) {
+    return sim_queue_get(&ble_rx);
+}
+
+// Timer2/3 counts the simulated board time plus the host time spent since
+// init_sim(), so that intervals timed with it include both the peripheral
+// transfers and the (much faster) host execution of the firmware code
+uint64_t sim_host_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t tmr23_read(void) {
+    return (uint32_t)((sim_time_ns + sim_host_ns() - sim_host_start_ns) * TIMER_TICKS_PER_US / 1000);
+}
+
+// The application is taken to end at 0x8000
+uint32_t flash_program_end(void) {
+    return 0x8000;
+}
+
+// Stand-ins for the start-of-frame bookkeeping in usb.c, updated by 
+// sim_service() once per millisecond of board time
+uint16_t USB_sof_frame;
+uint32_t USB_sof_time;
+
+// Stand-ins for the device and serial number string descriptors in 
+// descriptors.c
+uint8_t Device[18] = { 18, 1 };
+uint8_t String3[18] = { 18, 3 };
+
+// Stand-ins for the USB CDC functions in cdc.c, moving bytes directly
+// between the parser and the host end of the link
+uint16_t cdc_in_waiting(void) {
+    return (cdc_rx.count > 0xFFFF) ? 0xFFFF : (uint16_t)cdc_rx.count;
+}
+
+uint16_t cdc_tx_buffer_space(void) {
+    return TX_BUFFER_SIZE;
+}
+
+void cdc_putc(uint8_t ch) {
+    sim_queue_put(&cdc_tx, ch);
+}
+
+// The host end reads only between commands, so holding bytes back only
+// marks those queued before
+uint32_t sim_cdc_held_count;
+
+void cdc_tx_hold(void) {
+    sim_cdc_held_count = cdc_tx.count;
+}
+
+void cdc_tx_rollback(uint16_t count) {
+    if (count > cdc_tx.count - sim_cdc_held_count)
+        count = cdc_tx.count - sim_cdc_held_count;
+    cdc_tx.tail = (cdc_tx.tail + SIM_QUEUE_LENGTH - count) % SIM_QUEUE_LENGTH;
+    cdc_tx.count -= count;
+}
+
+uint8_t cdc_getc(void) {
+    return sim_queue_get(&cdc_rx);
+}
+
+void cdc_puts(uint8_t *str) {
+    while (*str)
+        cdc_putc(*str++);
+}
+
+// Host ends of the CDC and BLE links
+void sim_cdc_write(uint8_t *data, uint16_t length) {
+    for (; length; length--)
+        sim_queue_put(&cdc_rx, *data++);
+}
+
+uint16_t sim_cdc_read(uint8_t *data, uint16_t length) {
+    uint16_t n;
+
+    for (n = 0; (n < length) && cdc_tx.count; n++)
+        *data++ = sim_queue_get(&cdc_tx);
+    return n;
+}
+
+uint16_t sim_cdc_available(void) {
+    return (cdc_tx.count > 0xFFFF) ? 0xFFFF : (uint16_t)cdc_tx.count;
+}
+
+void sim_ble_write(uint8_t *data, uint16_t length) {
+    for (; length; length--)
+        sim_queue_put(&ble_rx, *data++);
+}
+
+uint16_t sim_ble_read(uint8_t *data, uint16_t length) {
+    uint16_t n;
+
+    for (n = 0; (n < length) && ble_tx.count; n++)
+        *data++ = sim_queue_get(&ble_tx);
+    return n;
+}
+
+uint16_t sim_ble_available(void) {
+    return (ble_tx.count > 0xFFFF) ? 0xFFFF : (uint16_t)ble_tx.count;
+}
+
+// Runs a timer's interrupt once for each of its periods that has passed 
+// since it was started, giving up on periods more than SIM_TIMER_BACKLOG 
+// behind
+#define SIM_TIMER_BACKLOG   4096
+
+typedef struct {
+    volatile uint16_t *con;
+    volatile uint16_t *pr;
+    void (*isr)(void);
+    uint32_t time;
+    uint16_t running;
+} SIM_TIMER_T;
+
+SIM_TIMER_T sim_timer1 = { &T1CON, &PR1, _T1Interrupt, 0, FALSE };
+SIM_TIMER_T sim_timer5 = { &T5CON, &PR5, _T5Interrupt, 0, FALSE };
+
+void sim_timer(SIM_TIMER_T *timer, uint16_t enabled, uint32_t time) {
+    static const uint16_t prescalers[4] = { 1, 8, 64, 256 };
+    uint32_t period;
+    uint16_t n;
+
+    if (!(*timer->con & 0x8000) || !enabled) {
+        timer->running = FALSE;
+        return;
+    }
+    if (!timer->running) {
+        timer->running = TRUE;
+        timer->time = time;
+    }
+    period = (uint32_t)(*timer->pr + 1) * prescalers[(*timer->con >> 4) & 3];
+    for (n = 0; time - timer->time >= period; n++) {
+        if (n == SIM_TIMER_BACKLOG) {
+            timer->time = time;
+            break;
+        }
+        timer->time += period;
+        timer->isr();
+        if (!(*timer->con & 0x8000))
+            break;
+    }
+}
+
+// Raises INT1 on the selected edge of whichever header pin RD0 to RD5 is 
+// remapped onto it, as set in PORTD by the caller
+void sim_int1(void) {
+    static const uint8_t rp[6] = { RD0_RP, RD1_RP, RD2_RP, RD3_RP, RD4_RP, RD5_RP };
+    static uint16_t last = 0;
+    uint16_t i, level;
+
+    for (i = 0; i < 6; i++)
+        if (rp[i] == (RPINR_sfr[0] >> 8))
+            break;
+    level = (i < 6) ? (PORTD_sfr.w >> i) & 1 : 0;
+    if ((level != last) && (level != INTCON2bits.INT1EP))
+        IFS1bits.INT1IF = 1;
+    last = level;
+    if (IFS1bits.INT1IF && IEC1bits.INT1IE)
+        _INT1Interrupt();
+}
+
+// Runs the timer, INT1, and UART1 interrupt handlers whenever the hardware 
+// would have requested them, and counts USB frames; call after each pass 
+// through the firmware's main loop
+void sim_service(void) {
+    uint32_t time;
+    uint16_t frame;
+
+    time = tmr23_read();
+    frame = (uint16_t)(time / (1000 * TIMER_TICKS_PER_US)) & 0x7FF;
+    if (frame != USB_sof_frame) {
+        USB_sof_frame = frame;
+        USB_sof_time = time;
+    }
+    sim_timer(&sim_timer1, IEC0bits.T1IE, time);
+    sim_timer(&sim_timer5, IEC1bits.T5IE, time);
+    sim_int1();
+    if (U1MODEbits.UARTEN && U1STAbits.UTXEN && IEC0bits.U1TXIE)
+        _U1TXInterrupt();
+    if (U1MODEbits.UARTEN && ble_rx.count && IEC0bits.U1RXIE)
+        _U1RXInterrupt();
+}
+
+void init_sim(void) {
+    uint32_t i;
+
+    sim_time_ns = 0;
+    sim_host_start_ns = sim_host_ns();
+    sim_sdadc1_next = 0;
+    sim_noise_state = 1;
+    for (i = 0; i < FLASH_INSTRUCTIONS; i++)
+        sim_flash[i] = FLASH_BLANK;
+    for (i = 0; i < FLASH_ROW_INSTRUCTIONS; i++)
+        sim_flash_latch[i] = FLASH_BLANK;
+    memset(&dac8564, 0, sizeof(dac8564));
+    ads1292_reset();
+    ads1292.offset[0] = 1234;
+    ads1292.offset[1] = -567;
+    sim_set_adc16_source((SIM_SOURCE_T)NULL);
+    sim_set_adc24_source((SIM_SOURCE_T)NULL);
+    sim_sw1 = 1;
+    sim_queue_reset(&cdc_rx);
+    sim_queue_reset(&cdc_tx);
+    sim_queue_reset(&ble_rx);
+    sim_queue_reset(&ble_tx);
+}
@@ -0,0 +1,35 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+
+// Simulated peripherals for the host build.  The models are deterministic: 
+// the same sequence of calls always produces the same samples and the same 
+// simulated time, so that runs can be compared with one another.
+
+// Time on the simulated board in ns, advanced by the peripheral models (SPI 
+// transfers, sigma-delta ADC conversions, flash operations, and waits for 
+// ADS1292 conversions)
+extern uint64_t sim_time_ns;
+
+// A scripted analog input returns the value that an ADC channel reads at a 
+// given simulated time, in ADC codes at unity gain
+typedef int32_t (*SIM_SOURCE_T)(uint16_t channel, uint64_t time_ns);
+
+void init_sim(void);
+void sim_service(void);
+
+void sim_set_adc16_source(SIM_SOURCE_T source);
+void sim_set_adc24_source(SIM_SOURCE_T source);
+uint16_t sim_dac16_output(uint16_t dac);
+void sim_set_sw1(uint16_t val);
+
+// The host ends of the CDC and BLE links
+void sim_cdc_write(uint8_t *data, uint16_t length);
+uint16_t sim_cdc_read(uint8_t *data, uint16_t length);
+uint16_t sim_cdc_available(void);
+void sim_ble_write(uint8_t *data, uint16_t length);
+uint16_t sim_ble_read(uint8_t *data, uint16_t length);
+uint16_t sim_ble_available(void);
+
+#endif
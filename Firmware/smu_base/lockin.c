@@ -0,0 +1,184 @@
+#include "lockin.h"
+#include "smu_base.h"
+#include "pulse.h"
+
+// One cycle of the reference, in Q15
+const int16_t lockin_sine[256] = {
+         0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+      6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+     12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+     18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+     23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+     27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+     30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+     32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+     32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+     32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+     30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+     27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+     23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+     18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+     12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+      6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+         0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+     -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+    -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+    -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+    -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+    -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+    -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+    -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+    -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+    -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+     -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804
+};
+
+uint16_t lockin_dac, lockin_offset, lockin_amplitude;
+uint16_t lockin_points, lockin_cycles;
+uint16_t lockin_state;
+LOCKIN_RESULT_T lockin_result;
+uint16_t lockin_results, lockin_missed;
+
+// State of a running lock-in: the step of the sine that the DAC16 output
+// holds, the cycles taken toward the next result, the sums of the products
+// of the CH1 and CH2 samples with the sine and the cosine of the reference
+// (in the order of the fields of LOCKIN_RESULT_T), the time between frames,
+// the time of the last frame, and whether a frame has been taken yet
+uint16_t lockin_step, lockin_cycle;
+int64_t lockin_sums[4];
+uint32_t lockin_frame_ticks, lockin_last_frame;
+uint16_t lockin_framed;
+
+void init_lockin(void) {
+    lockin_dac = 1;
+    lockin_offset = 0x8000;
+    lockin_amplitude = 0x1000;
+    lockin_points = 16;
+    lockin_cycles = 10;
+    lockin_state = LOCKIN_IDLE;
+    lockin_results = 0;
+    lockin_missed = 0;
+    lockin_result.ch1_i = 0;
+    lockin_result.ch1_q = 0;
+    lockin_result.ch2_i = 0;
+    lockin_result.ch2_q = 0;
+}
+
+// Returns the angle of a step of the sine, with 2^16 to a cycle
+uint16_t lockin_angle(uint16_t step) {
+    return (uint16_t)(((uint32_t)step << 16) / lockin_points);
+}
+
+// Looks up the reference at an angle, rounding to the nearest entry
+int16_t lockin_lookup(uint16_t angle) {
+    return lockin_sine[(uint8_t)((angle + 0x80) >> 8)];
+}
+
+void lockin_write(uint16_t step) {
+    int32_t val;
+
+    val = (int32_t)lockin_offset + (((int32_t)lockin_amplitude * lockin_lookup(lockin_angle(step))) >> 15);
+    if (val < 0)
+        val = 0;
+    else if (val > 0xFFFF)
+        val = 0xFFFF;
+    dac16_set(lockin_dac, (uint16_t)val);
+}
+
+// Puts the DAC16 output on the first step of the sine and starts the
+// ADS1292, discarding any result from before
+void lockin_start(void) {
+    uint16_t i;
+
+    lockin_stop();
+    pulse_stop();
+
+    for (i = 0; i < 4; i++)
+        lockin_sums[i] = 0;
+    lockin_step = 0;
+    lockin_cycle = 0;
+    lockin_results = 0;
+    lockin_missed = 0;
+    lockin_frame_ticks = adc24_frame_ticks();
+    lockin_framed = FALSE;
+    lockin_write(0);
+    lockin_state = LOCKIN_SETTLING;
+    adc24_start();
+}
+
+// Stops the lock-in, leaving the DAC16 output at the offset and the last
+// result in place
+void lockin_stop(void) {
+    if (lockin_state == LOCKIN_IDLE)
+        return;
+    lockin_state = LOCKIN_IDLE;
+    adc24_stop();
+    dac16_set(lockin_dac, lockin_offset);
+}
+
+// Returns 1 while the lock-in runs
+uint16_t lockin_adc24_wanted(void) {
+    return (lockin_state == LOCKIN_IDLE) ? 0 : 1;
+}
+
+// Takes each ADC24 frame read while the lock-in runs: multiplies its samples
+// by the reference at the step that the DAC16 output held while they were
+// taken, steps the output, and at the end of each lockin_cycles cycles,
+// scales the sums into a new result.  If a frame was missed before this
+// one, the result under way is discarded instead.
+void lockin_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    uint16_t angle, i;
+    int16_t sine, cosine;
+    int64_t frames;
+    uint32_t now;
+
+    if (lockin_state == LOCKIN_IDLE)
+        return;
+
+    now = timer_stamps[TIMER_STAMP_ADC24];
+    if (lockin_framed && (now - lockin_last_frame > lockin_frame_ticks + (lockin_frame_ticks >> 1))) {
+        for (i = 0; i < 4; i++)
+            lockin_sums[i] = 0;
+        lockin_cycle = 0;
+        lockin_state = LOCKIN_SETTLING;
+        lockin_missed++;
+    }
+    lockin_last_frame = now;
+    lockin_framed = TRUE;
+
+    if (lockin_state == LOCKIN_RUNNING) {
+        angle = lockin_angle(lockin_step);
+        sine = lockin_lookup(angle);
+        cosine = lockin_lookup(angle + 0x4000);
+        lockin_sums[0] += (int64_t)ch1val * sine;
+        lockin_sums[1] += (int64_t)ch1val * cosine;
+        lockin_sums[2] += (int64_t)ch2val * sine;
+        lockin_sums[3] += (int64_t)ch2val * cosine;
+    }
+
+    lockin_step++;
+    if (lockin_step == lockin_points) {
+        lockin_step = 0;
+        if (lockin_state == LOCKIN_SETTLING)
+            lockin_state = LOCKIN_RUNNING;
+        else if (++lockin_cycle == lockin_cycles) {
+            // I = (2 / frames) * sum / 2^15
+            frames = (int64_t)lockin_points * lockin_cycles;
+            lockin_result.ch1_i = (int32_t)((lockin_sums[0] / frames) >> 14);
+            lockin_result.ch1_q = (int32_t)((lockin_sums[1] / frames) >> 14);
+            lockin_result.ch2_i = (int32_t)((lockin_sums[2] / frames) >> 14);
+            lockin_result.ch2_q = (int32_t)((lockin_sums[3] / frames) >> 14);
+            lockin_results++;
+            for (i = 0; i < 4; i++)
+                lockin_sums[i] = 0;
+            lockin_cycle = 0;
+        }
+    }
+
+    lockin_write(lockin_step);
+}
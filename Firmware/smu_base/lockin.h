@@ -0,0 +1,38 @@
+#ifndef _LOCKIN_H_
+#define _LOCKIN_H_
+
+#include <stdint.h>
+
+// Lock-in amplifier: steps a sine of lockin_points points onto one DAC16
+// output, one point per ADC24 frame, and demodulates both ADC24 channels
+// against it over lockin_cycles cycles into in-phase and quadrature
+// amplitudes.  A gap of over 1.5 frame periods discards the result under
+// way.
+#define LOCKIN_POINTS_MIN   4
+#define LOCKIN_POINTS_MAX   256
+
+#define LOCKIN_IDLE         0
+#define LOCKIN_SETTLING     1
+#define LOCKIN_RUNNING      2
+
+typedef struct {
+    int32_t ch1_i;
+    int32_t ch1_q;
+    int32_t ch2_i;
+    int32_t ch2_q;
+} LOCKIN_RESULT_T;
+
+extern const int16_t lockin_sine[256];
+extern uint16_t lockin_dac, lockin_offset, lockin_amplitude;
+extern uint16_t lockin_points, lockin_cycles;
+extern uint16_t lockin_state;
+extern LOCKIN_RESULT_T lockin_result;
+extern uint16_t lockin_results, lockin_missed;
+
+void init_lockin(void);
+void lockin_start(void);
+void lockin_stop(void);
+uint16_t lockin_adc24_wanted(void);
+void lockin_adc24_frame(int32_t ch1val, int32_t ch2val);
+
+#endif
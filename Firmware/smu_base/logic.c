@@ -0,0 +1,174 @@
+#include "logic.h"
+#include "smu_base.h"
+
+LOGIC_RECORD_T logic_ring[LOGIC_LENGTH];
+uint16_t logic_head, logic_count;
+uint16_t logic_inputs, logic_trigger_mask, logic_trigger_value;
+uint16_t logic_pre;
+uint32_t logic_post, logic_period;
+volatile uint16_t logic_state;
+
+// Timer5 settings for logic_period, and the state of a capture: the newest
+// record, the record and the sample within it at which the trigger
+// matched, the post-trigger samples still to take, and the pins made inputs
+uint16_t logic_tckps, logic_pr;
+uint16_t logic_tail, logic_triggered;
+uint16_t logic_trigger_record, logic_trigger_offset;
+uint32_t logic_remaining;
+uint16_t logic_input_pins;
+
+void init_logic(void) {
+    T5CON = 0x0000;         // Timer5 off, TCS = 0 (FCY)
+    IEC1bits.T5IE = 0;
+    IPC7bits.T5IP = 5;      // as for Timer1
+
+    logic_head = 0;
+    logic_count = 0;
+    logic_triggered = FALSE;
+    logic_input_pins = 0;
+    logic_inputs = 0;
+    logic_trigger_mask = 0;
+    logic_trigger_value = 0;
+    logic_pre = 0;
+    logic_post = 4096;
+    logic_state = LOGIC_IDLE;
+    logic_set_period(16 * TIMER_TICKS_PER_US);
+}
+
+// Sets the time between samples to the nearest that Timer5 can give to the
+// specified number of instruction cycles and returns the period set.  Takes
+// effect at the next logic_start().
+uint32_t logic_set_period(uint32_t cycles) {
+    if (cycles < LOGIC_PERIOD_MIN)
+        cycles = LOGIC_PERIOD_MIN;
+    logic_period = timer_period(cycles, &logic_tckps, &logic_pr);
+    return logic_period;
+}
+
+// Ends a capture, leaving the input pins as they are
+void logic_finish(void) {
+    T5CON = 0x0000;
+    IEC1bits.T5IE = 0;
+    IFS1bits.T5IF = 0;
+    logic_state = LOGIC_DONE;
+}
+
+// Makes the pins selected by logic_inputs inputs and arms a new capture,
+// discarding the last one
+void logic_start(void) {
+    logic_stop();
+
+    logic_input_pins = logic_inputs & LOGIC_PINS_ALL;
+    TRISD |= logic_input_pins & 0x7F;
+    TRISE |= logic_input_pins >> 8;
+
+    logic_head = 0;
+    logic_count = 0;
+    logic_triggered = FALSE;
+    logic_remaining = logic_post;
+    logic_state = LOGIC_ARMED;
+
+    TMR5 = 0;
+    PR5 = logic_pr;
+    IFS1bits.T5IF = 0;
+    IEC1bits.T5IE = 1;
+    T5CON = 0x8000 | (logic_tckps << 4);    // TON = 1, TCKPS = prescaler
+}
+
+// Stops any capture in progress, keeping what it has recorded, and gives
+// the pins that it made inputs back to DIGOUT as outputs
+void logic_stop(void) {
+    T5CON = 0x0000;
+    IEC1bits.T5IE = 0;
+    IFS1bits.T5IF = 0;
+
+    TRISD &= ~(logic_input_pins & 0x7F);
+    TRISE &= ~(logic_input_pins >> 8);
+    logic_input_pins = 0;
+
+    logic_state = LOGIC_IDLE;
+}
+
+// Finds the records of the last capture to send to a host: the first one
+// (as an index into logic_ring), the number of samples to leave out of it so
+// that no more than logic_pre samples precede the trigger, and the number of
+// the trigger sample among those sent (0xFFFFFFFF if the trigger never
+// matched).  Returns the number of records, or 0 while a capture runs.
+uint16_t logic_window(uint16_t *first, uint16_t *skip, uint32_t *trigger) {
+    uint16_t index;
+    uint32_t before;
+
+    *first = logic_head;
+    *skip = 0;
+    *trigger = 0xFFFFFFFF;
+    if ((logic_state == LOGIC_ARMED) || (logic_state == LOGIC_TRIGGERED) ||
+        (logic_count == 0))
+        return 0;
+
+    if (logic_triggered) {
+        index = logic_trigger_record;
+        before = logic_trigger_offset;
+        while ((before < logic_pre) && (index != logic_head)) {
+            index = (index == 0) ? LOGIC_LENGTH - 1 : index - 1;
+            before += logic_ring[index].count;
+        }
+        if (before > logic_pre) {
+            *skip = (uint16_t)(before - logic_pre);
+            before = logic_pre;
+        }
+        *first = index;
+        *trigger = before;
+    }
+
+    return ((logic_tail + LOGIC_LENGTH - *first) % LOGIC_LENGTH) + 1;
+}
+
+// Takes a sample each period of Timer5, adding it to the newest record if
+// it has the same value or else starting a new one.  While armed, the
+// oldest record is dropped to make room once the pre-trigger half of the
+// ring is full; once triggered, nothing is dropped and the capture ends
+// when the ring fills.
+void __attribute__((interrupt, auto_psv)) _T5Interrupt(void) {
+    uint16_t sample;
+
+    IFS1bits.T5IF = 0;              // lower Timer5 interrupt flag
+
+    sample = (PORTD & 0x7F) | ((PORTE & 0x7F) << 8);
+
+    if (logic_count && (logic_ring[logic_tail].value == sample) &&
+        (logic_ring[logic_tail].count != 0xFFFF)) {
+        logic_ring[logic_tail].count++;
+    } else {
+        if (logic_state == LOGIC_ARMED) {
+            if (logic_count == LOGIC_LENGTH / 2) {
+                logic_head++;
+                if (logic_head == LOGIC_LENGTH)
+                    logic_head = 0;
+                logic_count--;
+            }
+        } else if (logic_count == LOGIC_LENGTH) {
+            logic_finish();
+            return;
+        }
+        logic_tail = logic_head + logic_count;
+        if (logic_tail >= LOGIC_LENGTH)
+            logic_tail -= LOGIC_LENGTH;
+        logic_ring[logic_tail].value = sample;
+        logic_ring[logic_tail].count = 1;
+        logic_count++;
+    }
+
+    if (logic_state == LOGIC_ARMED) {
+        if ((sample & logic_trigger_mask) != logic_trigger_value)
+            return;
+        logic_state = LOGIC_TRIGGERED;
+        logic_triggered = TRUE;
+        logic_trigger_record = logic_tail;
+        logic_trigger_offset = logic_ring[logic_tail].count - 1;
+        timer_stamp(TIMER_STAMP_LOGIC);
+    } else if (logic_remaining)
+        logic_remaining--;
+
+    if (logic_remaining == 0)
+        logic_finish();
+}
@@ -0,0 +1,40 @@
+#ifndef _LOGIC_H_
+#define _LOGIC_H_
+
+#include <stdint.h>
+
+// Logic analyzer: the Timer5 ISR samples PORTD and PORTE, laid out as a
+// pattern generator vector, into a run-length coded ring that keeps
+// LOGIC_LENGTH / 2 records before the trigger and logic_post samples after.
+#define LOGIC_LENGTH        128
+#define LOGIC_PINS_ALL      0x7F7F
+
+// Shortest period in instruction cycles (30 us), which leaves the main loop 
+// most of the CPU
+#define LOGIC_PERIOD_MIN    480
+
+#define LOGIC_IDLE          0
+#define LOGIC_ARMED         1
+#define LOGIC_TRIGGERED     2
+#define LOGIC_DONE          3
+
+// A sample and the number of consecutive samples (1 to 65535) that had it
+typedef struct {
+    uint16_t value;
+    uint16_t count;
+} LOGIC_RECORD_T;
+
+extern LOGIC_RECORD_T logic_ring[LOGIC_LENGTH];
+extern uint16_t logic_head, logic_count;
+extern uint16_t logic_inputs, logic_trigger_mask, logic_trigger_value;
+extern uint16_t logic_pre;
+extern uint32_t logic_post, logic_period;
+extern volatile uint16_t logic_state;
+
+void init_logic(void);
+uint32_t logic_set_period(uint32_t cycles);
+void logic_start(void);
+void logic_stop(void);
+uint16_t logic_window(uint16_t *first, uint16_t *skip, uint32_t *trigger);
+
+#endif
@@ -1,18 +1,40 @@
 #include "parser.h"
 #include "cdc.h"
 #include "smu_base.h"
+#include "benchmark.h"
+#include "perf.h"
+#include "trace.h"
+#include "delay.h"
+#include "pwm.h"
+#include "patgen.h"
+#include "logic.h"
+#include "trigger.h"
+#include "sync.h"
+#include "lockin.h"
+#include "pulse.h"
+#include "stats.h"
+#include "hist.h"
+#include "fft.h"
 
-#define CMD_BUFFER_LENGTH   128
 #define END_FWD_CHAR        '`'
 
-STATE_HANDLER_T parser_state, parser_last_state, parser_task;
+STATE_HANDLER_T parser_state, parser_last_state;
 
-PARSER_PUTC_T parser_putc;
-PARSER_PUTS_T parser_puts;
+PARSER_CHANNEL_T cdc_channel, ble_channel, *parser_channel;
 
-char cdc_cmd_buffer[CMD_BUFFER_LENGTH], ble_cmd_buffer[CMD_BUFFER_LENGTH];
-char *cdc_cmd_buffer_pos, *ble_cmd_buffer_pos;
-uint16_t cdc_cmd_buffer_left, ble_cmd_buffer_left, end_fwd_char_count;
+uint8_t block_buffer[BLOCK_BUFFER_LENGTH];
+PARSER_CHANNEL_T *block_buffer_owner;
+uint32_t block_tx_crc;
+
+// Set while a command handler runs, so that only its replies are marked
+uint16_t parser_dispatching;
+
+const uint32_t crc32_table[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 
+                                   0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C, 
+                                   0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 
+                                   0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+
+uint16_t end_fwd_char_count;
 
 void parser_disconnected(void);
 void parser_connected(void);
@@ -27,16 +49,48 @@ void adc24_handler(char *args);
 void digout_handler(char *args);
 void ble_handler(char *args);
 void flash_handler(char *args);
-
-DISPATCH_ENTRY_T root_table[] = {{ "UI", ui_handler }, 
-                                 { "PWR", pwr_handler }, 
-                                 { "DAC10", dac10_handler }, 
-                                 { "DAC16", dac16_handler }, 
-                                 { "ADC16", adc16_handler }, 
-                                 { "ADC24", adc24_handler }, 
-                                 { "DIGOUT", digout_handler }, 
-                                 { "BLE", ble_handler }, 
-                                 { "FLASH", flash_handler }};
+void bench_handler(char *args);
+void perf_handler(char *args);
+void perfQ_handler(char *args);
+void trace_handler(char *args);
+void time_handler(char *args);
+void timeQ_handler(char *args);
+void pwm_handler(char *args);
+void patgen_handler(char *args);
+void logic_handler(char *args);
+void trigger_handler(char *args);
+void sync_handler(char *args);
+void lockin_handler(char *args);
+void pulse_handler(char *args);
+void stats_handler(char *args);
+void hist_handler(char *args);
+void fft_handler(char *args);
+
+const DISPATCH_ENTRY_T root_table[] = {{ "UI", ui_handler }, 
+                                       { "PWR", pwr_handler }, 
+                                       { "DAC10", dac10_handler }, 
+                                       { "DAC16", dac16_handler }, 
+                                       { "ADC16", adc16_handler }, 
+                                       { "ADC24", adc24_handler }, 
+                                       { "DIGOUT", digout_handler }, 
+                                       { "BLE", ble_handler }, 
+                                       { "FLASH", flash_handler }, 
+                                       { "BENCH", bench_handler }, 
+                                       { "PERF", perf_handler }, 
+                                       { "PERF?", perfQ_handler }, 
+                                       { "TRACE", trace_handler }, 
+                                       { "TIME", time_handler }, 
+                                       { "TIME?", timeQ_handler }, 
+                                       { "PWM", pwm_handler }, 
+                                       { "PATGEN", patgen_handler }, 
+                                       { "LOGIC", logic_handler }, 
+                                       { "TRIGGER", trigger_handler }, 
+                                       { "SYNC", sync_handler }, 
+                                       { "LOCKIN", lockin_handler }, 
+                                       { "PULSE", pulse_handler }, 
+                                       { "STATS", stats_handler }, 
+                                       { "HIST", hist_handler }, 
+                                       { "FFT", fft_handler }};
 
 #define ROOT_TABLE_ENTRIES      sizeof(root_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -48,21 +102,21 @@ void led3_handler(char *args);
 void led3Q_handler(char *args);
 void sw1Q_handler(char *args);
 
-DISPATCH_ENTRY_T ui_table[] = {{ "LED1", led1_handler }, 
-                               { "LED1?", led1Q_handler }, 
-                               { "LED2", led2_handler }, 
-                               { "LED2?", led2Q_handler }, 
-                               { "LED3", led3_handler }, 
-                               { "LED3?", led3Q_handler }, 
-                               { "SW1?", sw1Q_handler }};
+const DISPATCH_ENTRY_T ui_table[] = {{ "LED1", led1_handler }, 
+                                     { "LED1?", led1Q_handler }, 
+                                     { "LED2", led2_handler }, 
+                                     { "LED2?", led2Q_handler }, 
+                                     { "LED3", led3_handler }, 
+                                     { "LED3?", led3Q_handler }, 
+                                     { "SW1?", sw1Q_handler }};
 
 #define UI_TABLE_ENTRIES       sizeof(ui_table) / sizeof(DISPATCH_ENTRY_T)
 
 void ena12V_handler(char *args);
 void ena12VQ_handler(char *args);
 
-DISPATCH_ENTRY_T pwr_table[] = {{ "ENA12V", ena12V_handler }, 
-                                { "ENA12V?", ena12VQ_handler }};
+const DISPATCH_ENTRY_T pwr_table[] = {{ "ENA12V", ena12V_handler }, 
+                                      { "ENA12V?", ena12VQ_handler }};
 
 #define PWR_TABLE_ENTRIES       sizeof(pwr_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -73,12 +127,12 @@ void dac10_dac2Q_handler(char *args);
 void dac10_diff_handler(char *args);
 void dac10_diffQ_handler(char *args);
 
-DISPATCH_ENTRY_T dac10_table[] = {{ "DAC1", dac10_dac1_handler }, 
-                                  { "DAC1?", dac10_dac1Q_handler }, 
-                                  { "DAC2", dac10_dac2_handler }, 
-                                  { "DAC2?", dac10_dac2Q_handler }, 
-                                  { "DIFF", dac10_diff_handler }, 
-                                  { "DIFF?", dac10_diffQ_handler }};
+const DISPATCH_ENTRY_T dac10_table[] = {{ "DAC1", dac10_dac1_handler }, 
+                                        { "DAC1?", dac10_dac1Q_handler }, 
+                                        { "DAC2", dac10_dac2_handler }, 
+                                        { "DAC2?", dac10_dac2Q_handler }, 
+                                        { "DIFF", dac10_diff_handler }, 
+                                        { "DIFF?", dac10_diffQ_handler }};
 
 #define DAC10_TABLE_ENTRIES       sizeof(dac10_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -94,19 +148,23 @@ void dac16_ch1_handler(char *args);
 void dac16_ch1Q_handler(char *args);
 void dac16_ch2_handler(char *args);
 void dac16_ch2Q_handler(char *args);
-
-DISPATCH_ENTRY_T dac16_table[] = {{ "DAC0", dac16_dac0_handler }, 
-                                  { "DAC0?", dac16_dac0Q_handler }, 
-                                  { "DAC1", dac16_dac1_handler }, 
-                                  { "DAC1?", dac16_dac1Q_handler }, 
-                                  { "DAC2", dac16_dac2_handler }, 
-                                  { "DAC2?", dac16_dac2Q_handler }, 
-                                  { "DAC3", dac16_dac3_handler }, 
-                                  { "DAC3?", dac16_dac3Q_handler }, 
-                                  { "CH1", dac16_ch1_handler }, 
-                                  { "CH1?", dac16_ch1Q_handler }, 
-                                  { "CH2", dac16_ch2_handler }, 
-                                  { "CH2?", dac16_ch2Q_handler }};
+void dac16_all_handler(char *args);
+void dac16_allQ_handler(char *args);
+
+const DISPATCH_ENTRY_T dac16_table[] = {{ "DAC0", dac16_dac0_handler }, 
+                                        { "DAC0?", dac16_dac0Q_handler }, 
+                                        { "DAC1", dac16_dac1_handler }, 
+                                        { "DAC1?", dac16_dac1Q_handler }, 
+                                        { "DAC2", dac16_dac2_handler }, 
+                                        { "DAC2?", dac16_dac2Q_handler }, 
+                                        { "DAC3", dac16_dac3_handler }, 
+                                        { "DAC3?", dac16_dac3Q_handler }, 
+                                        { "CH1", dac16_ch1_handler }, 
+                                        { "CH1?", dac16_ch1Q_handler }, 
+                                        { "CH2", dac16_ch2_handler }, 
+                                        { "CH2?", dac16_ch2Q_handler }, 
+                                        { "ALL", dac16_all_handler }, 
+                                        { "ALL?", dac16_allQ_handler }};
 
 #define DAC16_TABLE_ENTRIES       sizeof(dac16_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -120,15 +178,15 @@ void adc16_calibrate_handler(char *args);
 void adc16_offsetQ_handler(char *args);
 void adc16_maxvalQ_handler(char *args);
 
-DISPATCH_ENTRY_T adc16_table[] = {{ "CH1?", adc16_ch1Q_handler }, 
-                                  { "CH2?", adc16_ch2Q_handler }, 
-                                  { "CH1AVG?", adc16_ch1avgQ_handler }, 
-                                  { "CH2AVG?", adc16_ch2avgQ_handler }, 
-                                  { "CH1RAW?", adc16_ch1rawQ_handler }, 
-                                  { "CH2RAW?", adc16_ch2rawQ_handler }, 
-                                  { "CALIBRATE", adc16_calibrate_handler }, 
-                                  { "OFFSET?", adc16_offsetQ_handler }, 
-                                  { "MAXVAL?", adc16_maxvalQ_handler }};
+const DISPATCH_ENTRY_T adc16_table[] = {{ "CH1?", adc16_ch1Q_handler }, 
+                                        { "CH2?", adc16_ch2Q_handler }, 
+                                        { "CH1AVG?", adc16_ch1avgQ_handler }, 
+                                        { "CH2AVG?", adc16_ch2avgQ_handler }, 
+                                        { "CH1RAW?", adc16_ch1rawQ_handler }, 
+                                        { "CH2RAW?", adc16_ch2rawQ_handler }, 
+                                        { "CALIBRATE", adc16_calibrate_handler }, 
+                                        { "OFFSET?", adc16_offsetQ_handler }, 
+                                        { "MAXVAL?", adc16_maxvalQ_handler }};
 
 #define ADC16_TABLE_ENTRIES       sizeof(adc16_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -148,23 +206,27 @@ void adc24_bothrawQ_handler(char *args);
 void adc24_calibrate_handler(char *args);
 void adc24_reg_handler(char *args);
 void adc24_regQ_handler(char *args);
-
-DISPATCH_ENTRY_T adc24_table[] = {{ "CH1?", adc24_ch1Q_handler }, 
-                                  { "CH2?", adc24_ch2Q_handler }, 
-                                  { "CH1AVG?", adc24_ch1avgQ_handler }, 
-                                  { "CH2AVG?", adc24_ch2avgQ_handler }, 
-                                  { "CH1RAW?", adc24_ch1rawQ_handler }, 
-                                  { "CH2RAW?", adc24_ch2rawQ_handler }, 
-                                  { "CH1OFFSET", adc24_ch1offset_handler }, 
-                                  { "CH1OFFSET?", adc24_ch1offsetQ_handler }, 
-                                  { "CH2OFFSET", adc24_ch2offset_handler }, 
-                                  { "CH2OFFSET?", adc24_ch2offsetQ_handler }, 
-                                  { "BOTH?", adc24_bothQ_handler }, 
-                                  { "BOTHAVG?", adc24_bothavgQ_handler }, 
-                                  { "BOTHRAW?", adc24_bothrawQ_handler }, 
-                                  { "CALIBRATE", adc24_calibrate_handler }, 
-                                  { "REG", adc24_reg_handler }, 
-                                  { "REG?", adc24_regQ_handler }};
+void adc24_stream_handler(char *args);
+void adc24_streamQ_handler(char *args);
+
+const DISPATCH_ENTRY_T adc24_table[] = {{ "CH1?", adc24_ch1Q_handler }, 
+                                        { "CH2?", adc24_ch2Q_handler }, 
+                                        { "CH1AVG?", adc24_ch1avgQ_handler }, 
+                                        { "CH2AVG?", adc24_ch2avgQ_handler }, 
+                                        { "CH1RAW?", adc24_ch1rawQ_handler }, 
+                                        { "CH2RAW?", adc24_ch2rawQ_handler }, 
+                                        { "CH1OFFSET", adc24_ch1offset_handler }, 
+                                        { "CH1OFFSET?", adc24_ch1offsetQ_handler }, 
+                                        { "CH2OFFSET", adc24_ch2offset_handler }, 
+                                        { "CH2OFFSET?", adc24_ch2offsetQ_handler }, 
+                                        { "BOTH?", adc24_bothQ_handler }, 
+                                        { "BOTHAVG?", adc24_bothavgQ_handler }, 
+                                        { "BOTHRAW?", adc24_bothrawQ_handler }, 
+                                        { "CALIBRATE", adc24_calibrate_handler }, 
+                                        { "REG", adc24_reg_handler }, 
+                                        { "REG?", adc24_regQ_handler }, 
+                                        { "STREAM", adc24_stream_handler }, 
+                                        { "STREAM?", adc24_streamQ_handler }};
 
 #define ADC24_TABLE_ENTRIES       sizeof(adc24_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -201,38 +263,38 @@ void re5Q_handler(char *args);
 void re6_handler(char *args);
 void re6Q_handler(char *args);
 
-DISPATCH_ENTRY_T digout_table[] = {{ "PORTD", portd_handler }, 
-                                   { "PORTD?", portdQ_handler }, 
-                                   { "RD0", rd0_handler }, 
-                                   { "RD0?", rd0Q_handler }, 
-                                   { "RD1", rd1_handler }, 
-                                   { "RD1?", rd1Q_handler }, 
-                                   { "RD2", rd2_handler }, 
-                                   { "RD2?", rd2Q_handler }, 
-                                   { "RD3", rd3_handler }, 
-                                   { "RD3?", rd3Q_handler }, 
-                                   { "RD4", rd4_handler }, 
-                                   { "RD4?", rd4Q_handler }, 
-                                   { "RD5", rd5_handler }, 
-                                   { "RD5?", rd5Q_handler }, 
-                                   { "RD6", rd6_handler }, 
-                                   { "RD6?", rd6Q_handler }, 
-                                   { "PORTE", porte_handler }, 
-                                   { "PORTE?", porteQ_handler }, 
-                                   { "RE0", re0_handler }, 
-                                   { "RE0?", re0Q_handler }, 
-                                   { "RE1", re1_handler }, 
-                                   { "RE1?", re1Q_handler }, 
-                                   { "RE2", re2_handler }, 
-                                   { "RE2?", re2Q_handler }, 
-                                   { "RE3", re3_handler }, 
-                                   { "RE3?", re3Q_handler }, 
-                                   { "RE4", re4_handler }, 
-                                   { "RE4?", re4Q_handler }, 
-                                   { "RE5", re5_handler }, 
-                                   { "RE5?", re5Q_handler }, 
-                                   { "RE6", re6_handler }, 
-                                   { "RE6?", re6Q_handler }};
+const DISPATCH_ENTRY_T digout_table[] = {{ "PORTD", portd_handler }, 
+                                         { "PORTD?", portdQ_handler }, 
+                                         { "RD0", rd0_handler }, 
+                                         { "RD0?", rd0Q_handler }, 
+                                         { "RD1", rd1_handler }, 
+                                         { "RD1?", rd1Q_handler }, 
+                                         { "RD2", rd2_handler }, 
+                                         { "RD2?", rd2Q_handler }, 
+                                         { "RD3", rd3_handler }, 
+                                         { "RD3?", rd3Q_handler }, 
+                                         { "RD4", rd4_handler }, 
+                                         { "RD4?", rd4Q_handler }, 
+                                         { "RD5", rd5_handler }, 
+                                         { "RD5?", rd5Q_handler }, 
+                                         { "RD6", rd6_handler }, 
+                                         { "RD6?", rd6Q_handler }, 
+                                         { "PORTE", porte_handler }, 
+                                         { "PORTE?", porteQ_handler }, 
+                                         { "RE0", re0_handler }, 
+                                         { "RE0?", re0Q_handler }, 
+                                         { "RE1", re1_handler }, 
+                                         { "RE1?", re1Q_handler }, 
+                                         { "RE2", re2_handler }, 
+                                         { "RE2?", re2Q_handler }, 
+                                         { "RE3", re3_handler }, 
+                                         { "RE3?", re3Q_handler }, 
+                                         { "RE4", re4_handler }, 
+                                         { "RE4?", re4Q_handler }, 
+                                         { "RE5", re5_handler }, 
+                                         { "RE5?", re5Q_handler }, 
+                                         { "RE6", re6_handler }, 
+                                         { "RE6?", re6Q_handler }};
 
 #define DIGOUT_TABLE_ENTRIES    sizeof(digout_table) / sizeof(DISPATCH_ENTRY_T)
 
@@ -240,22 +302,336 @@ void ble_reset_handler(char *args);
 void ble_resetQ_handler(char *args);
 void ble_forward_handler(char *args);
 
-DISPATCH_ENTRY_T ble_table[] = {{ "RESET", ble_reset_handler }, 
-                                { "RESET?", ble_resetQ_handler }, 
-                                { "FORWARD", ble_forward_handler }};
+const DISPATCH_ENTRY_T ble_table[] = {{ "RESET", ble_reset_handler }, 
+                                      { "RESET?", ble_resetQ_handler }, 
+                                      { "FORWARD", ble_forward_handler }};
 
 #define BLE_TABLE_ENTRIES       sizeof(ble_table) / sizeof(DISPATCH_ENTRY_T)
 
 void flash_erase_handler(char *args);
 void flash_read_handler(char *args);
 void flash_write_handler(char *args);
-
-DISPATCH_ENTRY_T flash_table[] = {{ "ERASE", flash_erase_handler },
-                                  { "READ", flash_read_handler },
-                                  { "WRITE", flash_write_handler }};
+void flash_readbin_handler(char *args);
+void flash_writebin_handler(char *args);
+void flash_serial_handler(char *args);
+void flash_serialQ_handler(char *args);
+void flash_writableQ_handler(char *args);
+
+const DISPATCH_ENTRY_T flash_table[] = {{ "ERASE", flash_erase_handler },
+                                        { "READ", flash_read_handler },
+                                        { "WRITE", flash_write_handler },
+                                        { "READBIN", flash_readbin_handler },
+                                        { "WRITEBIN", flash_writebin_handler },
+                                        { "SERIAL", flash_serial_handler },
+                                        { "SERIAL?", flash_serialQ_handler },
+                                        { "WRITABLE?", flash_writableQ_handler }};
 
 #define FLASH_TABLE_ENTRIES     sizeof(flash_table) / sizeof(DISPATCH_ENTRY_T)
 
+void bench_run_handler(char *args);
+void bench_resultsQ_handler(char *args);
+
+const DISPATCH_ENTRY_T bench_table[] = {{ "RUN", bench_run_handler }, 
+                                        { "RESULTS?", bench_resultsQ_handler }};
+
+#define BENCH_TABLE_ENTRIES     sizeof(bench_table) / sizeof(DISPATCH_ENTRY_T)
+
+void perf_reset_handler(char *args);
+void perf_histQ_handler(char *args);
+
+const DISPATCH_ENTRY_T perf_table[] = {{ "RESET", perf_reset_handler }, 
+                                       { "HIST?", perf_histQ_handler }};
+
+#define PERF_TABLE_ENTRIES      sizeof(perf_table) / sizeof(DISPATCH_ENTRY_T)
+
+void trace_enable_handler(char *args);
+void trace_enableQ_handler(char *args);
+void trace_clear_handler(char *args);
+void trace_mark_handler(char *args);
+void trace_dumpQ_handler(char *args);
+void trace_commandsQ_handler(char *args);
+
+const DISPATCH_ENTRY_T trace_table[] = {{ "ENABLE", trace_enable_handler }, 
+                                        { "ENABLE?", trace_enableQ_handler }, 
+                                        { "CLEAR", trace_clear_handler }, 
+                                        { "MARK", trace_mark_handler }, 
+                                        { "DUMP?", trace_dumpQ_handler }, 
+                                        { "COMMANDS?", trace_commandsQ_handler }};
+
+#define TRACE_TABLE_ENTRIES     sizeof(trace_table) / sizeof(DISPATCH_ENTRY_T)
+
+void time_stampQ_handler(char *args);
+void time_sofQ_handler(char *args);
+void time_timeoutsQ_handler(char *args);
+
+const DISPATCH_ENTRY_T time_table[] = {{ "STAMP?", time_stampQ_handler }, 
+                                       { "SOF?", time_sofQ_handler }, 
+                                       { "TIMEOUTS?", time_timeoutsQ_handler }};
+
+#define TIME_TABLE_ENTRIES      sizeof(time_table) / sizeof(DISPATCH_ENTRY_T)
+
+void pwm_set_handler(char *args);
+void pwm_setQ_handler(char *args);
+void pwm_pin_handler(char *args);
+void pwm_pinQ_handler(char *args);
+void pwm_start_handler(char *args);
+void pwm_stop_handler(char *args);
+void pwm_runningQ_handler(char *args);
+
+const DISPATCH_ENTRY_T pwm_table[] = {{ "SET", pwm_set_handler }, 
+                                      { "SET?", pwm_setQ_handler }, 
+                                      { "PIN", pwm_pin_handler }, 
+                                      { "PIN?", pwm_pinQ_handler }, 
+                                      { "START", pwm_start_handler }, 
+                                      { "STOP", pwm_stop_handler }, 
+                                      { "RUNNING?", pwm_runningQ_handler }};
+
+#define PWM_TABLE_ENTRIES       sizeof(pwm_table) / sizeof(DISPATCH_ENTRY_T)
+
+void patgen_load_handler(char *args);
+void patgen_lengthQ_handler(char *args);
+void patgen_period_handler(char *args);
+void patgen_periodQ_handler(char *args);
+void patgen_count_handler(char *args);
+void patgen_countQ_handler(char *args);
+void patgen_mask_handler(char *args);
+void patgen_maskQ_handler(char *args);
+void patgen_trigger_handler(char *args);
+void patgen_triggerQ_handler(char *args);
+void patgen_start_handler(char *args);
+void patgen_stop_handler(char *args);
+void patgen_stateQ_handler(char *args);
+
+const DISPATCH_ENTRY_T patgen_table[] = {{ "LOAD", patgen_load_handler }, 
+                                         { "LENGTH?", patgen_lengthQ_handler }, 
+                                         { "PERIOD", patgen_period_handler }, 
+                                         { "PERIOD?", patgen_periodQ_handler }, 
+                                         { "COUNT", patgen_count_handler }, 
+                                         { "COUNT?", patgen_countQ_handler }, 
+                                         { "MASK", patgen_mask_handler }, 
+                                         { "MASK?", patgen_maskQ_handler }, 
+                                         { "TRIGGER", patgen_trigger_handler }, 
+                                         { "TRIGGER?", patgen_triggerQ_handler }, 
+                                         { "START", patgen_start_handler }, 
+                                         { "STOP", patgen_stop_handler }, 
+                                         { "STATE?", patgen_stateQ_handler }};
+
+#define PATGEN_TABLE_ENTRIES    sizeof(patgen_table) / sizeof(DISPATCH_ENTRY_T)
+
+void logic_inputs_handler(char *args);
+void logic_inputsQ_handler(char *args);
+void logic_period_handler(char *args);
+void logic_periodQ_handler(char *args);
+void logic_trigger_handler(char *args);
+void logic_triggerQ_handler(char *args);
+void logic_pre_handler(char *args);
+void logic_preQ_handler(char *args);
+void logic_post_handler(char *args);
+void logic_postQ_handler(char *args);
+void logic_start_handler(char *args);
+void logic_stop_handler(char *args);
+void logic_stateQ_handler(char *args);
+void logic_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T logic_table[] = {{ "INPUTS", logic_inputs_handler }, 
+                                        { "INPUTS?", logic_inputsQ_handler }, 
+                                        { "PERIOD", logic_period_handler }, 
+                                        { "PERIOD?", logic_periodQ_handler }, 
+                                        { "TRIGGER", logic_trigger_handler }, 
+                                        { "TRIGGER?", logic_triggerQ_handler }, 
+                                        { "PRE", logic_pre_handler }, 
+                                        { "PRE?", logic_preQ_handler }, 
+                                        { "POST", logic_post_handler }, 
+                                        { "POST?", logic_postQ_handler }, 
+                                        { "START", logic_start_handler }, 
+                                        { "STOP", logic_stop_handler }, 
+                                        { "STATE?", logic_stateQ_handler }, 
+                                        { "DATA?", logic_dataQ_handler }};
+
+#define LOGIC_TABLE_ENTRIES     sizeof(logic_table) / sizeof(DISPATCH_ENTRY_T)
+
+void trigger_source_handler(char *args);
+void trigger_sourceQ_handler(char *args);
+void trigger_pin_handler(char *args);
+void trigger_pinQ_handler(char *args);
+void trigger_level_handler(char *args);
+void trigger_levelQ_handler(char *args);
+void trigger_mode_handler(char *args);
+void trigger_modeQ_handler(char *args);
+void trigger_holdoff_handler(char *args);
+void trigger_holdoffQ_handler(char *args);
+void trigger_actions_handler(char *args);
+void trigger_actionsQ_handler(char *args);
+void trigger_out_handler(char *args);
+void trigger_outQ_handler(char *args);
+void trigger_depth_handler(char *args);
+void trigger_depthQ_handler(char *args);
+void trigger_arm_handler(char *args);
+void trigger_force_handler(char *args);
+void trigger_stop_handler(char *args);
+void trigger_stateQ_handler(char *args);
+void trigger_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T trigger_table[] = {{ "SOURCE", trigger_source_handler }, 
+                                          { "SOURCE?", trigger_sourceQ_handler }, 
+                                          { "PIN", trigger_pin_handler }, 
+                                          { "PIN?", trigger_pinQ_handler }, 
+                                          { "LEVEL", trigger_level_handler }, 
+                                          { "LEVEL?", trigger_levelQ_handler }, 
+                                          { "MODE", trigger_mode_handler }, 
+                                          { "MODE?", trigger_modeQ_handler }, 
+                                          { "HOLDOFF", trigger_holdoff_handler }, 
+                                          { "HOLDOFF?", trigger_holdoffQ_handler }, 
+                                          { "ACTIONS", trigger_actions_handler }, 
+                                          { "ACTIONS?", trigger_actionsQ_handler }, 
+                                          { "OUT", trigger_out_handler }, 
+                                          { "OUT?", trigger_outQ_handler }, 
+                                          { "DEPTH", trigger_depth_handler }, 
+                                          { "DEPTH?", trigger_depthQ_handler }, 
+                                          { "ARM", trigger_arm_handler }, 
+                                          { "FORCE", trigger_force_handler }, 
+                                          { "STOP", trigger_stop_handler }, 
+                                          { "STATE?", trigger_stateQ_handler }, 
+                                          { "DATA?", trigger_dataQ_handler }};
+
+#define TRIGGER_TABLE_ENTRIES   sizeof(trigger_table) / sizeof(DISPATCH_ENTRY_T)
+
+void sync_mode_handler(char *args);
+void sync_modeQ_handler(char *args);
+void sync_reset_handler(char *args);
+void sync_epochQ_handler(char *args);
+
+const DISPATCH_ENTRY_T sync_table[] = {{ "MODE", sync_mode_handler }, 
+                                       { "MODE?", sync_modeQ_handler }, 
+                                       { "RESET", sync_reset_handler }, 
+                                       { "EPOCH?", sync_epochQ_handler }};
+
+#define SYNC_TABLE_ENTRIES      sizeof(sync_table) / sizeof(DISPATCH_ENTRY_T)
+
+void lockin_dac_handler(char *args);
+void lockin_dacQ_handler(char *args);
+void lockin_level_handler(char *args);
+void lockin_levelQ_handler(char *args);
+void lockin_points_handler(char *args);
+void lockin_pointsQ_handler(char *args);
+void lockin_cycles_handler(char *args);
+void lockin_cyclesQ_handler(char *args);
+void lockin_start_handler(char *args);
+void lockin_stop_handler(char *args);
+void lockin_stateQ_handler(char *args);
+void lockin_resultQ_handler(char *args);
+
+const DISPATCH_ENTRY_T lockin_table[] = {{ "DAC", lockin_dac_handler }, 
+                                         { "DAC?", lockin_dacQ_handler }, 
+                                         { "LEVEL", lockin_level_handler }, 
+                                         { "LEVEL?", lockin_levelQ_handler }, 
+                                         { "POINTS", lockin_points_handler }, 
+                                         { "POINTS?", lockin_pointsQ_handler }, 
+                                         { "CYCLES", lockin_cycles_handler }, 
+                                         { "CYCLES?", lockin_cyclesQ_handler }, 
+                                         { "START", lockin_start_handler }, 
+                                         { "STOP", lockin_stop_handler }, 
+                                         { "STATE?", lockin_stateQ_handler }, 
+                                         { "RESULT?", lockin_resultQ_handler }};
+
+#define LOCKIN_TABLE_ENTRIES    sizeof(lockin_table) / sizeof(DISPATCH_ENTRY_T)
+
+void pulse_dac_handler(char *args);
+void pulse_dacQ_handler(char *args);
+void pulse_level_handler(char *args);
+void pulse_levelQ_handler(char *args);
+void pulse_timing_handler(char *args);
+void pulse_timingQ_handler(char *args);
+void pulse_frames_handler(char *args);
+void pulse_framesQ_handler(char *args);
+void pulse_count_handler(char *args);
+void pulse_countQ_handler(char *args);
+void pulse_start_handler(char *args);
+void pulse_stop_handler(char *args);
+void pulse_stateQ_handler(char *args);
+void pulse_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T pulse_table[] = {{ "DAC", pulse_dac_handler }, 
+                                        { "DAC?", pulse_dacQ_handler }, 
+                                        { "LEVEL", pulse_level_handler }, 
+                                        { "LEVEL?", pulse_levelQ_handler }, 
+                                        { "TIMING", pulse_timing_handler }, 
+                                        { "TIMING?", pulse_timingQ_handler }, 
+                                        { "FRAMES", pulse_frames_handler }, 
+                                        { "FRAMES?", pulse_framesQ_handler }, 
+                                        { "COUNT", pulse_count_handler }, 
+                                        { "COUNT?", pulse_countQ_handler }, 
+                                        { "START", pulse_start_handler }, 
+                                        { "STOP", pulse_stop_handler }, 
+                                        { "STATE?", pulse_stateQ_handler }, 
+                                        { "DATA?", pulse_dataQ_handler }};
+
+#define PULSE_TABLE_ENTRIES     sizeof(pulse_table) / sizeof(DISPATCH_ENTRY_T)
+
+void stats_frames_handler(char *args);
+void stats_framesQ_handler(char *args);
+void stats_window_handler(char *args);
+void stats_windowQ_handler(char *args);
+void stats_start_handler(char *args);
+void stats_stop_handler(char *args);
+void stats_stateQ_handler(char *args);
+void stats_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T stats_table[] = {{ "FRAMES", stats_frames_handler }, 
+                                        { "FRAMES?", stats_framesQ_handler }, 
+                                        { "WINDOW", stats_window_handler }, 
+                                        { "WINDOW?", stats_windowQ_handler }, 
+                                        { "START", stats_start_handler }, 
+                                        { "STOP", stats_stop_handler }, 
+                                        { "STATE?", stats_stateQ_handler }, 
+                                        { "DATA?", stats_dataQ_handler }};
+
+#define STATS_TABLE_ENTRIES     sizeof(stats_table) / sizeof(DISPATCH_ENTRY_T)
+
+void hist_source_handler(char *args);
+void hist_sourceQ_handler(char *args);
+void hist_range_handler(char *args);
+void hist_rangeQ_handler(char *args);
+void hist_start_handler(char *args);
+void hist_stop_handler(char *args);
+void hist_stateQ_handler(char *args);
+void hist_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T hist_table[] = {{ "SOURCE", hist_source_handler }, 
+                                       { "SOURCE?", hist_sourceQ_handler }, 
+                                       { "RANGE", hist_range_handler }, 
+                                       { "RANGE?", hist_rangeQ_handler }, 
+                                       { "START", hist_start_handler }, 
+                                       { "STOP", hist_stop_handler }, 
+                                       { "STATE?", hist_stateQ_handler }, 
+                                       { "DATA?", hist_dataQ_handler }};
+
+#define HIST_TABLE_ENTRIES      sizeof(hist_table) / sizeof(DISPATCH_ENTRY_T)
+
+void fft_source_handler(char *args);
+void fft_sourceQ_handler(char *args);
+void fft_shift_handler(char *args);
+void fft_shiftQ_handler(char *args);
+void fft_averages_handler(char *args);
+void fft_averagesQ_handler(char *args);
+void fft_start_handler(char *args);
+void fft_stop_handler(char *args);
+void fft_stateQ_handler(char *args);
+void fft_dataQ_handler(char *args);
+
+const DISPATCH_ENTRY_T fft_table[] = {{ "SOURCE", fft_source_handler }, 
+                                      { "SOURCE?", fft_sourceQ_handler }, 
+                                      { "SHIFT", fft_shift_handler }, 
+                                      { "SHIFT?", fft_shiftQ_handler }, 
+                                      { "AVERAGES", fft_averages_handler }, 
+                                      { "AVERAGES?", fft_averagesQ_handler }, 
+                                      { "START", fft_start_handler }, 
+                                      { "STOP", fft_stop_handler }, 
+                                      { "STATE?", fft_stateQ_handler }, 
+                                      { "DATA?", fft_dataQ_handler }};
+
+#define FFT_TABLE_ENTRIES       sizeof(fft_table) / sizeof(DISPATCH_ENTRY_T)
+
 int16_t str2hex(char *str, uint16_t *num) {
     if (!str)
         return -1;
@@ -570,6 +946,7 @@ void dac10_dac1_handler(char *args) {
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
         DAC1DAT = val & 0x3FF;
+        timer_stamp(TIMER_STAMP_DAC10);
     }
 }
 
@@ -589,6 +966,7 @@ void dac10_dac2_handler(char *args) {
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
         DAC2DAT = val & 0x3FF;
+        timer_stamp(TIMER_STAMP_DAC10);
     }
 }
 
@@ -611,6 +989,7 @@ void dac10_diff_handler(char *args) {
         dac2 = ((0x400 - (int16_t)val) >> 1) & 0x3FF;
         DAC1DAT = dac1;
         DAC2DAT = dac2;
+        timer_stamp(TIMER_STAMP_DAC10);
     }
 }
 
@@ -646,14 +1025,14 @@ void dac16_dac0_handler(char *args) {
     remainder = (char *)NULL;
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
-        dac16_set_dac0(val);
+        dac16_set(0, val);
     }
 }
 
 void dac16_dac0Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac0(), str);
+    hex2str_alt(dac16_get(0), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
@@ -665,14 +1044,14 @@ void dac16_dac1_handler(char *args) {
     remainder = (char *)NULL;
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
-        dac16_set_dac1(val);
+        dac16_set(1, val);
     }
 }
 
 void dac16_dac1Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac1(), str);
+    hex2str_alt(dac16_get(1), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
@@ -684,14 +1063,14 @@ void dac16_dac2_handler(char *args) {
     remainder = (char *)NULL;
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
-        dac16_set_dac2(val);
+        dac16_set(2, val);
     }
 }
 
 void dac16_dac2Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac2(), str);
+    hex2str_alt(dac16_get(2), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
@@ -703,14 +1082,14 @@ void dac16_dac3_handler(char *args) {
     remainder = (char *)NULL;
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
-        dac16_set_dac3(val);
+        dac16_set(3, val);
     }
 }
 
 void dac16_dac3Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac3(), str);
+    hex2str_alt(dac16_get(3), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
@@ -731,10 +1110,10 @@ void dac16_ch1_handler(char *args) {
 void dac16_ch1Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac1(), str);
+    hex2str_alt(dac16_get(1), str);
     parser_puts(str);
     parser_putc(',');
-    hex2str_alt(dac16_get_dac0(), str);
+    hex2str_alt(dac16_get(0), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
@@ -755,14 +1134,44 @@ void dac16_ch2_handler(char *args) {
 void dac16_ch2Q_handler(char *args) {
     char str[5];
 
-    hex2str_alt(dac16_get_dac3(), str);
+    hex2str_alt(dac16_get(3), str);
     parser_puts(str);
     parser_putc(',');
-    hex2str_alt(dac16_get_dac2(), str);
+    hex2str_alt(dac16_get(2), str);
     parser_puts(str);
     parser_puts("\r\n");
 }
 
+// Sets all four DACs to the values given (DAC0 to DAC3), changing the four 
+// outputs together
+void dac16_all_handler(char *args) {
+    uint16_t vals[DAC16_CHANNELS], i;
+    char *token, *remainder;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    for (i = 0; i < DAC16_CHANNELS; i++) {
+        if (!token || (str2hex(token, &vals[i]) != 0))
+            return;
+        token = str_tok_r((char *)NULL, ", ", &remainder);
+    }
+    dac16_set_many(0x0F, vals);
+}
+
+void dac16_allQ_handler(char *args) {
+    uint16_t i;
+    char str[5];
+
+    for (i = 0; i < DAC16_CHANNELS; i++) {
+        hex2str_alt(dac16_get(i), str);
+        parser_puts(str);
+        if (i < DAC16_CHANNELS - 1)
+            parser_putc(',');
+        else
+            parser_puts("\r\n");
+    }
+}
+
 // ADC16 commands
 void adc16_handler(char *args) {
     uint16_t i;
@@ -1083,6 +1492,46 @@ void adc24_regQ_handler(char *args) {
     }
 }
 
+void adc24_stream_handler(char *args) {
+    char *token, *remainder;
+    uint16_t val;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ":, ", &remainder);
+    if (token) {
+        if (str_cmp(token, "ON") == 0) {
+            val = ADC24_STREAM_ON;
+        } else if (str_cmp(token, "TIME") == 0) {
+            val = ADC24_STREAM_TIME;
+        } else if (str_cmp(token, "OFF") == 0) {
+            val = ADC24_STREAM_OFF;
+        } else if (str2hex(token, &val) != 0) {
+            return;
+        } else if (val > ADC24_STREAM_TIME) {
+            val = ADC24_STREAM_ON;
+        }
+
+        if (val && !parser_channel->adc24_stream) {
+            parser_channel->adc24_stream = val;
+            parser_channel->adc24_stream_seq = 0;
+            adc24_start();
+        } else if (val) {
+            parser_channel->adc24_stream = val;
+        } else if (parser_channel->adc24_stream) {
+            parser_channel->adc24_stream = ADC24_STREAM_OFF;
+            adc24_stop();
+        }
+    }
+}
+
+void adc24_streamQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(parser_channel->adc24_stream, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
 // DIGOUT commands
 void digout_handler(char *args) {
     uint16_t i;
@@ -1108,6 +1557,7 @@ void portd_handler(char *args) {
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
         LATD = (LATD & 0xFF80) | (val & 0x7F);
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1135,6 +1585,7 @@ void rd0_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD0_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1161,6 +1612,7 @@ void rd1_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD1_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1187,6 +1639,7 @@ void rd2_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD2_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1213,6 +1666,7 @@ void rd3_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD3_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1239,6 +1693,7 @@ void rd4_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD4_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1265,6 +1720,7 @@ void rd5_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD5_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1291,6 +1747,7 @@ void rd6_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RD6_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1309,6 +1766,7 @@ void porte_handler(char *args) {
     token = str_tok_r(args, ", ", &remainder);
     if (token && (str2hex(token, &val) == 0)) {
         LATE = (LATE & 0xFF80) | (val & 0x7F);
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1336,6 +1794,7 @@ void re0_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE0_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1362,6 +1821,7 @@ void re1_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE1_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1388,6 +1848,7 @@ void re2_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE2_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1414,6 +1875,7 @@ void re3_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE3_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1440,6 +1902,7 @@ void re4_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE4_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1466,6 +1929,7 @@ void re5_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE5_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1492,6 +1956,7 @@ void re6_handler(char *args) {
         } else if (str2hex(token, &val) == 0) {
             RE6_ = (val) ? 1 : 0;
         }
+        timer_stamp(TIMER_STAMP_DIGOUT);
     }
 }
 
@@ -1575,16 +2040,9 @@ void flash_erase_handler(char *args) {
     arg2 = (char *)NULL;
     arg1 = str_tok_r(args, ", ", &arg2);
     if (arg1 && arg2) {
-        if ((str2hex(arg1, &val1) == 0) && (str2hex(arg2, &val2) == 0)) {
-            NVMCON = 0x4042;                // set up NVMCON to erase a page of program memory
-            __asm__("push _TBLPAG");
-            TBLPAG = val1;
-            __builtin_tblwtl(val2, 0x0000);
-            __asm__("disi #16");            // disable interrupts for 16 cycles
-            __builtin_write_NVM();          // issue the unlock sequence and perform the write
-            while (NVMCONbits.WR == 1) {}   // wait until the write is complete
-            NVMCONbits.WREN = 0;            // disable further writes to program memory
-            __asm__("pop _TBLPAG");
+        if ((str2hex(arg1, &val1) == 0) && (str2hex(arg2, &val2) == 0) && 
+            !flash_protected(val1, val2)) {
+            flash_erase_page(val1, val2);
         }
     }
 }
@@ -1635,6 +2093,7 @@ void flash_write_handler(char *args) {
     uint16_t val1, val2, i;
     char *arg, *remainder;
     WORD temp;
+    TIMEOUT_T timeout;
 
     remainder = (char *)NULL;
     arg = str_tok_r(args, ", ", &remainder);
@@ -1645,6 +2104,11 @@ void flash_write_handler(char *args) {
     if (str2hex(arg, &val2) != 0)
         return;
 
+    if (flash_protected(val1, val2))
+        return;
+
+    trace_log(TRACE_FLASH_WRITE, val2);
+
     NVMCON = 0x4001;                // set up NVMCON to program a row of program memory
     __asm__("push _TBLPAG");        // save the value of TBLPAG
     TBLPAG = val1;
@@ -1682,241 +2146,2390 @@ void flash_write_handler(char *args) {
 
     __asm__("disi #16");            // disable interrupts for 16 cycles
     __builtin_write_NVM();          // issue the unlock sequence and perform the write
-    while (NVMCONbits.WR == 1) {}   // wait until the write is done
+    PERF_BEGIN(PERF_WAIT_NVM);
+    timeout_start(&timeout, TIMEOUT_NVM_US);
+    while (NVMCONbits.WR == 1) {    // wait until the write is done
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_NVM);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_NVM);
     NVMCONbits.WREN = 0;            // disable further writes to program memory
     __asm__("pop _TBLPAG");         // restore original value to TBLPAG
 }
 
-// Parser public methods
-void init_parser(void) {
-    cdc_cmd_buffer_pos = cdc_cmd_buffer;
-    cdc_cmd_buffer_left = CMD_BUFFER_LENGTH;
+// Replies with a binary block containing num instructions of program memory 
+// starting at page:offset, packed three bytes per instruction.
+void flash_readbin_handler(char *args) {
+    uint16_t page, offset, num, count, i;
+    char *arg, *remainder;
+    uint8_t data[FLASH_ROW_BYTES];
 
-    ble_cmd_buffer_pos = ble_cmd_buffer;
-    ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+    remainder = (char *)NULL;
+    arg = str_tok_r(args, ", ", &remainder);
+    if (str2hex(arg, &page) != 0)
+        return;
+    arg = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(arg, &offset) != 0)
+        return;
+    arg = str_tok_r((char *)NULL, ", ", &remainder);
+    if ((str2hex(arg, &num) != 0) || (num > 0xFFFF / 3))
+        return;
 
-    parser_state = parser_disconnected;
-    parser_last_state = (STATE_HANDLER_T)NULL;
-    parser_task = (STATE_HANDLER_T)NULL;
+    parser_block_begin(3 * num);
+    while (num) {
+        count = (num < FLASH_ROW_INSTRUCTIONS) ? num : FLASH_ROW_INSTRUCTIONS;
+        flash_read(page, offset, data, count);
+        for (i = 0; i < 3 * count; i++)
+            parser_block_putc(data[i]);
+        offset += 2 * count;
+        if (offset < 2 * count)
+            page++;
+        num -= count;
+    }
+    parser_block_end();
+}
+
+uint16_t flash_writebin_page, flash_writebin_offset;
+
+void flash_writebin_block_handler(uint8_t *data, uint16_t length) {
+    if (length != FLASH_ROW_BYTES) {
+        parser_reply_status(BLOCK_ERR_LENGTH);
+        return;
+    }
 
-    parser_putc = cdc_putc;
-    parser_puts = cdc_puts;
+    flash_write_row(flash_writebin_page, flash_writebin_offset, data);
+    parser_reply_status(BLOCK_OK);
 }
 
-void parser_disconnected(void) {
-    uint8_t ch;
-    uint16_t i;
-    char *command, *remainder;
+// Programs the (previously erased) row at page:offset with the contents of 
+// the binary block that follows the command, which must hold exactly one row
+// packed three bytes per instruction.  A status code is sent once the block 
+// has been received and the row written.
+void flash_writebin_handler(char *args) {
+    uint16_t page, offset;
+    char *arg, *remainder;
 
-    if (parser_state != parser_last_state) {
-        parser_last_state = parser_state;
+    remainder = (char *)NULL;
+    arg = str_tok_r(args, ", ", &remainder);
+    if (str2hex(arg, &page) != 0)
+        return;
+    arg = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(arg, &offset) != 0)
+        return;
+
+    if ((offset & (2 * FLASH_ROW_INSTRUCTIONS - 1)) || flash_protected(page, offset)) {
+        parser_reply_status(BLOCK_ERR_ADDRESS);
+        return;
+    }
 
-        ble_cmd_buffer_pos = ble_cmd_buffer;
-        ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+    if (parser_block_receive(flash_writebin_block_handler) == 0) {
+        flash_writebin_page = page;
+        flash_writebin_offset = offset;
     }
+}
+
+// Sets the unit ID, reported as the USB serial number from the next time 
+// that the board enumerates, to lo,hi
+void flash_serial_handler(char *args) {
+    char *token, *remainder;
+    WORD32 id;
 
-    if (parser_task)
-        parser_task();
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &id.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &id.w[1]) != 0)
+        return;
+    unit_id_write(id.ul);
+}
+
+void flash_serialQ_handler(char *args) {
+    WORD32 id;
+    char str[5];
 
-    if (ble_in_waiting() > 0) {
-        ch = ble_getc();
-        if (ble_cmd_buffer_left == 1) {
-            ble_cmd_buffer_pos = ble_cmd_buffer;
-            ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+    id.ul = unit_id_read();
+    hex2str_alt(id.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(id.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
 
-            *ble_cmd_buffer_pos++ = ch;
-            ble_cmd_buffer_left--;
-        } else if (ch == '%') {
-            if ((ble_cmd_buffer[0] == '%') && (ble_cmd_buffer_left < CMD_BUFFER_LENGTH)) {
-                *ble_cmd_buffer_pos++ = ch;
-                *ble_cmd_buffer_pos = '\0';
+// Replies with the first address that FLASH:ERASE, FLASH:WRITE, and 
+// FLASH:WRITEBIN accept and the address past the last one, each as lo,hi
+void flash_writableQ_handler(char *args) {
+    WORD32 start, end;
+    char str[5];
 
-                if (str_cmp(ble_cmd_buffer, "%STREAM_OPEN%") == 0)
-                    parser_state = parser_connected;
+    start.ul = flash_writable_start();
+    end.ul = FLASH_WRITABLE_END;
+    hex2str_alt(start.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(start.w[1], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(end.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(end.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
 
-                ble_cmd_buffer_pos = ble_cmd_buffer;
-                ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
-            } else {
-                ble_cmd_buffer_pos = ble_cmd_buffer;
-                ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+// BENCH commands
+void bench_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
 
-                *ble_cmd_buffer_pos++ = ch;
-                ble_cmd_buffer_left--;
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < BENCH_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, bench_table[i].command) == 0) {
+                bench_table[i].handler(remainder);
+                break;
             }
-        } else {
-            *ble_cmd_buffer_pos++ = ch;
-            ble_cmd_buffer_left--;
         }
     }
+}
 
-    if (cdc_in_waiting() > 0) {
-        ch = cdc_getc();
-        if (cdc_cmd_buffer_left == 1) {
-            cdc_cmd_buffer_pos = cdc_cmd_buffer;
-            cdc_cmd_buffer_left = CMD_BUFFER_LENGTH;
-
-            *cdc_cmd_buffer_pos++ = ch;
-            cdc_cmd_buffer_left--;
-        } else if (ch == '\r') {
-            *cdc_cmd_buffer_pos = '\0';
-
-//            cdc_putc('[');
-//            cdc_puts(cdc_cmd_buffer);
-//            cdc_puts("]\r\n");
-
-            parser_putc = cdc_putc;
-            parser_puts = cdc_puts;
-
-            remainder = (char *)NULL;
-            command = str_tok_r(cdc_cmd_buffer, ":, ", &remainder);
-            if (command) {
-                for (i = 0; i < ROOT_TABLE_ENTRIES; i++) {
-                    if (str_cmp(command, root_table[i].command) == 0) {
-                        root_table[i].handler(remainder);
-                        break;
-                    }
-                }
-            }
+void bench_run_handler(char *args) {
+    bench_run();
+}
 
-            cdc_cmd_buffer_pos = cdc_cmd_buffer;
-            cdc_cmd_buffer_left = CMD_BUFFER_LENGTH;
-        } else {
-            *cdc_cmd_buffer_pos++ = ch;
-            cdc_cmd_buffer_left--;
-        }
-    }
+// Replies with the cycle counts measured by the last BENCH:RUN, in the order 
+// of the BENCH_* cases in benchmark.h
+void bench_resultsQ_handler(char *args) {
+    uint16_t i;
+    char str[5];
 
-    if (parser_state != parser_last_state) {
-        parser_task = (STATE_HANDLER_T)NULL;
+    for (i = 0; i < BENCH_CASES; i++) {
+        hex2str_alt(bench_cycles[i], str);
+        parser_puts(str);
+        if (i < BENCH_CASES - 1)
+            parser_putc(',');
+        else
+            parser_puts("\r\n");
     }
 }
 
-void parser_connected(void) {
-    uint8_t ch;
+// PERF commands
+void perf_handler(char *args) {
     uint16_t i;
     char *command, *remainder;
 
-    if (parser_state != parser_last_state) {
-        parser_last_state = parser_state;
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < PERF_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, perf_table[i].command) == 0) {
+                perf_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
 
-        LED1 = ON;
+// Replies with the count (32 bits), total cycles (64 bits), and minimum and 
+// maximum cycles (32 bits each) accumulated by the specified probe, each 
+// sent as 16-bit words, least-significant word first
+void perfQ_handler(char *args) {
+    uint16_t probe, i;
+    WORD32 vals[3];
+    uint64_t total;
+    char str[5];
 
-        ble_cmd_buffer_pos = ble_cmd_buffer;
-        ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
-    }
+    if ((str2hex(args, &probe) != 0) || (probe >= PERF_PROBES))
+        return;
 
-    if (parser_task)
-        parser_task();
+    total = perf_probes[probe].total;
+    vals[0].ul = perf_probes[probe].count;
+    vals[1].ul = perf_probes[probe].count ? perf_probes[probe].min : 0;
+    vals[2].ul = perf_probes[probe].max;
+
+    hex2str_alt(vals[0].w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(vals[0].w[1], str);
+    parser_puts(str);
+    for (i = 0; i < 4; i++) {
+        parser_putc(',');
+        hex2str_alt((uint16_t)total, str);
+        parser_puts(str);
+        total >>= 16;
+    }
+    for (i = 1; i < 3; i++) {
+        parser_putc(',');
+        hex2str_alt(vals[i].w[0], str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(vals[i].w[1], str);
+        parser_puts(str);
+    }
+    parser_puts("\r\n");
+}
 
-    if (ble_in_waiting() > 0) {
-        ch = ble_getc();
-        if (ble_cmd_buffer_left == 1) {
-            ble_cmd_buffer_pos = ble_cmd_buffer;
-            ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+void perf_reset_handler(char *args) {
+    perf_reset();
+}
 
-            *ble_cmd_buffer_pos++ = ch;
-            ble_cmd_buffer_left--;
-        } else if (ch == '%') {
-            if ((ble_cmd_buffer[0] == '%') && (ble_cmd_buffer_left < CMD_BUFFER_LENGTH)) {
-                *ble_cmd_buffer_pos++ = ch;
-                *ble_cmd_buffer_pos = '\0';
+// Replies with the PERF_HIST_BINS bins of the main loop iteration histogram
+void perf_histQ_handler(char *args) {
+    uint16_t i;
+    char str[5];
 
-                if (str_cmp(ble_cmd_buffer, "%DISCONNECT%") == 0)
-                    parser_state = parser_disconnected;
+    for (i = 0; i < PERF_HIST_BINS; i++) {
+        hex2str_alt(perf_hist[i], str);
+        parser_puts(str);
+        if (i < PERF_HIST_BINS - 1)
+            parser_putc(',');
+        else
+            parser_puts("\r\n");
+    }
+}
 
-                ble_cmd_buffer_pos = ble_cmd_buffer;
-                ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
-            } else {
-                ble_cmd_buffer_pos = ble_cmd_buffer;
-                ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
+// TRACE commands
+void trace_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
 
-                *ble_cmd_buffer_pos++ = ch;
-                ble_cmd_buffer_left--;
-            }
-        } else if (ch == '\r') {
-            *ble_cmd_buffer_pos = '\0';
-
-//            ble_putc('[');
-//            ble_puts(ble_cmd_buffer);
-//            ble_puts("]\n\r");
-
-            parser_putc = ble_putc;
-            parser_puts = ble_puts;
-
-            remainder = (char *)NULL;
-            command = str_tok_r(ble_cmd_buffer, ":, ", &remainder);
-            if (command) {
-                for (i = 0; i < ROOT_TABLE_ENTRIES; i++) {
-                    if (str_cmp(command, root_table[i].command) == 0) {
-                        root_table[i].handler(remainder);
-                        break;
-                    }
-                }
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < TRACE_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, trace_table[i].command) == 0) {
+                trace_table[i].handler(remainder);
+                break;
             }
-
-            ble_cmd_buffer_pos = ble_cmd_buffer;
-            ble_cmd_buffer_left = CMD_BUFFER_LENGTH;
-        } else {
-            *ble_cmd_buffer_pos++ = ch;
-            ble_cmd_buffer_left--;
         }
     }
+}
 
-    if (cdc_in_waiting() > 0) {
-        ch = cdc_getc();
-        if (cdc_cmd_buffer_left == 1) {
-            cdc_cmd_buffer_pos = cdc_cmd_buffer;
-            cdc_cmd_buffer_left = CMD_BUFFER_LENGTH;
-
-            *cdc_cmd_buffer_pos++ = ch;
-            cdc_cmd_buffer_left--;
-        } else if (ch == '\r') {
-            *cdc_cmd_buffer_pos = '\0';
-
-//            cdc_putc('[');
-//            cdc_puts(cdc_cmd_buffer);
-//            cdc_puts("]\r\n");
-
-            parser_putc = cdc_putc;
-            parser_puts = cdc_puts;
-
-            remainder = (char *)NULL;
-            command = str_tok_r(cdc_cmd_buffer, ":, ", &remainder);
-            if (command) {
-                for (i = 0; i < ROOT_TABLE_ENTRIES; i++) {
-                    if (str_cmp(command, root_table[i].command) == 0) {
-                        root_table[i].handler(remainder);
-                        break;
-                    }
-                }
-            }
+void trace_enable_handler(char *args) {
+    char *token, *remainder;
+    uint16_t val;
 
-            cdc_cmd_buffer_pos = cdc_cmd_buffer;
-            cdc_cmd_buffer_left = CMD_BUFFER_LENGTH;
-        } else {
-            *cdc_cmd_buffer_pos++ = ch;
-            cdc_cmd_buffer_left--;
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ":, ", &remainder);
+    if (token) {
+        if (str_cmp(token, "ON") == 0) {
+            trace_enabled = TRUE;
+        } else if (str_cmp(token, "OFF") == 0) {
+            trace_enabled = FALSE;
+        } else if (str2hex(token, &val) == 0) {
+            trace_enabled = (val) ? TRUE : FALSE;
         }
     }
+}
 
-    if (parser_state != parser_last_state) {
-        parser_task = (STATE_HANDLER_T)NULL;
-        LED1 = OFF;
+void trace_enableQ_handler(char *args) {
+    if (trace_enabled)
+        parser_puts("1\r\n");
+    else
+        parser_puts("0\r\n");
+}
+
+void trace_clear_handler(char *args) {
+    trace_clear();
+}
+
+void trace_mark_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        trace_log(TRACE_MARK, val);
+}
+
+// Replies with a binary block containing the trace records, oldest first, 
+// in the format described in trace.h.  Tracing is paused while the block is 
+// sent, so that sending it does not overwrite the records being sent.
+void trace_dumpQ_handler(char *args) {
+    uint16_t enabled, head, count, i, j;
+    uint8_t *record;
+
+    enabled = trace_enabled;
+    trace_enabled = FALSE;
+
+    disable_interrupts();
+    head = trace_head;
+    count = trace_count;
+    enable_interrupts();
+
+    parser_block_begin(count * sizeof(TRACE_RECORD_T));
+    for (i = 0; i < count; i++) {
+        record = (uint8_t *)&trace_ring[head];
+        for (j = 0; j < sizeof(TRACE_RECORD_T); j++)
+            parser_block_putc(record[j]);
+        head++;
+        if (head == TRACE_LENGTH)
+            head = 0;
     }
+    parser_block_end();
+
+    trace_enabled = enabled;
 }
 
-void parser_forwarding(void) {
-    uint8_t ch;
+// Replies with the commands of the root dispatch table, in order, so that a 
+// host can name the table index logged with each TRACE_DISPATCH event
+void trace_commandsQ_handler(char *args) {
     uint16_t i;
 
-    if (parser_state != parser_last_state) {
-        parser_last_state = parser_state;
-        end_fwd_char_count = 0;
-        LED2 = ON;
+    for (i = 0; i < ROOT_TABLE_ENTRIES; i++) {
+        parser_puts(root_table[i].command);
+        if (i < ROOT_TABLE_ENTRIES - 1)
+            parser_putc(',');
+        else
+            parser_puts("\r\n");
+    }
+}
+
+// TIME commands
+void time_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < TIME_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, time_table[i].command) == 0) {
+                time_table[i].handler(remainder);
+                break;
+            }
+        }
     }
+}
+
+// Replies with the current Timer2/3 time as two 16-bit words, least- 
+// significant word first
+void timeQ_handler(char *args) {
+    WORD32 time;
+    char str[5];
+
+    time.ul = timer_read();
+    hex2str_alt(time.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(time.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the Timer2/3 time of the latest event of the specified kind 
+// (one of the TIMER_STAMP_* values in smu_base.h) as two 16-bit words, 
+// least-significant word first
+void time_stampQ_handler(char *args) {
+    uint16_t which;
+    WORD32 time;
+    char str[5];
+
+    if ((str2hex(args, &which) != 0) || (which >= TIMER_STAMPS))
+        return;
+
+    time.ul = timer_stamps[which];
+    hex2str_alt(time.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(time.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the 11-bit frame number of the latest USB start-of-frame 
+// packet followed by the Timer2/3 time at which it was seen (two 16-bit 
+// words, least-significant word first).  Frames start every 1 ms by the 
+// host's clock, so comparing two replies measures the device's timebase 
+// against the host's.
+void time_sofQ_handler(char *args) {
+    uint16_t frame;
+    WORD32 time;
+    char str[5];
+
+    disable_interrupts();
+    frame = USB_sof_frame;
+    time.ul = USB_sof_time;
+    enable_interrupts();
 
-    if (parser_task)
-        parser_task();
+    hex2str_alt(frame, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(time.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(time.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of times each spin-wait has timed out, in the 
+// order of the TIMEOUT_* codes in delay.h
+void time_timeoutsQ_handler(char *args) {
+    uint16_t i;
+    char str[5];
+
+    for (i = 0; i < TIMEOUTS; i++) {
+        hex2str_alt(timeout_counts[i], str);
+        parser_puts(str);
+        if (i < TIMEOUTS - 1)
+            parser_putc(',');
+        else
+            parser_puts("\r\n");
+    }
+}
+
+// PWM commands
+void pwm_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < PWM_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, pwm_table[i].command) == 0) {
+                pwm_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Sets a channel's period, high time, and phase, all in instruction cycles
+void pwm_set_handler(char *args) {
+    char *token, *remainder;
+    uint16_t ch, vals[3], i;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (!token || (str2hex(token, &ch) != 0))
+        return;
+    for (i = 0; i < 3; i++) {
+        token = str_tok_r((char *)NULL, ", ", &remainder);
+        if (!token || (str2hex(token, &vals[i]) != 0))
+            return;
+    }
+    pwm_set(ch, vals[0], vals[1], vals[2]);
+}
+
+// Replies with a channel's period, high time, and phase
+void pwm_setQ_handler(char *args) {
+    uint16_t ch;
+    char str[5];
+
+    if ((str2hex(args, &ch) != 0) || (ch >= PWM_CHANNELS))
+        return;
+
+    hex2str_alt(pwm_period[ch], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pwm_duty[ch], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pwm_phase[ch], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Maps a channel onto a header pin (0 to 5 for RD0 to RD5), or with OFF, 
+// unmaps it
+void pwm_pin_handler(char *args) {
+    char *token, *remainder;
+    uint16_t ch, pin;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (!token || (str2hex(token, &ch) != 0))
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (token) {
+        if (str_cmp(token, "OFF") == 0) {
+            pwm_assign(ch, PWM_PIN_NONE);
+        } else if (str2hex(token, &pin) == 0) {
+            pwm_assign(ch, pin);
+        }
+    }
+}
+
+// Replies with the header pin that a channel is mapped onto, or FFFF if none
+void pwm_pinQ_handler(char *args) {
+    uint16_t ch;
+    char str[5];
+
+    if ((str2hex(args, &ch) != 0) || (ch >= PWM_CHANNELS))
+        return;
+
+    hex2str_alt(pwm_pin[ch], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Starts the channels whose bits are set in the mask together, or with no 
+// mask, all of the channels that are mapped onto pins
+void pwm_start_handler(char *args) {
+    uint16_t mask;
+
+    if (!args || !*args)
+        mask = pwm_mapped();
+    else if (str2hex(args, &mask) != 0)
+        return;
+    pwm_start(mask);
+}
+
+void pwm_stop_handler(char *args) {
+    pwm_stop();
+}
+
+void pwm_runningQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pwm_running, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// PATGEN commands
+void patgen_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < PATGEN_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, patgen_table[i].command) == 0) {
+                patgen_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+uint16_t patgen_load_offset;
+
+void patgen_load_block_handler(uint8_t *data, uint16_t length) {
+    uint16_t i;
+
+    if ((length & 1) || (patgen_load_offset + (length >> 1) > PATGEN_LENGTH)) {
+        parser_reply_status(BLOCK_ERR_LENGTH);
+        return;
+    }
+    if (patgen_state != PATGEN_IDLE) {
+        parser_reply_status(BLOCK_ERR_BUSY);
+        return;
+    }
+
+    for (i = 0; i < length >> 1; i++)
+        patgen_vectors[patgen_load_offset + i] = data[2 * i] | (data[2 * i + 1] << 8);
+    patgen_length = patgen_load_offset + (length >> 1);
+    parser_reply_status(BLOCK_OK);
+}
+
+// Loads the vectors in the binary block that follows the command (16 bits 
+// each, least-significant byte first) into the pattern starting at the 
+// specified offset, making the pattern end with the last of them.  Longer 
+// patterns are loaded a block at a time, in order.  A status code is sent 
+// once the block has been received and loaded.
+void patgen_load_handler(char *args) {
+    uint16_t offset;
+
+    if ((str2hex(args, &offset) != 0) || (offset >= PATGEN_LENGTH)) {
+        parser_reply_status(BLOCK_ERR_ADDRESS);
+        return;
+    }
+
+    if (parser_block_receive(patgen_load_block_handler) == 0)
+        patgen_load_offset = offset;
+}
+
+void patgen_lengthQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(patgen_length, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the time between vectors in instruction cycles, given as two 16-bit 
+// words, least-significant word first
+void patgen_period_handler(char *args) {
+    char *token, *remainder;
+    WORD32 period;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &period.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        period.w[1] = 0;
+    else if (str2hex(token, &period.w[1]) != 0)
+        return;
+    patgen_set_period(period.ul);
+}
+
+void patgen_periodQ_handler(char *args) {
+    WORD32 period;
+    char str[5];
+
+    period.ul = patgen_period;
+    hex2str_alt(period.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(period.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the number of times the pattern is played, or with 0, plays it until 
+// stopped
+void patgen_count_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        patgen_count = val;
+}
+
+void patgen_countQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(patgen_count, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void patgen_mask_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        patgen_mask = val & PATGEN_MASK_ALL;
+}
+
+void patgen_maskQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(patgen_mask, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Selects the trigger input (a vector bit number or SW1) and the edge (0 for 
+// falling, 1 for rising) on which the pattern starts, or with OFF, starts 
+// the pattern as soon as PATGEN:START is received
+void patgen_trigger_handler(char *args) {
+    char *token, *remainder;
+    uint16_t source, edge;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (!token)
+        return;
+    if (str_cmp(token, "OFF") == 0) {
+        patgen_set_trigger(PATGEN_TRIGGER_NONE, PATGEN_RISING);
+        return;
+    } else if (str_cmp(token, "SW1") == 0) {
+        source = PATGEN_TRIGGER_SW1;
+    } else if (str2hex(token, &source) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        edge = PATGEN_RISING;
+    else if (str2hex(token, &edge) != 0)
+        return;
+    patgen_set_trigger(source, edge);
+}
+
+void patgen_triggerQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(patgen_trigger, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(patgen_edge, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void patgen_start_handler(char *args) {
+    patgen_start();
+}
+
+void patgen_stop_handler(char *args) {
+    patgen_stop();
+}
+
+// Replies with 0 if the generator is idle, 1 if it is waiting for its 
+// trigger, or 2 if it is playing the pattern
+void patgen_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(patgen_state, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// LOGIC commands
+void logic_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < LOGIC_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, logic_table[i].command) == 0) {
+                logic_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Selects the pins (as bits of a sample) to be made inputs for a capture
+void logic_inputs_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        logic_inputs = val & LOGIC_PINS_ALL;
+}
+
+void logic_inputsQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(logic_inputs, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the time between samples in instruction cycles, given as two 16-bit 
+// words, least-significant word first
+void logic_period_handler(char *args) {
+    char *token, *remainder;
+    WORD32 period;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &period.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        period.w[1] = 0;
+    else if (str2hex(token, &period.w[1]) != 0)
+        return;
+    logic_set_period(period.ul);
+}
+
+void logic_periodQ_handler(char *args) {
+    WORD32 period;
+    char str[5];
+
+    period.ul = logic_period;
+    hex2str_alt(period.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(period.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the trigger to the first sample whose bits selected by the mask have 
+// the specified values; with a mask of 0, the first sample triggers
+void logic_trigger_handler(char *args) {
+    char *token, *remainder;
+    uint16_t mask, value;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &mask) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        value = 0;
+    else if (str2hex(token, &value) != 0)
+        return;
+    logic_trigger_mask = mask & LOGIC_PINS_ALL;
+    logic_trigger_value = value & logic_trigger_mask;
+}
+
+void logic_triggerQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(logic_trigger_mask, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(logic_trigger_value, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the most samples before the trigger to send with a capture
+void logic_pre_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        logic_pre = val;
+}
+
+void logic_preQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(logic_pre, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the number of samples to take after the trigger, given as two 16-bit 
+// words, least-significant word first
+void logic_post_handler(char *args) {
+    char *token, *remainder;
+    WORD32 post;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &post.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        post.w[1] = 0;
+    else if (str2hex(token, &post.w[1]) != 0)
+        return;
+    logic_post = post.ul;
+}
+
+void logic_postQ_handler(char *args) {
+    WORD32 post;
+    char str[5];
+
+    post.ul = logic_post;
+    hex2str_alt(post.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(post.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void logic_start_handler(char *args) {
+    logic_start();
+}
+
+void logic_stop_handler(char *args) {
+    logic_stop();
+}
+
+// Replies with 0 if no capture is running, 1 if one is waiting for its 
+// trigger, 2 if it has triggered, or 3 if it has finished
+void logic_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(logic_state, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of the trigger sample among those of the last 
+// capture (two 16-bit words, least-significant word first, or FFFF,FFFF if 
+// it never triggered), followed by a binary block of its records, oldest 
+// first, in the format described in logic.h.  The block is empty while a 
+// capture is running.
+void logic_dataQ_handler(char *args) {
+    uint16_t first, skip, count, i, j;
+    uint32_t trigger;
+    WORD32 word;
+    char str[5];
+
+    count = logic_window(&first, &skip, &trigger);
+
+    word.ul = trigger;
+    hex2str_alt(word.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(word.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin(count * sizeof(LOGIC_RECORD_T));
+    j = first;
+    for (i = 0; i < count; i++) {
+        word.w[0] = logic_ring[j].value;
+        word.w[1] = logic_ring[j].count - ((i == 0) ? skip : 0);
+        parser_block_putc(word.b[0]);
+        parser_block_putc(word.b[1]);
+        parser_block_putc(word.b[2]);
+        parser_block_putc(word.b[3]);
+        j++;
+        if (j == LOGIC_LENGTH)
+            j = 0;
+    }
+    parser_block_end();
+}
+
+// TRIGGER commands
+void trigger_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < TRIGGER_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, trigger_table[i].command) == 0) {
+                trigger_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Selects the trigger source (SOFT, PIN, SW1, or ADC24, or its number) and 
+// the edge on which to fire (0 for falling or 1 for rising, the default)
+void trigger_source_handler(char *args) {
+    char *token, *remainder;
+    uint16_t source, edge;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (!token)
+        return;
+    if (str_cmp(token, "SOFT") == 0) {
+        source = TRIGGER_SRC_SOFT;
+    } else if (str_cmp(token, "PIN") == 0) {
+        source = TRIGGER_SRC_PIN;
+    } else if (str_cmp(token, "SW1") == 0) {
+        source = TRIGGER_SRC_SW1;
+    } else if (str_cmp(token, "ADC24") == 0) {
+        source = TRIGGER_SRC_ADC24;
+    } else if ((str2hex(token, &source) != 0) || (source > TRIGGER_SRC_ADC24))
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        edge = TRIGGER_RISING;
+    else if (str2hex(token, &edge) != 0)
+        return;
+    trigger_source = source;
+    trigger_edge = edge ? TRIGGER_RISING : TRIGGER_FALLING;
+}
+
+void trigger_sourceQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_source, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(trigger_edge, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Selects the header pin (0 to 5 for RD0 to RD5) watched by the PIN source
+void trigger_pin_handler(char *args) {
+    uint16_t val;
+
+    if ((str2hex(args, &val) == 0) && (val < PWM_PINS))
+        trigger_pin = val;
+}
+
+void trigger_pinQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_pin, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the ADC24 channel (1 or 2) and the level, in offset-corrected ADC24 
+// codes given as two 16-bit words, least-significant word first, that its 
+// samples must cross to fire the ADC24 source
+void trigger_level_handler(char *args) {
+    char *token, *remainder;
+    uint16_t channel;
+    WORD32 level;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if ((str2hex(token, &channel) != 0) || (channel < 1) || (channel > 2))
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &level.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        level.w[1] = 0;
+    else if (str2hex(token, &level.w[1]) != 0)
+        return;
+    trigger_channel = channel;
+    trigger_level = (int32_t)level.ul;
+}
+
+void trigger_levelQ_handler(char *args) {
+    WORD32 level;
+    char str[5];
+
+    level.ul = (uint32_t)trigger_level;
+    hex2str_alt(trigger_channel, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(level.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(level.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Selects SINGLE (0) or AUTO (1) mode
+void trigger_mode_handler(char *args) {
+    char *token, *remainder;
+    uint16_t val;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (!token)
+        return;
+    if (str_cmp(token, "SINGLE") == 0) {
+        val = TRIGGER_SINGLE;
+    } else if (str_cmp(token, "AUTO") == 0) {
+        val = TRIGGER_AUTO;
+    } else if (str2hex(token, &val) != 0)
+        return;
+    trigger_mode = val ? TRIGGER_AUTO : TRIGGER_SINGLE;
+}
+
+void trigger_modeQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_mode, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the least time from firing to re-arming in instruction cycles, 
+// given as two 16-bit words, least-significant word first
+void trigger_holdoff_handler(char *args) {
+    char *token, *remainder;
+    WORD32 holdoff;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &holdoff.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        holdoff.w[1] = 0;
+    else if (str2hex(token, &holdoff.w[1]) != 0)
+        return;
+    trigger_holdoff = holdoff.ul;
+}
+
+void trigger_holdoffQ_handler(char *args) {
+    WORD32 holdoff;
+    char str[5];
+
+    holdoff.ul = trigger_holdoff;
+    hex2str_alt(holdoff.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(holdoff.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Selects the actions to start on firing, as a mask of TRIGGER_ACTION_* bits
+void trigger_actions_handler(char *args) {
+    uint16_t val;
+
+    if (str2hex(args, &val) == 0)
+        trigger_actions = val & TRIGGER_ACTIONS_ALL;
+}
+
+void trigger_actionsQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_actions, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Selects the trigger-out pin (as its bit number in a pattern generator 
+// vector), or with OFF, none
+void trigger_out_handler(char *args) {
+    uint16_t val;
+
+    if (!args)
+        return;
+    if (str_cmp(args, "OFF") == 0)
+        trigger_out = TRIGGER_OUT_NONE;
+    else if ((str2hex(args, &val) == 0) && (val < 16) && ((1 << val) & PATGEN_MASK_ALL))
+        trigger_out = val;
+}
+
+void trigger_outQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_out, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the most ADC24 frames to keep from before the trigger and the number 
+// to take from the trigger on
+void trigger_depth_handler(char *args) {
+    char *token, *remainder;
+    uint16_t pre, post;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &pre) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &post) != 0)
+        return;
+    trigger_set_depth(pre, post);
+}
+
+void trigger_depthQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_pre, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(trigger_post, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void trigger_arm_handler(char *args) {
+    trigger_arm();
+}
+
+void trigger_force_handler(char *args) {
+    trigger_force();
+}
+
+void trigger_stop_handler(char *args) {
+    trigger_stop();
+}
+
+// Replies with the state (0 if idle, 1 if armed, 2 if fired, or 3 if done) 
+// and the number of times that the trigger has fired since it was armed
+void trigger_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(trigger_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(trigger_fires, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of the first frame after the trigger among those 
+// of the last ADC24 capture, followed by a binary block of its frames, 
+// oldest first, in the format described in trigger.h.  The block is empty 
+// until a capture is complete.  Reading a capture lets a trigger in 
+// TRIGGER_AUTO mode re-arm.
+void trigger_dataQ_handler(char *args) {
+    uint16_t first, index, count, i, j;
+    char str[5];
+
+    count = trigger_window(&first, &index);
+
+    hex2str_alt(count ? index : 0, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin(count * TRIGGER_FRAME_LENGTH);
+    j = first;
+    for (i = 0; i < count; i++) {
+        parser_block_putc((uint8_t)trigger_ring[j].ch1);
+        parser_block_putc((uint8_t)(trigger_ring[j].ch1 >> 8));
+        parser_block_putc((uint8_t)(trigger_ring[j].ch1 >> 16));
+        parser_block_putc((uint8_t)trigger_ring[j].ch2);
+        parser_block_putc((uint8_t)(trigger_ring[j].ch2 >> 8));
+        parser_block_putc((uint8_t)(trigger_ring[j].ch2 >> 16));
+        j++;
+        if (j == TRIGGER_LENGTH)
+            j = 0;
+    }
+    parser_block_end();
+
+    if (count)
+        trigger_read();
+}
+
+// SYNC commands
+void sync_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < SYNC_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, sync_table[i].command) == 0) {
+                sync_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Makes the board a sync master or slave, or with OFF, neither
+void sync_mode_handler(char *args) {
+    uint16_t val;
+
+    if (!args)
+        return;
+    if (str_cmp(args, "OFF") == 0)
+        val = SYNC_OFF;
+    else if (str_cmp(args, "MASTER") == 0)
+        val = SYNC_MASTER;
+    else if (str_cmp(args, "SLAVE") == 0)
+        val = SYNC_SLAVE;
+    else if (str2hex(args, &val) != 0)
+        return;
+    sync_set_mode(val);
+}
+
+void sync_modeQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(sync_mode, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void sync_reset_handler(char *args) {
+    sync_reset();
+}
+
+// Replies with the Timer2/3 time of the last epoch (two 16-bit words, 
+// least-significant word first) and the number of epochs seen
+void sync_epochQ_handler(char *args) {
+    WORD32 epoch;
+    char str[5];
+
+    epoch.ul = sync_epoch;
+    hex2str_alt(epoch.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(epoch.w[1], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(sync_epochs, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// LOCKIN commands
+void lockin_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < LOCKIN_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, lockin_table[i].command) == 0) {
+                lockin_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// The settings of the lock-in can only be changed while it is stopped
+void lockin_dac_handler(char *args) {
+    uint16_t val;
+
+    if ((lockin_state == LOCKIN_IDLE) && (str2hex(args, &val) == 0) && 
+        (val < DAC16_CHANNELS))
+        lockin_dac = val;
+}
+
+void lockin_dacQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(lockin_dac, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the offset and the amplitude of the sine, in DAC16 codes
+void lockin_level_handler(char *args) {
+    char *token, *remainder;
+    uint16_t offset, amplitude;
+
+    if (lockin_state != LOCKIN_IDLE)
+        return;
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &offset) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if ((str2hex(token, &amplitude) != 0) || (amplitude > 0x8000))
+        return;
+    lockin_offset = offset;
+    lockin_amplitude = amplitude;
+}
+
+void lockin_levelQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(lockin_offset, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(lockin_amplitude, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void lockin_points_handler(char *args) {
+    uint16_t val;
+
+    if ((lockin_state == LOCKIN_IDLE) && (str2hex(args, &val) == 0) && 
+        (val >= LOCKIN_POINTS_MIN) && (val <= LOCKIN_POINTS_MAX))
+        lockin_points = val;
+}
+
+void lockin_pointsQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(lockin_points, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void lockin_cycles_handler(char *args) {
+    uint16_t val;
+
+    if ((lockin_state == LOCKIN_IDLE) && (str2hex(args, &val) == 0) && val)
+        lockin_cycles = val;
+}
+
+void lockin_cyclesQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(lockin_cycles, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void lockin_start_handler(char *args) {
+    lockin_start();
+}
+
+void lockin_stop_handler(char *args) {
+    lockin_stop();
+}
+
+// Replies with the state (0 if idle, 1 if settling, or 2 if running), the 
+// number of results taken since the lock-in was started, and the number of 
+// results discarded since then for a missed frame
+void lockin_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(lockin_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(lockin_results, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(lockin_missed, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the latest result, as the CH1 I and Q and the CH2 I and Q, 
+// each as two words, least-significant first, followed by the number of 
+// results taken since the lock-in was started
+void lockin_resultQ_handler(char *args) {
+    WORD32 vals[4];
+    uint16_t i;
+    char str[5];
+
+    vals[0].l = lockin_result.ch1_i;
+    vals[1].l = lockin_result.ch1_q;
+    vals[2].l = lockin_result.ch2_i;
+    vals[3].l = lockin_result.ch2_q;
+    for (i = 0; i < 4; i++) {
+        hex2str_alt(vals[i].w[0], str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(vals[i].w[1], str);
+        parser_puts(str);
+        parser_putc(',');
+    }
+    hex2str_alt(lockin_results, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// PULSE commands
+void pulse_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < PULSE_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, pulse_table[i].command) == 0) {
+                pulse_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// The settings of the pulse generator can only be changed while it is 
+// stopped
+void pulse_dac_handler(char *args) {
+    uint16_t val;
+
+    if ((pulse_state == PULSE_IDLE) && (str2hex(args, &val) == 0) && 
+        (val < DAC16_CHANNELS))
+        pulse_dac = val;
+}
+
+void pulse_dacQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pulse_dac, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the DAC16 codes between pulses and during them
+void pulse_level_handler(char *args) {
+    char *token, *remainder;
+    uint16_t base, level;
+
+    if (pulse_state != PULSE_IDLE)
+        return;
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &base) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &level) != 0)
+        return;
+    pulse_base = base;
+    pulse_level = level;
+}
+
+void pulse_levelQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pulse_base, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pulse_level, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the period, the width, and the delay to the capture window of the 
+// pulses, in instruction cycles, each given as two 16-bit words, 
+// least-significant word first; ignored unless they fit (see 
+// pulse_set_timing)
+void pulse_timing_handler(char *args) {
+    char *token, *remainder;
+    WORD32 vals[3];
+    uint16_t i;
+
+    if (pulse_state != PULSE_IDLE)
+        return;
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    for (i = 0; i < 6; i++) {
+        if (str2hex(token, &vals[i >> 1].w[i & 1]) != 0)
+            return;
+        token = str_tok_r((char *)NULL, ", ", &remainder);
+    }
+    pulse_set_timing(vals[0].ul, vals[1].ul, vals[2].ul);
+}
+
+void pulse_timingQ_handler(char *args) {
+    WORD32 vals[3];
+    uint16_t i;
+    char str[5];
+
+    vals[0].ul = pulse_period;
+    vals[1].ul = pulse_width;
+    vals[2].ul = pulse_delay;
+    for (i = 0; i < 3; i++) {
+        hex2str_alt(vals[i].w[0], str);
+        parser_puts(str);
+        parser_putc(',');
+        hex2str_alt(vals[i].w[1], str);
+        parser_puts(str);
+        parser_puts((i < 2) ? "," : "\r\n");
+    }
+}
+
+// Sets the most ADC24 frames to average in each capture window
+void pulse_frames_handler(char *args) {
+    uint16_t val;
+
+    if ((pulse_state == PULSE_IDLE) && (str2hex(args, &val) == 0) && 
+        val && (val <= PULSE_FRAMES_MAX))
+        pulse_frames = val;
+}
+
+void pulse_framesQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pulse_frames, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the number of pulses to run, or with 0, pulses until stopped
+void pulse_count_handler(char *args) {
+    uint16_t val;
+
+    if ((pulse_state == PULSE_IDLE) && (str2hex(args, &val) == 0))
+        pulse_count = val;
+}
+
+void pulse_countQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pulse_count, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void pulse_start_handler(char *args) {
+    pulse_start();
+}
+
+void pulse_stop_handler(char *args) {
+    pulse_stop();
+}
+
+// Replies with the state (0 if idle or 1 if running), the number of pulses 
+// run, the number of results taken, and the number of pulses missed since 
+// the pulse generator was started
+void pulse_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(pulse_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pulse_pulses, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pulse_results, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(pulse_missed, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of results kept, followed by a binary block of 
+// them, oldest first, in the format described in pulse.h
+void pulse_dataQ_handler(char *args) {
+    uint16_t results, count, i, j;
+    char str[5];
+
+    results = pulse_results;
+    count = (results < PULSE_LENGTH) ? results : PULSE_LENGTH;
+
+    hex2str_alt(count, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin(count * PULSE_RESULT_LENGTH);
+    j = results - count;
+    for (i = 0; i < count; i++) {
+        j &= PULSE_LENGTH - 1;
+        parser_block_putc((uint8_t)pulse_ring[j].ch1);
+        parser_block_putc((uint8_t)(pulse_ring[j].ch1 >> 8));
+        parser_block_putc((uint8_t)(pulse_ring[j].ch1 >> 16));
+        parser_block_putc((uint8_t)pulse_ring[j].ch2);
+        parser_block_putc((uint8_t)(pulse_ring[j].ch2 >> 8));
+        parser_block_putc((uint8_t)(pulse_ring[j].ch2 >> 16));
+        j++;
+    }
+    parser_block_end();
+}
+
+// STATS commands
+void stats_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < STATS_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, stats_table[i].command) == 0) {
+                stats_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Parses a 32-bit value given as two 16-bit words, least-significant word 
+// first; returns 0 if it parsed, or 1 if not
+uint16_t stats_parse32(char *args, uint32_t *val) {
+    char *token, *remainder;
+    WORD32 word;
+
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &word.w[0]) != 0)
+        return 1;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (!token)
+        word.w[1] = 0;
+    else if (str2hex(token, &word.w[1]) != 0)
+        return 1;
+    *val = word.ul;
+    return 0;
+}
+
+void stats_reply32(uint32_t val) {
+    WORD32 word;
+    char str[5];
+
+    word.ul = val;
+    hex2str_alt(word.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(word.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the most frames in a block, or with 0, no limit on them (so long as 
+// the window is limited); settings can only be changed while stopped
+void stats_frames_handler(char *args) {
+    uint32_t val;
+
+    if ((stats_state == STATS_IDLE) && (stats_parse32(args, &val) == 0))
+        stats_set_limits(val, stats_window);
+}
+
+void stats_framesQ_handler(char *args) {
+    stats_reply32(stats_frames);
+}
+
+// Sets the longest time that a block spans, in Timer2/3 ticks, or with 0, 
+// no limit on it (so long as the frames are limited)
+void stats_window_handler(char *args) {
+    uint32_t val;
+
+    if ((stats_state == STATS_IDLE) && (stats_parse32(args, &val) == 0))
+        stats_set_limits(stats_frames, val);
+}
+
+void stats_windowQ_handler(char *args) {
+    stats_reply32(stats_window);
+}
+
+void stats_start_handler(char *args) {
+    stats_start();
+}
+
+void stats_stop_handler(char *args) {
+    stats_stop();
+}
+
+// Replies with the state (0 if idle or 1 if running) and the number of 
+// blocks completed since statistics were started
+void stats_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(stats_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(stats_results, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void stats_block_put(uint8_t *bytes, uint16_t count) {
+    uint16_t i;
+
+    for (i = 0; i < count; i++)
+        parser_block_putc(bytes[i]);
+}
+
+// Replies with the number of blocks completed since statistics were 
+// started, followed by a binary block of the latest result in the format 
+// described in stats.h
+void stats_dataQ_handler(char *args) {
+    STATS_RESULT_T result;
+    uint16_t i;
+    char str[5];
+
+    result = stats_result;
+
+    hex2str_alt(stats_results, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin(STATS_RESULT_LENGTH);
+    stats_block_put((uint8_t *)&result.frames, 4);
+    stats_block_put((uint8_t *)&result.time, 4);
+    for (i = 0; i < 2; i++) {
+        stats_block_put((uint8_t *)&result.ch[i].sum, 8);
+        stats_block_put((uint8_t *)&result.ch[i].sumsq, 8);
+        stats_block_put((uint8_t *)&result.ch[i].sumsq_hi, 2);
+        stats_block_put((uint8_t *)&result.ch[i].min, 3);
+        stats_block_put((uint8_t *)&result.ch[i].max, 3);
+    }
+    parser_block_end();
+}
+
+// HIST commands
+void hist_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < HIST_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, hist_table[i].command) == 0) {
+                hist_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Selects the channel to count (see HIST_SRC_* in hist.h); settings can 
+// only be changed while the histogram is stopped
+void hist_source_handler(char *args) {
+    uint16_t val;
+
+    if ((hist_state == HIST_IDLE) && (str2hex(args, &val) == 0) && 
+        (val <= HIST_SRC_ADC16_CH2))
+        hist_source = val;
+}
+
+void hist_sourceQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(hist_source, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the start of the first bin (two 16-bit words, least-significant word 
+// first), the width of each bin as a power of 2, and the number of bins
+void hist_range_handler(char *args) {
+    char *token, *remainder;
+    WORD32 low;
+    uint16_t shift, bins;
+
+    if (hist_state != HIST_IDLE)
+        return;
+    remainder = (char *)NULL;
+    token = str_tok_r(args, ", ", &remainder);
+    if (str2hex(token, &low.w[0]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &low.w[1]) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &shift) != 0)
+        return;
+    token = str_tok_r((char *)NULL, ", ", &remainder);
+    if (str2hex(token, &bins) != 0)
+        return;
+    hist_set_range(low.l, shift, bins);
+}
+
+void hist_rangeQ_handler(char *args) {
+    WORD32 low;
+    char str[5];
+
+    low.l = hist_low;
+    hex2str_alt(low.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(low.w[1], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(hist_shift, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(hist_bins, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void hist_start_handler(char *args) {
+    hist_start();
+}
+
+void hist_stop_handler(char *args) {
+    hist_stop();
+}
+
+// Replies with the state (0 if idle or 1 if running) and the number of 
+// samples counted since the histogram was started (two 16-bit words, 
+// least-significant word first)
+void hist_stateQ_handler(char *args) {
+    WORD32 samples;
+    char str[5];
+
+    samples.ul = hist_samples;
+    hex2str_alt(hist_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(samples.w[0], str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(samples.w[1], str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of bins, followed by a binary block of the 
+// counts below the first bin, beyond the last bin, and in each bin, 4 bytes 
+// each, least-significant byte first; the bins read as 0 once an FFT has 
+// taken their memory
+void hist_dataQ_handler(char *args) {
+    WORD32 count;
+    uint16_t bins, i, j;
+    char str[5];
+
+    bins = hist_bins;
+
+    hex2str_alt(bins, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin((bins + 2) * 4);
+    for (i = 0; i < bins + 2; i++) {
+        if (i == 0)
+            count.ul = hist_under;
+        else if (i == 1)
+            count.ul = hist_over;
+        else
+            count.ul = hist_samples ? fft_hist_buffer.bins[i - 2] : 0;
+        for (j = 0; j < 4; j++)
+            parser_block_putc(count.b[j]);
+    }
+    parser_block_end();
+}
+
+// FFT commands
+void fft_handler(char *args) {
+    uint16_t i;
+    char *command, *remainder;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(args, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < FFT_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, fft_table[i].command) == 0) {
+                fft_table[i].handler(remainder);
+                break;
+            }
+        }
+    }
+}
+
+// Selects the channel to transform (see FFT_SRC_* in fft.h); settings can 
+// only be changed while no spectrum is being taken
+void fft_source_handler(char *args) {
+    uint16_t val;
+
+    if ((fft_state != FFT_RUNNING) && (str2hex(args, &val) == 0) && 
+        (val <= FFT_SRC_ADC16_CH2))
+        fft_source = val;
+}
+
+void fft_sourceQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(fft_source, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the number of bits by which to shift samples right before the FFT
+void fft_shift_handler(char *args) {
+    uint16_t val;
+
+    if ((fft_state != FFT_RUNNING) && (str2hex(args, &val) == 0) && 
+        (val <= FFT_SHIFT_MAX))
+        fft_shift = val;
+}
+
+void fft_shiftQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(fft_shift, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Sets the number of blocks to average, or with 0, runs until stopped
+void fft_averages_handler(char *args) {
+    uint16_t val;
+
+    if ((fft_state != FFT_RUNNING) && (str2hex(args, &val) == 0))
+        fft_averages = val;
+}
+
+void fft_averagesQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(fft_averages, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+void fft_start_handler(char *args) {
+    fft_start();
+}
+
+void fft_stop_handler(char *args) {
+    fft_stop();
+}
+
+// Replies with the state (0 if idle, 1 if running, or 2 if done), the 
+// number of blocks averaged, and the number of samples clipped since the 
+// spectrum was started
+void fft_stateQ_handler(char *args) {
+    char str[5];
+
+    hex2str_alt(fft_state, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(fft_blocks, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt(fft_clipped, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Replies with the number of blocks averaged and the exponent of the bins, 
+// followed by a binary block of the FFT_BINS sums of block powers, 4 bytes 
+// each, least-significant byte first, as described in fft.h
+void fft_dataQ_handler(char *args) {
+    WORD32 power;
+    uint16_t i, j;
+    char str[5];
+
+    hex2str_alt(fft_blocks, str);
+    parser_puts(str);
+    parser_putc(',');
+    hex2str_alt((uint16_t)fft_exponent, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+
+    parser_block_begin(FFT_BINS * 4);
+    for (i = 0; i < FFT_BINS; i++) {
+        power.ul = fft_power[i];
+        for (j = 0; j < 4; j++)
+            parser_block_putc(power.b[j]);
+    }
+    parser_block_end();
+}
+
+// Parser channel methods
+void parser_putc(uint8_t ch) {
+    parser_channel->putch(ch);
+}
+
+void parser_puts(uint8_t *str) {
+    if (parser_dispatching && timeout_pending) {
+        parser_channel->putch(TIMEOUT_MARK);
+        timeout_pending = FALSE;
+    }
+    parser_channel->putstr(str);
+}
+
+void parser_reply_status(uint16_t status) {
+    char str[5];
+
+    hex2str_alt(status, str);
+    parser_puts(str);
+    parser_puts("\r\n");
+}
+
+// Binary block methods
+uint32_t crc32_update(uint32_t crc, uint8_t ch) {
+    crc = (crc >> 4) ^ crc32_table[((uint16_t)crc ^ ch) & 0x0F];
+    crc = (crc >> 4) ^ crc32_table[((uint16_t)crc ^ (ch >> 4)) & 0x0F];
+    return crc;
+}
+
+void parser_block_begin(uint16_t length) {
+    parser_putc(BLOCK_START);
+    parser_putc((uint8_t)length);
+    parser_putc((uint8_t)(length >> 8));
+    block_tx_crc = 0xFFFFFFFF;
+}
+
+void parser_block_putc(uint8_t ch) {
+    block_tx_crc = crc32_update(block_tx_crc, ch);
+    parser_putc(ch);
+}
+
+void parser_block_end(void) {
+    block_tx_crc ^= 0xFFFFFFFF;
+    parser_putc((uint8_t)block_tx_crc);
+    parser_putc((uint8_t)(block_tx_crc >> 8));
+    parser_putc((uint8_t)(block_tx_crc >> 16));
+    parser_putc((uint8_t)(block_tx_crc >> 24));
+}
+
+// Arranges for the next bytes received on the current channel to be taken as 
+// a binary block.  Once the whole block has arrived, the handler is called 
+// with the payload if its CRC checks out; otherwise an error status is sent.
+// The block buffer is shared by all channels, so this fails (after replying 
+// BLOCK_ERR_BUSY) if another channel is in the middle of sending a block.
+int16_t parser_block_receive(PARSER_BLOCK_HANDLER_T handler) {
+    if (block_buffer_owner && (block_buffer_owner != parser_channel)) {
+        parser_reply_status(BLOCK_ERR_BUSY);
+        return -1;
+    }
+
+    block_buffer_owner = parser_channel;
+    parser_channel->block_handler = handler;
+    parser_channel->block_count = 0;
+    parser_channel->block_length = 0;
+    parser_channel->block_status = BLOCK_OK;
+    parser_channel->block_crc = 0xFFFFFFFF;
+    return 0;
+}
+
+void parser_release_block(PARSER_CHANNEL_T *channel) {
+    channel->block_handler = (PARSER_BLOCK_HANDLER_T)NULL;
+    if (block_buffer_owner == channel)
+        block_buffer_owner = (PARSER_CHANNEL_T *)NULL;
+}
+
+void parser_receive_block(PARSER_CHANNEL_T *channel, uint8_t ch) {
+    PARSER_BLOCK_HANDLER_T handler;
+
+    parser_channel = channel;
+
+    if (channel->block_count == 0) {
+        if (ch != BLOCK_START) {
+            parser_release_block(channel);
+            parser_reply_status(BLOCK_ERR_FORMAT);
+            return;
+        }
+    } else if (channel->block_count == 1) {
+        channel->block_length = (uint16_t)ch;
+    } else if (channel->block_count == 2) {
+        channel->block_length |= (uint16_t)ch << 8;
+        if (channel->block_length > BLOCK_BUFFER_LENGTH)
+            channel->block_status = BLOCK_ERR_LENGTH;
+    } else if (channel->block_count < channel->block_length + 3) {
+        if (channel->block_status == BLOCK_OK)
+            block_buffer[channel->block_count - 3] = ch;
+        channel->block_crc = crc32_update(channel->block_crc, ch);
+    } else {
+        if (channel->block_count == channel->block_length + 3)
+            channel->block_crc ^= 0xFFFFFFFF;
+        if ((ch != (uint8_t)channel->block_crc) && (channel->block_status == BLOCK_OK))
+            channel->block_status = BLOCK_ERR_CRC;
+        channel->block_crc >>= 8;
+
+        if (channel->block_count == channel->block_length + 6) {
+            handler = channel->block_handler;
+            parser_release_block(channel);
+            if (channel->block_status == BLOCK_OK)
+                handler(block_buffer, channel->block_length);
+            else
+                parser_reply_status(channel->block_status);
+            return;
+        }
+    }
+    channel->block_count++;
+}
+
+void parser_reset_channel(PARSER_CHANNEL_T *channel) {
+    channel->cmd_buffer_pos = channel->cmd_buffer;
+    channel->cmd_buffer_left = CMD_BUFFER_LENGTH;
+}
+
+void parser_close_channel(PARSER_CHANNEL_T *channel) {
+    parser_reset_channel(channel);
+    parser_release_block(channel);
+
+    if (channel->adc24_stream) {
+        channel->adc24_stream = FALSE;
+        adc24_stop();
+    }
+
+    channel->task = (STATE_HANDLER_T)NULL;
+}
+
+uint16_t parser_receive(PARSER_CHANNEL_T *channel, uint16_t status_msgs) {
+    uint8_t ch;
+
+    if (channel->in_waiting() == 0)
+        return PARSER_RX_NONE;
+
+    ch = channel->getch();
+    if (channel->block_handler) {
+        parser_receive_block(channel, ch);
+    } else if (channel->cmd_buffer_left == 1) {
+        parser_reset_channel(channel);
+
+        *channel->cmd_buffer_pos++ = ch;
+        channel->cmd_buffer_left--;
+    } else if (status_msgs && (ch == '%')) {
+        if ((channel->cmd_buffer[0] == '%') && (channel->cmd_buffer_left < CMD_BUFFER_LENGTH)) {
+            *channel->cmd_buffer_pos++ = ch;
+            *channel->cmd_buffer_pos = '\0';
+
+            parser_reset_channel(channel);
+            return PARSER_RX_STATUS;
+        } else {
+            parser_reset_channel(channel);
+
+            *channel->cmd_buffer_pos++ = ch;
+            channel->cmd_buffer_left--;
+        }
+    } else if (ch == '\r') {
+        *channel->cmd_buffer_pos = '\0';
+
+        parser_reset_channel(channel);
+        return PARSER_RX_COMMAND;
+    } else {
+        *channel->cmd_buffer_pos++ = ch;
+        channel->cmd_buffer_left--;
+    }
+
+    return PARSER_RX_NONE;
+}
+
+void parser_dispatch(PARSER_CHANNEL_T *channel) {
+    uint16_t i;
+    char *command, *remainder;
+
+    parser_channel = channel;
+
+    remainder = (char *)NULL;
+    command = str_tok_r(channel->cmd_buffer, ":, ", &remainder);
+    if (command) {
+        for (i = 0; i < ROOT_TABLE_ENTRIES; i++) {
+            if (str_cmp(command, root_table[i].command) == 0) {
+                trace_log(TRACE_DISPATCH, ((channel == &ble_channel) ? 0x100 : 0) | i);
+                PERF_BEGIN(PERF_DISPATCH);
+                timeout_pending = FALSE;
+                parser_dispatching = TRUE;
+                root_table[i].handler(remainder);
+                parser_dispatching = FALSE;
+                PERF_END(PERF_DISPATCH);
+                break;
+            }
+        }
+    }
+}
+
+void parser_run_tasks(void) {
+    if (cdc_channel.task) {
+        parser_channel = &cdc_channel;
+        cdc_channel.task();
+    }
+
+    if (ble_channel.task) {
+        parser_channel = &ble_channel;
+        ble_channel.task();
+    }
+}
+
+void parser_send_adc24_frame(PARSER_CHANNEL_T *channel, int32_t ch1val, int32_t ch2val) {
+    WORD32 time;
+    uint16_t length;
+
+    if (!channel->adc24_stream)
+        return;
+
+    length = (channel->adc24_stream == ADC24_STREAM_TIME) ? ADC24_STREAM_TIME_FRAME_LENGTH : ADC24_STREAM_FRAME_LENGTH;
+
+    // Drop the frame rather than block if the channel cannot take all of it;
+    // the host sees the gap in the sequence numbers.
+    if (channel->tx_space() >= length) {
+        if (channel->adc24_stream == ADC24_STREAM_TIME) {
+            time.ul = timer_stamps[TIMER_STAMP_ADC24];
+            channel->putch(ADC24_STREAM_TIME_SYNC);
+            channel->putch(channel->adc24_stream_seq);
+            channel->putch(time.b[0]);
+            channel->putch(time.b[1]);
+            channel->putch(time.b[2]);
+            channel->putch(time.b[3]);
+        } else {
+            channel->putch(ADC24_STREAM_SYNC);
+            channel->putch(channel->adc24_stream_seq);
+        }
+        channel->putch((uint8_t)ch1val);
+        channel->putch((uint8_t)(ch1val >> 8));
+        channel->putch((uint8_t)(ch1val >> 16));
+        channel->putch((uint8_t)ch2val);
+        channel->putch((uint8_t)(ch2val >> 8));
+        channel->putch((uint8_t)(ch2val >> 16));
+    } else
+        trace_log(TRACE_FRAME_DROP, (channel == &ble_channel) ? 1 : 0);
+    channel->adc24_stream_seq++;
+}
+
+uint16_t parser_stream_wanted(void) {
+    return (cdc_channel.adc24_stream || ble_channel.adc24_stream) ? 1 : 0;
+}
+
+void parser_stream_frame(int32_t ch1val, int32_t ch2val) {
+    parser_send_adc24_frame(&cdc_channel, ch1val, ch2val);
+    parser_send_adc24_frame(&ble_channel, ch1val, ch2val);
+}
+
+const ADC24_CONSUMER_T adc24_consumers[] = {{ trigger_adc24_wanted, trigger_adc24_frame }, 
+                                            { lockin_adc24_wanted, lockin_adc24_frame }, 
+                                            { pulse_adc24_wanted, pulse_adc24_frame }, 
+                                            { stats_adc24_wanted, stats_adc24_frame }, 
+                                            { hist_adc24_wanted, hist_adc24_frame }, 
+                                            { fft_adc24_wanted, fft_adc24_frame }, 
+                                            { parser_stream_wanted, parser_stream_frame }};
+
+#define ADC24_CONSUMERS         sizeof(adc24_consumers) / sizeof(ADC24_CONSUMER_T)
+
+void parser_stream_service(void) {
+    int32_t ch1val, ch2val;
+    uint16_t i;
+
+    for (i = 0; i < ADC24_CONSUMERS; i++) {
+        if (adc24_consumers[i].wanted())
+            break;
+    }
+    if (i == ADC24_CONSUMERS)
+        return;
+
+    PERF_BEGIN(PERF_STREAM);
+    if (adc24_poll(&ch1val, &ch2val)) {
+        trace_log(TRACE_ADC24_FRAME, cdc_channel.adc24_stream ? cdc_channel.adc24_stream_seq : ble_channel.adc24_stream_seq);
+        for (i = 0; i < ADC24_CONSUMERS; i++) {
+            if (adc24_consumers[i].wanted())
+                adc24_consumers[i].frame(ch1val, ch2val);
+        }
+    }
+    PERF_END(PERF_STREAM);
+}
+
+// Parser public methods
+void init_parser(void) {
+    parser_reset_channel(&cdc_channel);
+    cdc_channel.in_waiting = cdc_in_waiting;
+    cdc_channel.getch = cdc_getc;
+    cdc_channel.putch = cdc_putc;
+    cdc_channel.putstr = cdc_puts;
+    cdc_channel.tx_space = cdc_tx_buffer_space;
+    cdc_channel.task = (STATE_HANDLER_T)NULL;
+    cdc_channel.adc24_stream = FALSE;
+    cdc_channel.adc24_stream_seq = 0;
+    cdc_channel.block_handler = (PARSER_BLOCK_HANDLER_T)NULL;
+
+    parser_reset_channel(&ble_channel);
+    ble_channel.in_waiting = ble_in_waiting;
+    ble_channel.getch = ble_getc;
+    ble_channel.putch = ble_putc;
+    ble_channel.putstr = ble_puts;
+    ble_channel.tx_space = ble_tx_buffer_space;
+    ble_channel.task = (STATE_HANDLER_T)NULL;
+    ble_channel.adc24_stream = FALSE;
+    ble_channel.adc24_stream_seq = 0;
+    ble_channel.block_handler = (PARSER_BLOCK_HANDLER_T)NULL;
+
+    block_buffer_owner = (PARSER_CHANNEL_T *)NULL;
+
+    parser_channel = &cdc_channel;
+
+    parser_state = parser_disconnected;
+    parser_last_state = (STATE_HANDLER_T)NULL;
+}
+
+void parser_disconnected(void) {
+    if (parser_state != parser_last_state) {
+        parser_last_state = parser_state;
+
+        parser_reset_channel(&ble_channel);
+    }
+
+    parser_run_tasks();
+    parser_stream_service();
+    trigger_service();
+    pulse_service();
+    hist_service();
+    fft_service();
+
+    if (parser_receive(&ble_channel, TRUE) == PARSER_RX_STATUS) {
+        if (str_cmp(ble_channel.cmd_buffer, "%STREAM_OPEN%") == 0)
+            parser_state = parser_connected;
+    }
+
+    if (parser_receive(&cdc_channel, FALSE) == PARSER_RX_COMMAND)
+        parser_dispatch(&cdc_channel);
+}
+
+void parser_connected(void) {
+    if (parser_state != parser_last_state) {
+        parser_last_state = parser_state;
+
+        LED1 = ON;
+
+        parser_reset_channel(&ble_channel);
+    }
+
+    parser_run_tasks();
+    parser_stream_service();
+    trigger_service();
+    pulse_service();
+    hist_service();
+    fft_service();
+
+    switch (parser_receive(&ble_channel, TRUE)) {
+        case PARSER_RX_STATUS:
+            if (str_cmp(ble_channel.cmd_buffer, "%DISCONNECT%") == 0)
+                parser_state = parser_disconnected;
+            break;
+        case PARSER_RX_COMMAND:
+            parser_dispatch(&ble_channel);
+            break;
+    }
+
+    if (parser_receive(&cdc_channel, FALSE) == PARSER_RX_COMMAND)
+        parser_dispatch(&cdc_channel);
+
+    if (parser_state != parser_last_state) {
+        parser_close_channel(&ble_channel);
+        LED1 = OFF;
+    }
+}
+
+void parser_forwarding(void) {
+    uint8_t ch;
+    uint16_t i;
+
+    if (parser_state != parser_last_state) {
+        parser_last_state = parser_state;
+        end_fwd_char_count = 0;
+        LED2 = ON;
+
+        // The CDC link carries the forwarded BLE traffic for now, so it 
+        // cannot also carry its own background output.
+        parser_close_channel(&cdc_channel);
+    }
 
     if (cdc_in_waiting() > 0) {
         ch = cdc_getc();
@@ -1942,7 +4555,7 @@ void parser_forwarding(void) {
     }
 
     if (parser_state != parser_last_state) {
-        parser_task = (STATE_HANDLER_T)NULL;
+        parser_reset_channel(&cdc_channel);
         LED2 = OFF;
     }
 }
@@ -5,24 +5,126 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define CMD_BUFFER_LENGTH   128
+
+// Return values of parser_receive()
+#define PARSER_RX_NONE      0
+#define PARSER_RX_COMMAND   1
+#define PARSER_RX_STATUS    2
+
+// ADC24 stream frame: a sync byte, a sequence number, and two 24-bit
+// offset-corrected samples (CH1 then CH2), each sent least-significant byte
+// first
+#define ADC24_STREAM_SYNC   0xA5
+#define ADC24_STREAM_FRAME_LENGTH   8
+
+// With ADC24:STREAM TIME, each frame instead starts with ADC24_STREAM_TIME_SYNC
+// and carries the 32-bit Timer2/3 time at which DRDY was seen to fall 
+// (least-significant byte first) between the sequence number and the samples
+#define ADC24_STREAM_TIME_SYNC  0xA6
+#define ADC24_STREAM_TIME_FRAME_LENGTH  12
+
+// Values of a channel's adc24_stream
+#define ADC24_STREAM_OFF    0
+#define ADC24_STREAM_ON     1
+#define ADC24_STREAM_TIME   2
+
+// Binary blocks carry payloads that would be too slow or too long to send as
+// ASCII hex.  A block is a '#', a 16-bit payload length, the payload, and the 
+// CRC-32 of the payload (as computed by zlib.crc32), with the length and CRC 
+// sent least-significant byte first.
+#define BLOCK_START         '#'
+#define BLOCK_BUFFER_LENGTH 256
+
+// Status codes replied to a host after it sends a binary block
+#define BLOCK_OK            0
+#define BLOCK_ERR_CRC       1
+#define BLOCK_ERR_LENGTH    2
+#define BLOCK_ERR_BUSY      3
+#define BLOCK_ERR_FORMAT    4
+#define BLOCK_ERR_ADDRESS   5
+
+// A spin-wait that times out during a command (see delay.h) leaves the value 
+// it was waiting for stale, so the next string that the command replies 
+// with is preceded by TIMEOUT_MARK, which no hex value or word starts with.  
+// Binary blocks are not marked.
+#define TIMEOUT_MARK        '!'
+
 typedef void (*STATE_HANDLER_T)(void);
 
-extern STATE_HANDLER_T parser_state, parser_last_state, parser_task;
+extern STATE_HANDLER_T parser_state, parser_last_state;
 
 typedef void (*PARSER_HANDLER_T)(char *args);
 
+// Dispatch tables are declared const, so that xc16 keeps them in program 
+// memory (read through the PSV window) rather than in data RAM
 typedef struct {
     char *command;
     PARSER_HANDLER_T handler;
 } DISPATCH_ENTRY_T;
 
+// Each user of the ADC24 frames read by parser_stream_service() is listed in
+// its consumer table, with a function returning 1 while it wants frames and
+// one taking each frame read meanwhile; the ADS1292 is polled only while at
+// least one of them wants frames
+typedef uint16_t (*PARSER_ADC24_WANTED_T)(void);
+typedef void (*PARSER_ADC24_FRAME_T)(int32_t ch1val, int32_t ch2val);
+
+typedef struct {
+    PARSER_ADC24_WANTED_T wanted;
+    PARSER_ADC24_FRAME_T frame;
+} ADC24_CONSUMER_T;
+
+typedef uint16_t (*PARSER_IN_WAITING_T)(void);
+typedef uint8_t (*PARSER_GETC_T)(void);
 typedef void (*PARSER_PUTC_T)(uint8_t ch);
 typedef void (*PARSER_PUTS_T)(uint8_t *str);
+typedef uint16_t (*PARSER_TX_SPACE_T)(void);
+typedef void (*PARSER_BLOCK_HANDLER_T)(uint8_t *data, uint16_t length);
+
+// Each host transport (CDC and BLE) has its own command context, consisting
+// of a command buffer, the functions used to read commands from and to send
+// replies to that transport, a background task, and its stream
+// subscriptions, so that commands from both hosts can be served without one
+// misrouting the other's replies.
+typedef struct {
+    char cmd_buffer[CMD_BUFFER_LENGTH];
+    char *cmd_buffer_pos;
+    uint16_t cmd_buffer_left;
+    PARSER_IN_WAITING_T in_waiting;
+    PARSER_GETC_T getch;
+    PARSER_PUTC_T putch;
+    PARSER_PUTS_T putstr;
+    PARSER_TX_SPACE_T tx_space;
+    STATE_HANDLER_T task;
+    uint16_t adc24_stream;
+    uint8_t adc24_stream_seq;
+    PARSER_BLOCK_HANDLER_T block_handler;
+    uint16_t block_count;
+    uint16_t block_length;
+    uint16_t block_status;
+    uint32_t block_crc;
+} PARSER_CHANNEL_T;
 
-extern PARSER_PUTC_T parser_putc;
-extern PARSER_PUTS_T parser_puts;
+extern PARSER_CHANNEL_T cdc_channel, ble_channel, *parser_channel;
+
+extern uint8_t block_buffer[];
 
 void init_parser(void);
+void parser_putc(uint8_t ch);
+void parser_puts(uint8_t *str);
+void parser_dispatch(PARSER_CHANNEL_T *channel);
+void parser_send_adc24_frame(PARSER_CHANNEL_T *channel, int32_t ch1val, int32_t ch2val);
 
-#endif
+void hex2str_alt(uint16_t num, char *str);
+int16_t str_cmp(char *str1, char *str2);
+char *str_tok_r(char *str, char *delim, char **save_str);
 
+uint32_t crc32_update(uint32_t crc, uint8_t ch);
+void parser_block_begin(uint16_t length);
+void parser_block_putc(uint8_t ch);
+void parser_block_end(void);
+int16_t parser_block_receive(PARSER_BLOCK_HANDLER_T handler);
+void parser_reply_status(uint16_t status);
+
+#endif
@@ -0,0 +1,157 @@
+#include "patgen.h"
+#include "smu_base.h"
+#include "pulse.h"
+
+uint16_t patgen_vectors[PATGEN_LENGTH];
+uint16_t patgen_length, patgen_count, patgen_mask;
+uint16_t patgen_trigger, patgen_edge;
+volatile uint16_t patgen_state;
+uint32_t patgen_period;
+
+// Timer1 settings for patgen_period, and the state of a run
+uint16_t patgen_tckps, patgen_pr;
+uint16_t patgen_index, patgen_pass, patgen_level;
+uint16_t patgen_latd_mask, patgen_late_mask;
+
+void init_patgen(void) {
+    uint16_t i;
+
+    T1CON = 0x0000;         // Timer1 off, TCS = 0 (FCY)
+    IEC0bits.T1IE = 0;
+    IPC0bits.T1IP = 5;      // above the UART1 interrupts
+
+    for (i = 0; i < PATGEN_LENGTH; i++)
+        patgen_vectors[i] = 0;
+    patgen_length = 0;
+    patgen_count = 1;
+    patgen_mask = PATGEN_MASK_ALL;
+    patgen_trigger = PATGEN_TRIGGER_NONE;
+    patgen_edge = PATGEN_RISING;
+    patgen_state = PATGEN_IDLE;
+    patgen_set_period(16 * TIMER_TICKS_PER_US);
+}
+
+// Sets the time between vectors to the nearest that Timer1 can give to the 
+// specified number of instruction cycles and returns the period set.  Takes 
+// effect at the next patgen_start().
+uint32_t patgen_set_period(uint32_t cycles) {
+    if (cycles < PATGEN_PERIOD_MIN)
+        cycles = PATGEN_PERIOD_MIN;
+    patgen_period = timer_period(cycles, &patgen_tckps, &patgen_pr);
+    return patgen_period;
+}
+
+// Selects the trigger input (a vector bit number for a header pin,
+// PATGEN_TRIGGER_SW1, or PATGEN_TRIGGER_NONE to start at once) and the
+// edge on which to start.  SW1 reads low while pressed, so pressing it is a
+// falling edge.  Ignored unless the generator is idle.
+void patgen_set_trigger(uint16_t source, uint16_t edge) {
+    if (patgen_state != PATGEN_IDLE)
+        return;
+
+    if ((source == PATGEN_TRIGGER_NONE) || (source == PATGEN_TRIGGER_SW1) ||
+        ((source < 16) && ((1 << source) & PATGEN_MASK_ALL))) {
+        patgen_trigger = source;
+        patgen_edge = edge ? PATGEN_RISING : PATGEN_FALLING;
+    }
+}
+
+uint16_t patgen_trigger_level(void) {
+    if (patgen_trigger == PATGEN_TRIGGER_SW1)
+        return SW1 ? 1 : 0;
+    else if (patgen_trigger < 8)
+        return (PORTD >> patgen_trigger) & 1;
+    else
+        return (PORTE >> (patgen_trigger - 8)) & 1;
+}
+
+// Stops Timer1 and gives a header pin used as the trigger back to DIGOUT as
+// an output; called from the ISR at the end of the last pass as well
+void patgen_stop(void) {
+    T1CON = 0x0000;
+    IEC0bits.T1IE = 0;
+    IFS0bits.T1IF = 0;
+
+    if (patgen_trigger < 8)
+        TRISD &= ~(1 << patgen_trigger);
+    else if (patgen_trigger < 16)
+        TRISE &= ~(1 << (patgen_trigger - 8));
+
+    patgen_state = PATGEN_IDLE;
+}
+
+void patgen_start(void) {
+    uint16_t mask;
+
+    patgen_stop();
+    pulse_stop();
+    if (patgen_length == 0)
+        return;
+
+    mask = patgen_mask & PATGEN_MASK_ALL;
+    if (patgen_trigger < 8) {
+        TRISD |= 1 << patgen_trigger;
+        mask &= ~(1 << patgen_trigger);
+    } else if (patgen_trigger < 16) {
+        TRISE |= 1 << (patgen_trigger - 8);
+        mask &= ~(1 << patgen_trigger);
+    }
+    patgen_latd_mask = mask & 0x7F;
+    patgen_late_mask = mask >> 8;
+
+    patgen_index = 0;
+    patgen_pass = 0;
+    if (patgen_trigger == PATGEN_TRIGGER_NONE)
+        patgen_state = PATGEN_RUNNING;
+    else {
+        patgen_level = patgen_trigger_level();
+        patgen_state = PATGEN_ARMED;
+    }
+
+    TMR1 = 0;
+    PR1 = patgen_pr;
+    IFS0bits.T1IF = 0;
+    IEC0bits.T1IE = 1;
+    T1CON = 0x8000 | (patgen_tckps << 4);   // TON = 1, TCKPS = prescaler
+}
+
+// Writes the next vector each period of Timer1, or while armed, watches the
+// trigger input for the selected edge (so the first vector goes out within
+// one period of the edge).  Timer1 times the pulse generator instead while
+// it runs.
+void __attribute__((interrupt, auto_psv)) _T1Interrupt(void) {
+    uint16_t vector, level;
+
+    IFS0bits.T1IF = 0;              // lower Timer1 interrupt flag
+
+    if (pulse_state != PULSE_IDLE) {
+        pulse_timer();
+        return;
+    }
+
+    if (patgen_state == PATGEN_ARMED) {
+        level = patgen_trigger_level();
+        if ((level == patgen_level) || (level != patgen_edge)) {
+            patgen_level = level;
+            return;
+        }
+        patgen_state = PATGEN_RUNNING;
+    }
+
+    vector = patgen_vectors[patgen_index];
+    LATD = (LATD & ~patgen_latd_mask) | (vector & patgen_latd_mask);
+    LATE = (LATE & ~patgen_late_mask) | ((vector >> 8) & patgen_late_mask);
+
+    if ((patgen_index == 0) && (patgen_pass == 0))
+        timer_stamp(TIMER_STAMP_DIGOUT);
+
+    patgen_index++;
+    if (patgen_index == patgen_length) {
+        patgen_index = 0;
+        if (patgen_count) {
+            patgen_pass++;
+            if (patgen_pass == patgen_count)
+                patgen_stop();
+        }
+    }
+}
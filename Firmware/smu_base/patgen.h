@@ -0,0 +1,40 @@
+#ifndef _PATGEN_H_
+#define _PATGEN_H_
+
+#include <stdint.h>
+
+// Digital pattern generator: the Timer1 ISR writes one vector per period
+// onto the pins of the digital header selected by patgen_mask (bits 0 to 6
+// for RD0 to RD6 and 8 to 14 for RE0 to RE6), patgen_count times or until
+// stopped, starting at once or at an edge of a trigger input.
+#define PATGEN_LENGTH       256
+#define PATGEN_MASK_ALL     0x7F7F
+
+// Shortest period in instruction cycles (20 us).  The ISR, with its entry 
+// and exit, takes about 60 cycles, so this leaves the main loop at least 
+// 80% of the CPU to keep the USB link and the command parser serviced.
+#define PATGEN_PERIOD_MIN   320
+
+#define PATGEN_TRIGGER_SW1  0x10
+#define PATGEN_TRIGGER_NONE 0xFFFF
+
+#define PATGEN_FALLING      0
+#define PATGEN_RISING       1
+
+#define PATGEN_IDLE         0
+#define PATGEN_ARMED        1
+#define PATGEN_RUNNING      2
+
+extern uint16_t patgen_vectors[PATGEN_LENGTH];
+extern uint16_t patgen_length, patgen_count, patgen_mask;
+extern uint16_t patgen_trigger, patgen_edge;
+extern volatile uint16_t patgen_state;
+extern uint32_t patgen_period;
+
+void init_patgen(void);
+uint32_t patgen_set_period(uint32_t cycles);
+void patgen_set_trigger(uint16_t source, uint16_t edge);
+void patgen_start(void);
+void patgen_stop(void);
+
+#endif
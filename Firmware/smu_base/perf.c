@@ -0,0 +1,55 @@
+#include "perf.h"
+#include "smu_base.h"
+
+PERF_PROBE_T perf_probes[PERF_PROBES];
+uint16_t perf_hist[PERF_HIST_BINS];
+
+uint32_t perf_loop_start;
+uint16_t perf_loop_started;
+
+void perf_reset(void) {
+    uint16_t i;
+
+    for (i = 0; i < PERF_PROBES; i++) {
+        perf_probes[i].count = 0;
+        perf_probes[i].total = 0;
+        perf_probes[i].min = 0xFFFFFFFF;
+        perf_probes[i].max = 0;
+    }
+
+    for (i = 0; i < PERF_HIST_BINS; i++)
+        perf_hist[i] = 0;
+
+    perf_loop_started = FALSE;
+}
+
+void perf_end(uint16_t probe, uint32_t start) {
+    PERF_PROBE_T *p;
+    uint32_t cycles;
+
+    p = &perf_probes[probe];
+    cycles = tmr23_read() - start;
+    p->count++;
+    p->total += cycles;
+    if (cycles < p->min)
+        p->min = cycles;
+    if (cycles > p->max)
+        p->max = cycles;
+}
+
+// Called once at the top of each pass through the main loop
+void perf_loop(void) {
+    uint32_t now, cycles;
+    uint16_t bin;
+
+    now = tmr23_read();
+    if (perf_loop_started) {
+        cycles = now - perf_loop_start;
+        for (bin = 0; (cycles > 1) && (bin < PERF_HIST_BINS - 1); bin++)
+            cycles >>= 1;
+        if (perf_hist[bin] != 0xFFFF)
+            perf_hist[bin]++;
+    }
+    perf_loop_start = now;
+    perf_loop_started = TRUE;
+}
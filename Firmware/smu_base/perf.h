@@ -0,0 +1,57 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdint.h>
+#include "hal.h"
+
+// The profiling probes are compiled into the firmware only when PERF is
+// defined, as by building with scons perf=1; otherwise they cost nothing and
+// PERF? replies with zero counts
+
+// Profiling probes: each accumulates the number of times the code between 
+// its PERF_BEGIN() and PERF_END() ran and the total, minimum, and maximum 
+// number of instruction cycles it took, as measured with the Timer2/3 
+// timebase.  PERF_BEGIN() keeps the start time in a local variable, so each 
+// probe's PERF_END() must be in the same block as its PERF_BEGIN().  Probes 
+// are not for use in ISRs.
+#define PERF_USB_SERVICE    0   // usb_service() in the main loop
+#define PERF_PARSER_STATE   1   // one pass through the parser's state
+#define PERF_DISPATCH       2   // command handlers
+#define PERF_STREAM         3   // ADC24 stream service
+#define PERF_WAIT_DRDY      4   // waiting for ADS1292 DRDY
+#define PERF_WAIT_SPI1      5   // waiting for an SPI1 (DAC16) exchange
+#define PERF_WAIT_SPI2      6   // waiting for an SPI2 (ADC24) exchange
+#define PERF_WAIT_SDADC     7   // waiting for a sigma-delta ADC result
+#define PERF_WAIT_NVM       8   // waiting for a flash erase or write
+#define PERF_PROBES         9
+
+// Main loop iterations are binned by duration into a histogram whose bin n 
+// counts iterations taking 2^n to 2^(n + 1) - 1 cycles (bin 0 also counts 
+// iterations of 0 cycles, and the last bin all longer ones)
+#define PERF_HIST_BINS      24
+
+typedef struct {
+    uint32_t count;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+} PERF_PROBE_T;
+
+extern PERF_PROBE_T perf_probes[PERF_PROBES];
+extern uint16_t perf_hist[PERF_HIST_BINS];
+
+void perf_reset(void);
+void perf_end(uint16_t probe, uint32_t start);
+void perf_loop(void);
+
+#ifdef PERF
+#define PERF_BEGIN(probe)   uint32_t perf_start_##probe = tmr23_read()
+#define PERF_END(probe)     perf_end(probe, perf_start_##probe)
+#define PERF_LOOP()         perf_loop()
+#else
+#define PERF_BEGIN(probe)
+#define PERF_END(probe)
+#define PERF_LOOP()
+#endif
+
+#endif
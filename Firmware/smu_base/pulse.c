@@ -0,0 +1,199 @@
+#include "pulse.h"
+#include "smu_base.h"
+#include "patgen.h"
+#include "lockin.h"
+
+PULSE_RESULT_T pulse_ring[PULSE_LENGTH];
+uint16_t pulse_dac, pulse_base, pulse_level;
+uint32_t pulse_period, pulse_width, pulse_delay;
+uint16_t pulse_frames, pulse_count;
+volatile uint16_t pulse_state;
+volatile uint16_t pulse_pulses, pulse_results, pulse_missed;
+
+// Timer1 settings for the intervals from the start of a pulse to its
+// capture window, from there to its end, and from its end to the start of
+// the next one, and the state of a run: the part of the pulse under way,
+// and the frames taken in its capture window and their sums
+#define PULSE_PHASE_ON      0
+#define PULSE_PHASE_CAPTURE 1
+#define PULSE_PHASE_OFF     2
+
+uint16_t pulse_tckps, pulse_pr_delay, pulse_pr_capture, pulse_pr_off;
+volatile uint16_t pulse_phase;
+uint16_t pulse_taken;
+int32_t pulse_sum1, pulse_sum2;
+
+// Set by the Timer1 ISR once it has stopped Timer1 after the last pulse
+volatile uint16_t pulse_done;
+
+void init_pulse(void) {
+    pulse_dac = 1;
+    pulse_base = 0x8000;
+    pulse_level = 0x9000;
+    pulse_frames = 1;
+    pulse_count = 1;
+    pulse_pulses = 0;
+    pulse_results = 0;
+    pulse_missed = 0;
+    pulse_state = PULSE_IDLE;
+    pulse_done = FALSE;
+    pulse_set_timing(10000L * TIMER_TICKS_PER_US, 5000L * TIMER_TICKS_PER_US, 0);
+}
+
+// Sets the period, the width, and the delay to the capture window of the
+// pulses, in instruction cycles, if they fit in one another with at least
+// PULSE_INTERVAL_MIN between events (a delay of 0 opens the capture window
+// at the start of each pulse); returns 0 if so, or 1 if not
+uint16_t pulse_set_timing(uint32_t period, uint32_t width, uint32_t delay) {
+    if ((period > 0x1000000) || (width + PULSE_INTERVAL_MIN > period) ||
+        (delay + PULSE_INTERVAL_MIN > width) ||
+        (delay && (delay < PULSE_INTERVAL_MIN)))
+        return 1;
+    pulse_period = period;
+    pulse_width = width;
+    pulse_delay = delay;
+    return 0;
+}
+
+// Returns the Timer1 period register value for an interval of the specified
+// number of instruction cycles with the prescaler selected by pulse_tckps
+uint16_t pulse_pr(uint32_t cycles) {
+    static const uint16_t shifts[4] = { 0, 3, 6, 8 };
+    uint32_t count;
+
+    count = (cycles + ((1 << shifts[pulse_tckps]) >> 1)) >> shifts[pulse_tckps];
+    if (count == 0)
+        count = 1;
+    if (count > 0x10000)
+        count = 0x10000;
+    return (uint16_t)(count - 1);
+}
+
+// Starts a pulse, opening its capture window at once if pulse_delay is 0;
+// returns the Timer1 period register value for the interval to the next
+// event
+uint16_t pulse_begin(void) {
+    dac16_set(pulse_dac, pulse_level);
+    pulse_taken = 0;
+    pulse_sum1 = 0;
+    pulse_sum2 = 0;
+    if (pulse_delay == 0) {
+        adc24_set_start(1);
+        pulse_phase = PULSE_PHASE_CAPTURE;
+        return pulse_pr_capture;
+    }
+    pulse_phase = PULSE_PHASE_ON;
+    return pulse_pr_delay;
+}
+
+void pulse_start(void) {
+    uint16_t pr;
+
+    pulse_stop();
+    patgen_stop();
+    lockin_stop();
+
+    timer_period(pulse_period, &pulse_tckps, &pr);
+    pulse_pr_delay = pulse_pr(pulse_delay);
+    pulse_pr_capture = pulse_pr(pulse_width - pulse_delay);
+    pulse_pr_off = pulse_pr(pulse_period - pulse_width);
+
+    pulse_pulses = 0;
+    pulse_results = 0;
+    pulse_missed = 0;
+    pulse_done = FALSE;
+    pulse_state = PULSE_RUNNING;
+
+    adc24_start();
+    adc24_set_start(0);
+
+    TMR1 = 0;
+    PR1 = pulse_begin();
+    IFS0bits.T1IF = 0;
+    IEC0bits.T1IE = 1;
+    T1CON = 0x8000 | (pulse_tckps << 4);    // TON = 1, TCKPS = prescaler
+}
+
+// Stops Timer1, returns the DAC16 output to the base level, and hands the
+// ADS1292's START back to the other users of the ADC24; called from the main
+// loop only, by pulse_service() after the last pulse as well
+void pulse_stop(void) {
+    if (pulse_state == PULSE_IDLE)
+        return;
+
+    T1CON = 0x0000;
+    IEC0bits.T1IE = 0;
+    IFS0bits.T1IF = 0;
+    pulse_done = FALSE;
+    pulse_state = PULSE_IDLE;
+
+    dac16_set(pulse_dac, pulse_base);
+    adc24_set_start((adc24_run_count > 1) ? 1 : 0);
+    adc24_stop();
+}
+
+// Ends the run once the Timer1 ISR has finished the last pulse; call from 
+// the main loop
+void pulse_service(void) {
+    if ((pulse_state != PULSE_IDLE) && pulse_done)
+        pulse_stop();
+}
+
+// Steps through the parts of each pulse, called from the Timer1 ISR while
+// the pulse generator runs; leaves the end of the run to pulse_service()
+void pulse_timer(void) {
+    uint16_t tail;
+
+    switch (pulse_phase) {
+        case PULSE_PHASE_ON:
+            adc24_set_start(1);
+            pulse_phase = PULSE_PHASE_CAPTURE;
+            PR1 = pulse_pr_capture;
+            break;
+        case PULSE_PHASE_CAPTURE:
+            adc24_set_start(0);
+            dac16_set(pulse_dac, pulse_base);
+            if (pulse_taken) {
+                tail = pulse_results & (PULSE_LENGTH - 1);
+                pulse_ring[tail].ch1 = pulse_sum1 / (int16_t)pulse_taken;
+                pulse_ring[tail].ch2 = pulse_sum2 / (int16_t)pulse_taken;
+                pulse_results++;
+            } else
+                pulse_missed++;
+            pulse_pulses++;
+            if (pulse_count && (pulse_pulses == pulse_count)) {
+                T1CON = 0x0000;
+                IEC0bits.T1IE = 0;
+                pulse_done = TRUE;
+                return;
+            }
+            pulse_phase = PULSE_PHASE_OFF;
+            PR1 = pulse_pr_off;
+            break;
+        default:
+            PR1 = pulse_begin();
+    }
+}
+
+// Returns 1 while the pulse generator runs
+uint16_t pulse_adc24_wanted(void) {
+    return (pulse_state == PULSE_IDLE) ? 0 : 1;
+}
+
+// Takes each ADC24 frame read while the pulse generator runs, adding the
+// first pulse_frames of each capture window to the pulse's sums
+void pulse_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    uint16_t enabled;
+
+    if (pulse_state == PULSE_IDLE)
+        return;
+
+    enabled = IEC0bits.T1IE;
+    IEC0bits.T1IE = 0;
+    if ((pulse_phase == PULSE_PHASE_CAPTURE) && (pulse_taken < pulse_frames)) {
+        pulse_sum1 += ch1val;
+        pulse_sum2 += ch2val;
+        pulse_taken++;
+    }
+    IEC0bits.T1IE = enabled;
+}
@@ -0,0 +1,44 @@
+#ifndef _PULSE_H_
+#define _PULSE_H_
+
+#include <stdint.h>
+
+// Pulsed source-measure: Timer1 steps a DAC16 output from pulse_base to
+// pulse_level for pulse_width of every pulse_period cycles and raises the
+// ADS1292's START pulse_delay cycles into each pulse; the first
+// pulse_frames frames of that window are averaged into a result.
+#define PULSE_LENGTH        16      // a power of 2
+
+// Most frames averaged into a result, keeping the sums within 32 bits
+#define PULSE_FRAMES_MAX    128
+
+// Shortest interval between Timer1 interrupts
+#define PULSE_INTERVAL_MIN  (20 * TIMER_TICKS_PER_US)
+
+#define PULSE_IDLE          0
+#define PULSE_RUNNING       1
+
+#define PULSE_RESULT_LENGTH 6       // CH1 and CH2 averages, 3 bytes each
+
+typedef struct {
+    int32_t ch1;
+    int32_t ch2;
+} PULSE_RESULT_T;
+
+extern PULSE_RESULT_T pulse_ring[PULSE_LENGTH];
+extern uint16_t pulse_dac, pulse_base, pulse_level;
+extern uint32_t pulse_period, pulse_width, pulse_delay;
+extern uint16_t pulse_frames, pulse_count;
+extern volatile uint16_t pulse_state;
+extern volatile uint16_t pulse_pulses, pulse_results, pulse_missed;
+
+void init_pulse(void);
+uint16_t pulse_set_timing(uint32_t period, uint32_t width, uint32_t delay);
+void pulse_start(void);
+void pulse_stop(void);
+void pulse_service(void);
+void pulse_timer(void);
+uint16_t pulse_adc24_wanted(void);
+void pulse_adc24_frame(int32_t ch1val, int32_t ch2val);
+
+#endif
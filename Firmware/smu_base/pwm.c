@@ -0,0 +1,147 @@
+#include "pwm.h"
+#include "smu_base.h"
+#include "sync.h"
+
+// OCxCON1: OCTSEL = 010 (Timer4 clock), OCM = 110 (edge-aligned PWM);
+// OCxCON2: SYNCSEL = 11111 (each module is its own sync source, so that
+// its timer restarts when it matches OCxRS)
+#define PWM_OCCON1          0x0806
+#define PWM_OCCON2          0x001F
+
+typedef struct {
+    volatile uint16_t *con1;
+    volatile uint16_t *con2;
+    volatile uint16_t *r;
+    volatile uint16_t *rs;
+    volatile uint16_t *tmr;
+} PWM_OC_T;
+
+PWM_OC_T pwm_oc[PWM_CHANNELS] = {{ &OC2CON1, &OC2CON2, &OC2R, &OC2RS, &OC2TMR },
+                                 { &OC3CON1, &OC3CON2, &OC3R, &OC3RS, &OC3TMR },
+                                 { &OC4CON1, &OC4CON2, &OC4R, &OC4RS, &OC4TMR },
+                                 { &OC5CON1, &OC5CON2, &OC5R, &OC5RS, &OC5TMR },
+                                 { &OC6CON1, &OC6CON2, &OC6R, &OC6RS, &OC6TMR },
+                                 { &OC7CON1, &OC7CON2, &OC7R, &OC7RS, &OC7TMR }};
+
+const uint8_t pwm_pin_rp[PWM_PINS] = { RD0_RP, RD1_RP, RD2_RP, RD3_RP, RD4_RP, RD5_RP };
+
+uint16_t pwm_period[PWM_CHANNELS], pwm_duty[PWM_CHANNELS];
+uint16_t pwm_phase[PWM_CHANNELS], pwm_pin[PWM_CHANNELS];
+uint16_t pwm_running;
+
+void init_pwm(void) {
+    uint16_t i;
+
+    T4CON = 0x0000;         // Timer4 off, TCKPS = 00 (1:1 prescale),
+    TMR4 = 0;               //   TCS = 0 (FCY)
+    PR4 = 0xFFFF;
+
+    for (i = 0; i < PWM_CHANNELS; i++) {
+        *pwm_oc[i].con1 = 0;
+        pwm_period[i] = 0xFFFF;
+        pwm_duty[i] = 0x8000;
+        pwm_phase[i] = 0;
+        pwm_pin[i] = PWM_PIN_NONE;
+    }
+    pwm_running = 0;
+}
+
+// Returns the channels that are mapped onto pins, as a mask for pwm_start()
+uint16_t pwm_mapped(void) {
+    uint16_t mask, i;
+
+    mask = 0;
+    for (i = 0; i < PWM_CHANNELS; i++)
+        if (pwm_pin[i] != PWM_PIN_NONE)
+            mask |= 1 << i;
+    return mask;
+}
+
+// Sets the period, high time, and phase of a channel in instruction cycles.
+// A high time of 0 holds the output low and one of at least the period
+// holds it high.  The period and high time of a running channel change
+// right away; its phase changes at the next pwm_start().
+void pwm_set(uint16_t ch, uint16_t period, uint16_t duty, uint16_t phase) {
+    if (ch >= PWM_CHANNELS)
+        return;
+
+    if (period < PWM_PERIOD_MIN)
+        period = PWM_PERIOD_MIN;
+    if (duty > period)
+        duty = period;
+    pwm_period[ch] = period;
+    pwm_duty[ch] = duty;
+    pwm_phase[ch] = phase % period;
+
+    if (pwm_running & (1 << ch)) {
+        *pwm_oc[ch].rs = period - 1;
+        *pwm_oc[ch].r = duty;
+    }
+}
+
+// Maps a channel's output onto a header pin (0 to 5 for RD0 to RD5), taking
+// the pin from any other channel mapped onto it, or with PWM_PIN_NONE,
+// returns the channel's pin to its DIGOUT latch
+void pwm_assign(uint16_t ch, uint16_t pin) {
+    uint8_t *RPOR;
+    uint16_t i;
+
+    if ((ch >= PWM_CHANNELS) || ((pin >= PWM_PINS) && (pin != PWM_PIN_NONE)))
+        return;
+
+    RPOR = (uint8_t *)&RPOR0;
+
+    __builtin_write_OSCCONL(OSCCON & 0xBF);
+    if (pwm_pin[ch] != PWM_PIN_NONE)
+        RPOR[pwm_pin_rp[pwm_pin[ch]]] = 0;
+    if (pin != PWM_PIN_NONE) {
+        for (i = 0; i < PWM_CHANNELS; i++)
+            if (pwm_pin[i] == pin)
+                pwm_pin[i] = PWM_PIN_NONE;
+        RPOR[pwm_pin_rp[pin]] = OC2_RP + ch;
+    }
+    __builtin_write_OSCCONL(OSCCON | 0x40);
+
+    pwm_pin[ch] = pin;
+}
+
+// Starts the channels whose bits are set in mask together, stopping the
+// rest.  Each module's timer is preloaded so that its period begins (and
+// its output rises) phase cycles after the start.
+void pwm_start(uint16_t mask) {
+    uint16_t i;
+
+    if (sync_mode == SYNC_SLAVE)
+        return;
+
+    T4CON = 0x0000;
+    TMR4 = 0;
+    mask &= (1 << PWM_CHANNELS) - 1;
+
+    for (i = 0; i < PWM_CHANNELS; i++) {
+        *pwm_oc[i].con1 = 0;
+        if (mask & (1 << i)) {
+            *pwm_oc[i].con2 = PWM_OCCON2;
+            *pwm_oc[i].rs = pwm_period[i] - 1;
+            *pwm_oc[i].r = pwm_duty[i];
+            *pwm_oc[i].con1 = PWM_OCCON1;
+            *pwm_oc[i].tmr = pwm_phase[i] ? pwm_period[i] - pwm_phase[i] : 0;
+        }
+    }
+
+    pwm_running = mask;
+    if (mask) {
+        T4CON = 0x8000;     // start Timer4, clocking all of the channels
+        timer_stamp(TIMER_STAMP_DIGOUT);
+    }
+}
+
+void pwm_stop(void) {
+    uint16_t i;
+
+    if (sync_mode != SYNC_SLAVE)
+        T4CON = 0x0000;
+    for (i = 0; i < PWM_CHANNELS; i++)
+        *pwm_oc[i].con1 = 0;
+    pwm_running = 0;
+}
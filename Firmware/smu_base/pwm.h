@@ -0,0 +1,28 @@
+#ifndef _PWM_H_
+#define _PWM_H_
+
+#include <stdint.h>
+
+// Hardware PWM on the digital header: OC2 to OC7 run as edge-aligned PWM
+// off Timer4, each with its own period, high time, and phase in cycles, and
+// each mappable onto one of RD0 to RD5.
+#define PWM_CHANNELS        6
+#define PWM_PINS            6
+#define PWM_PIN_NONE        0xFFFF
+
+// Shortest period, giving 8 MHz; the longest, 0xFFFF cycles, gives 244 Hz
+#define PWM_PERIOD_MIN      2
+
+extern const uint8_t pwm_pin_rp[PWM_PINS];
+extern uint16_t pwm_period[PWM_CHANNELS], pwm_duty[PWM_CHANNELS];
+extern uint16_t pwm_phase[PWM_CHANNELS], pwm_pin[PWM_CHANNELS];
+extern uint16_t pwm_running;
+
+void init_pwm(void);
+void pwm_set(uint16_t ch, uint16_t period, uint16_t duty, uint16_t phase);
+void pwm_assign(uint16_t ch, uint16_t pin);
+uint16_t pwm_mapped(void);
+void pwm_start(uint16_t mask);
+void pwm_stop(void);
+
+#endif
@@ -1,16 +1,33 @@
 #include "smu_base.h"
+#include "hal.h"
+#include "perf.h"
+#include "trace.h"
+#include "delay.h"
+#include "pwm.h"
+#include "patgen.h"
+#include "logic.h"
+#include "trigger.h"
+#include "sync.h"
+#include "lockin.h"
+#include "pulse.h"
+#include "stats.h"
+#include "hist.h"
+#include "fft.h"
+#include "usb.h"
 
 int16_t adc16_offset;
 int32_t adc16_max_val;
 
-uint16_t dac16_dac0, dac16_dac1, dac16_dac2, dac16_dac3;
+uint16_t dac16_vals[DAC16_CHANNELS];
 
 int32_t adc24_ch1offset, adc24_ch2offset;
+uint16_t adc24_run_count;
 
 RINGBUFFER U1TXbuffer, U1RXbuffer;
 uint8_t U1TX_buffer[U1TX_BUFFER_LENGTH];
 uint8_t U1RX_buffer[U1RX_BUFFER_LENGTH];
 uint16_t U1TXthreshold;
+uint32_t timer_stamps[TIMER_STAMPS];
 
 void init_smu_base(void) {
     CLKDIV = 0x0100;        // RCDIV = 001 (4MHz, div2),
@@ -68,10 +85,115 @@ void init_smu_base(void) {
     RE5_DIR = OUT; RE5_ = 0;
     RE6_DIR = OUT; RE6_ = 0;
 
+    init_timer();
+    perf_reset();
+    init_trace();
     init_adc16();
     init_dac16();
     init_adc24();
     init_ble();
+    init_unit_id();
+    init_pwm();
+    init_patgen();
+    init_logic();
+    init_trigger();
+    init_sync();
+    init_lockin();
+    init_pulse();
+    init_stats();
+    init_hist();
+    init_fft();
+}
+
+// Functions for the free-running 32-bit timebase (Timer2/3)
+void init_timer(void) {
+    T2CON = 0x0008;         // T32 = 1 (Timer2/3 form a 32-bit timer), 
+                            // TCKPS = 00 (1:1 prescale), TCS = 0 (FCY)
+    T3CON = 0;
+    TMR3 = 0;
+    TMR2 = 0;
+    PR3 = 0xFFFF;           // count through all 2^32 values, rolling over 
+    PR2 = 0xFFFF;           //   every 268 s
+    IEC0bits.T3IE = 0;      // no Timer3 interrupt
+    T2CONbits.TON = 1;      // start Timer2/3
+}
+
+uint32_t timer_read(void) {
+    return tmr23_read();
+}
+
+void timer_stamp(uint16_t which) {
+    timer_stamps[which] = tmr23_read();
+}
+
+// Finds the Timer1/4/5 settings for a period of the specified number of 
+// instruction cycles: the smallest prescaler (1, 8, 64, or 256, selected by 
+// TCKPS) that reaches it and the nearest period register value for that 
+// prescaler.  Returns the period that they give.
+uint32_t timer_period(uint32_t cycles, uint16_t *tckps, uint16_t *pr) {
+    static const uint16_t prescalers[4] = { 1, 8, 64, 256 };
+    uint32_t count;
+    uint16_t i;
+
+    if (cycles > 0x1000000)
+        cycles = 0x1000000;
+    for (i = 0; i < 3; i++)
+        if ((cycles + prescalers[i] / 2) / prescalers[i] <= 0x10000)
+            break;
+    count = (cycles + prescalers[i] / 2) / prescalers[i];
+    if (count == 0)
+        count = 1;
+    if (count > 0x10000)
+        count = 0x10000;
+
+    *tckps = i;
+    *pr = (uint16_t)(count - 1);
+    return count * prescalers[i];
+}
+
+// Functions for configuring the SPI buses
+// Configures SPI1 or SPI2 (bus = 1 or 2) as a master in the specified SPI 
+// mode (0 to 3) with the fastest SCK frequency that does not exceed freq (in 
+// Hz), choosing among the primary (1, 4, 16, or 64) and secondary (1 to 8) 
+// prescale ratios as config.py's spicon() does, and enables the 8-byte 
+// enhanced buffers; returns the SCK frequency set, or 0 for an invalid bus
+uint32_t spi_config(uint16_t bus, uint32_t freq, uint16_t mode) {
+    static const uint16_t modebits[4] = { 0x0100, 0x0000, 0x0140, 0x0040 };
+    uint16_t primary, secondary, best_primary, best_secondary, con1;
+    uint32_t sck, best_sck;
+
+    best_sck = 0;
+    best_primary = 0;
+    best_secondary = 8;
+    for (primary = 0; primary < 4; primary++) {
+        for (secondary = 1; secondary <= 8; secondary++) {
+            if ((primary == 3) && (secondary == 1))
+                continue;           // 1:1 with 1:1 is not allowed
+            sck = (FCY_HZ >> (6 - 2 * primary)) / secondary;
+            if ((sck <= freq) && (sck > best_sck)) {
+                best_sck = sck;
+                best_primary = primary;
+                best_secondary = secondary;
+            }
+        }
+    }
+    if (best_sck == 0)              // freq is below the slowest SCK, 
+        best_sck = FCY_HZ / 512;    //   so use the slowest
+
+    con1 = 0x0020 | modebits[mode & 0x03] | ((8 - best_secondary) << 2) | best_primary;
+    if (bus == 1) {
+        SPI1STAT = 0;
+        SPI1CON1 = con1;            // MSTEN = 1 (master mode), CKE and CKP 
+        SPI1CON2 = 0x0001;          //   per mode, SPRE and PPRE per freq; 
+        SPI1STAT = 0x8000;          //   SPIBEN = 1 (enhanced buffer); SPIEN = 1
+    } else if (bus == 2) {
+        SPI2STAT = 0;
+        SPI2CON1 = con1;
+        SPI2CON2 = 0x0001;
+        SPI2STAT = 0x8000;
+    } else
+        return 0;
+    return best_sck;
 }
 
 // Functions for measuring with the 16-bit sigma-delta ADC
@@ -111,13 +233,11 @@ void adc16_calibrate(void) {
 
     // Measure sigma-delta ADC internal offset
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
     offset = (int32_t)SD1RESH;
     for (i = 0; i < 15; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
         offset += (int32_t)SD1RESH;
     }
     offset = offset / 16;
@@ -129,8 +249,7 @@ void adc16_calibrate(void) {
     // Measure the sigma-delta ADC positive reference for gain calibration
     SD1CON3bits.SDCH = 3;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
     adc16_max_val = (int32_t)SD1RESH - (int32_t)adc16_offset;
 
@@ -143,9 +262,9 @@ int16_t adc16_meas_ch1_raw(void) {
 
     SD1CON3bits.SDCH = 0;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     return (int16_t)SD1RESH;
 }
 
@@ -154,9 +273,9 @@ int16_t adc16_meas_ch2_raw(void) {
 
     SD1CON3bits.SDCH = 1;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     return (int16_t)SD1RESH;
 }
 
@@ -166,9 +285,9 @@ int16_t adc16_meas_ch1(void) {
 
     SD1CON3bits.SDCH = 0;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     val = (int32_t)SD1RESH - (int32_t)adc16_offset;
 //    val = ((int32_t)32767 * val) / adc16_max_val;
 
@@ -181,9 +300,9 @@ int16_t adc16_meas_ch2(void) {
 
     SD1CON3bits.SDCH = 1;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     val = (int32_t)SD1RESH - (int32_t)adc16_offset;
 //    val = ((int32_t)32767 * val) / adc16_max_val;
 
@@ -196,15 +315,14 @@ int16_t adc16_meas_ch1_avg(void) {
 
     SD1CON3bits.SDCH = 0;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
     val = (int32_t)SD1RESH;
     for (i = 0; i < 15; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
         val += (int32_t)SD1RESH;
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     val = val / 16;
     val -= (int32_t)adc16_offset;
 //    val = ((int32_t)32767 * val) / adc16_max_val;
@@ -218,15 +336,14 @@ int16_t adc16_meas_ch2_avg(void) {
 
     SD1CON3bits.SDCH = 1;
     for (i = 0; i < 5; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
     }
     val = (int32_t)SD1RESH;
     for (i = 0; i < 15; i++) {
-        IFS6bits.SDA1IF = 0;
-        while (IFS6bits.SDA1IF == 0) {}
+        sdadc1_wait();
         val += (int32_t)SD1RESH;
     }
+    timer_stamp(TIMER_STAMP_ADC16);
     val = val / 16;
     val -= (int32_t)adc16_offset;
 //    val = ((int32_t)32767 * val) / adc16_max_val;
@@ -245,6 +362,7 @@ uint16_t adc16_get_max_val(void) {
 // Functions for interfacing with the quad 16-bit DAC (DAC8564)
 void init_dac16(void) {
     uint8_t *RPOR, *RPINR;
+    uint16_t i;
 
     // Configure DAC16 pins and SPI peripheral (SPI1)
     DAC_CSN_DIR = OUT; DAC_CSN = 1;
@@ -261,228 +379,84 @@ void init_dac16(void) {
     RPOR[DAC_SCK_RP] = SCK1OUT_RP;
     __builtin_write_OSCCONL(OSCCON | 0x40);
 
-    SPI1CON1 = 0x017B;      // SPI1 mode = 2, SCK freq = 2 MHz
-    SPI1CON2 = 0;
-    SPI1STAT = 0x8000;
-
-    dac16_dac0 = 0;
-    dac16_dac1 = 0;
-    dac16_dac2 = 0;
-    dac16_dac3 = 0;
-}
-
-uint16_t dac16_get_dac0(void) {
-    return dac16_dac0;
-}
-
-void dac16_set_dac0(uint16_t val) {
-    uint16_t temp;
+    spi_config(1, DAC16_SPI_FREQ, DAC16_SPI_MODE);
 
-    dac16_dac0 = val;
-
-    DAC_CSN = 0;
-
-    // Write to buffer with data and load DAC0
-    SPI1BUF = 0b00010000;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC0 value
-    SPI1BUF = dac16_dac0 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC0 value
-    SPI1BUF = dac16_dac0 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    DAC_CSN = 1;
-}
-
-uint16_t dac16_get_dac1(void) {
-    return dac16_dac1;
+    for (i = 0; i < DAC16_CHANNELS; i++)
+        dac16_vals[i] = 0;
 }
 
-void dac16_set_dac1(uint16_t val) {
-    uint16_t temp;
-
-    dac16_dac1 = val;
-
+// Sends the DAC8564 a 24-bit write: a control byte followed by a 16-bit 
+// value, most-significant byte first
+// The pulse generator writes the DAC16 from the Timer1 ISR, so while it 
+// runs, Timer1 interrupts are held off for each write from elsewhere
+void dac16_write(uint8_t control, uint16_t val) {
+    uint8_t data[3];
+    uint16_t enabled;
+
+    data[0] = control;
+    data[1] = (uint8_t)(val >> 8);
+    data[2] = (uint8_t)val;
+
+    enabled = IEC0bits.T1IE;
+    if (pulse_state != PULSE_IDLE)
+        IEC0bits.T1IE = 0;
     DAC_CSN = 0;
-
-    // Write to buffer with data and load DAC1
-    SPI1BUF = 0b00010010;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC1 value
-    SPI1BUF = dac16_dac1 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC1 value
-    SPI1BUF = dac16_dac1 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
+    spi1_transfer(data, (uint8_t *)NULL, 3);
     DAC_CSN = 1;
+    IEC0bits.T1IE = enabled;
 }
 
-uint16_t dac16_get_dac2(void) {
-    return dac16_dac2;
-}
-
-void dac16_set_dac2(uint16_t val) {
-    uint16_t temp;
-
-    dac16_dac2 = val;
-
-    DAC_CSN = 0;
-
-    // Write to buffer with data and load DAC2
-    SPI1BUF = 0b00010100;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC2 value
-    SPI1BUF = dac16_dac2 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC2 value
-    SPI1BUF = dac16_dac2 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    DAC_CSN = 1;
+uint16_t dac16_get(uint16_t dac) {
+    return dac16_vals[dac & 0x03];
 }
 
-uint16_t dac16_get_dac3(void) {
-    return dac16_dac3;
+// Writes val to the specified DAC's buffer and loads that DAC
+void dac16_set(uint16_t dac, uint16_t val) {
+    dac &= 0x03;
+    dac16_vals[dac] = val;
+    dac16_write(DAC16_LOAD_ONE | (dac << 1), val);
+    timer_stamp(TIMER_STAMP_DAC16);
 }
 
-void dac16_set_dac3(uint16_t val) {
-    uint16_t temp;
-
-    dac16_dac3 = val;
-
-    DAC_CSN = 0;
+// Writes vals[n] to the buffer of each DACn selected by bit n of mask, one 
+// 24-bit write after another, and loads all four DACs from their buffers 
+// with the last write, so that the selected outputs change together
+void dac16_set_many(uint16_t mask, uint16_t *vals) {
+    uint16_t dac, last;
 
-    // Write to buffer with data and load DAC3
-    SPI1BUF = 0b00010110;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC3 value
-    SPI1BUF = dac16_dac3 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC3 value
-    SPI1BUF = dac16_dac3 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
+    mask &= 0x0F;
+    if (mask == 0)
+        return;
 
-    DAC_CSN = 1;
+    for (last = 3; (mask & (1 << last)) == 0; last--) {}
+    for (dac = 0; dac <= last; dac++) {
+        if (mask & (1 << dac)) {
+            dac16_vals[dac] = vals[dac];
+            dac16_write(((dac == last) ? DAC16_LOAD_ALL : DAC16_LOAD_NONE) | (dac << 1), vals[dac]);
+        }
+    }
+    timer_stamp(TIMER_STAMP_DAC16);
 }
 
 void dac16_set_ch1(uint16_t pos, uint16_t neg) {
-    uint16_t temp;
-
-    dac16_dac0 = neg;
-
-    DAC_CSN = 0;
-
-    // Write to buffer 0 with data
-    SPI1BUF = 0b00000000;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC0 value
-    SPI1BUF = dac16_dac0 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC0 value
-    SPI1BUF = dac16_dac0 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    DAC_CSN = 1;
-
-    dac16_dac1 = pos;
-
-    DAC_CSN = 0;
-
-    // Write to buffer 1 with data and load all DACs simultaneously
-    SPI1BUF = 0b00100010;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC1 value
-    SPI1BUF = dac16_dac1 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
+    uint16_t vals[DAC16_CHANNELS];
 
-    // Write low byte of DAC1 value
-    SPI1BUF = dac16_dac1 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    DAC_CSN = 1;
+    vals[0] = neg;
+    vals[1] = pos;
+    dac16_set_many(0x03, vals);
 }
 
 void dac16_set_ch2(uint16_t pos, uint16_t neg) {
-    uint16_t temp;
-
-    dac16_dac2 = neg;
-
-    DAC_CSN = 0;
-
-    // Write to buffer 2 with data
-    SPI1BUF = 0b00000100;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC2 value
-    SPI1BUF = dac16_dac2 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC2 value
-    SPI1BUF = dac16_dac2 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
+    uint16_t vals[DAC16_CHANNELS];
 
-    DAC_CSN = 1;
-
-    dac16_dac3 = pos;
-
-    DAC_CSN = 0;
-
-    // Write to buffer 3 with data and load all DACs simultaneously
-    SPI1BUF = 0b00100110;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write high byte of DAC3 value
-    SPI1BUF = dac16_dac3 >> 8;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    // Write low byte of DAC3 value
-    SPI1BUF = dac16_dac3 & 0xFF;
-    while (SPI1STATbits.SPIRBF == 0) {}
-    temp = SPI1BUF;
-
-    DAC_CSN = 1;
+    vals[2] = neg;
+    vals[3] = pos;
+    dac16_set_many(0x0C, vals);
 }
 
 // Functions for interfacing with the 2-channel, 24-bit sigma-delta ADC (ADS1292)
 void init_adc24(void) {
     uint8_t *RPOR, *RPINR;
-    uint16_t i;
 
     // Configure ADC24 pins, SPI peripheral (SPI2), and clock (OC1)
     ADC_CSN_DIR = OUT; ADC_CSN = 1;
@@ -503,9 +477,7 @@ void init_adc24(void) {
     RPOR[ADC_SCK_RP] = SCK2OUT_RP;
     __builtin_write_OSCCONL(OSCCON | 0x40);
 
-    SPI2CON1 = 0x0032;      // SPI2 mode = 1, SCK freq = 1 MHz
-    SPI2CON2 = 0;
-    SPI2STAT = 0x8000;
+    spi_config(2, ADC24_SPI_FREQ, ADC24_SPI_MODE);
 
     __builtin_write_OSCCONL(OSCCON & 0xBF);
     RPOR[ADC_CLK_RP] = OC1_RP;
@@ -518,14 +490,15 @@ void init_adc24(void) {
 
     adc24_ch1offset = 0;
     adc24_ch2offset = 0;
+    adc24_run_count = 0;
 
     // Wait for 20 ms to allow ADS1292 to start up
-    for (i = 64000; i; i--) {}
+    delay_ms(20);
 
     adc24_command(ADC24_CMD_RESET);
 
     // Wait for 36 clock periods (9 TMOD = 65.25 µs) for reset to complete
-    for (i = 208; i; i--) {}
+    delay_us(66);
 
     adc24_command(ADC24_CMD_SDATAC);
 
@@ -548,6 +521,10 @@ void adc24_calibrate(void) {
     uint16_t i;
     int32_t ch1val, ch2val;
 
+    // Keep the offsets from before if the ADS1292 cannot convert now
+    if (!adc24_can_convert())
+        return;
+
     // Configure CH1 for normal operation, PGA gain = 1, inputs shorted to
     //   measure CH1 offset
     adc24_write_reg(ADC24_REG_CH1SET, 0b000010001);
@@ -560,20 +537,20 @@ void adc24_calibrate(void) {
     adc24_ch1offset = 0;
     adc24_ch2offset = 0;
 
-    ADC_START = 1;
+    adc24_set_start(1);
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&ch1val, &ch2val);
 
     for (i = 0; i < 9; i++) {
-        while (ADC_DRDY == 1) {}
+        adc24_wait_drdy();
         adc24_read_data(&ch1val, &ch2val);
 
         adc24_ch1offset += ch1val;
         adc24_ch2offset += ch2val;
     }
 
-    ADC_START = 0;
+    adc24_set_start(adc24_run_count ? 1 : 0);
 
     adc24_ch1offset = adc24_ch1offset / 9;
     adc24_ch2offset = adc24_ch2offset / 9;
@@ -586,146 +563,112 @@ void adc24_calibrate(void) {
 }
 
 void adc24_command(uint8_t cmd) {
-    uint16_t temp, i;
-
     ADC_CSN = 0;
 
-    SPI2BUF = (uint16_t)cmd;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(cmd);
 
     // Delay for 4 clock periods (7.25 µs) before raising CSN
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
     ADC_CSN = 1;
 
     // Delay for 3 clock periods (5.5 µs) to meet minimum CSN high time
-    for (i = 16; i; i--) {}
+    delay_us(6);
 }
 
 void adc24_write_reg(uint8_t reg, uint8_t val) {
-    uint16_t temp, i;
-
     ADC_CSN = 0;
 
-    SPI2BUF = (uint16_t)(ADC24_CMD_WREG | reg);
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(ADC24_CMD_WREG | reg);
 
     // Delay for 4 clock periods (7.25 µs) for multibyte instruction decode
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(0);
 
     // Delay for 4 clock periods (7.25 µs) for multibyte instruction decode
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
-    SPI2BUF = (uint16_t)val;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(val);
 
     // Delay for 4 clock periods (7.25 µs) before raising CSN
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
     ADC_CSN = 1;
 
     // Delay for 3 clock periods (5.5 µs) to meet minimum CSN high time
-    for (i = 16; i; i--) {}
+    delay_us(6);
 }
 
 uint8_t adc24_read_reg(uint8_t reg) {
-    uint16_t temp, i;
+    uint8_t temp;
 
     ADC_CSN = 0;
 
-    SPI2BUF = (uint16_t)(ADC24_CMD_RREG | reg);
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(ADC24_CMD_RREG | reg);
 
     // Delay for 4 clock periods (7.25 µs) for multibyte instruction decode
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(0);
 
     // Delay for 4 clock periods (7.25 µs) for multibyte instruction decode
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    temp = spi2_exchange(0);
 
     // Delay for 4 clock periods (7.25 µs) before raising CSN
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
     ADC_CSN = 1;
 
     // Delay for 3 clock periods (5.5 µs) to meet minimum CSN high time
-    for (i = 16; i; i--) {}
+    delay_us(6);
 
-    return (uint8_t)temp;
+    return temp;
+}
+
+void adc24_wait_drdy(void) {
+    TIMEOUT_T timeout;
+
+    PERF_BEGIN(PERF_WAIT_DRDY);
+    timeout_start(&timeout, TIMEOUT_DRDY_US);
+    while (ADC_DRDY == 1) {
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_DRDY);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_DRDY);
+    timer_stamp(TIMER_STAMP_ADC24);
 }
 
 void adc24_read_data(int32_t *ch1val, int32_t *ch2val) {
-    uint16_t temp, i;
     int32_t val1, val2;
+    uint8_t data[9];
 
+    // Send the RDATA command and then nine dummy bytes, in exchange for 
+    // which the ADS1292 returns three bytes of status (discarded) and the 
+    // 24-bit CH1 and CH2 values, most-significant byte first
     ADC_CSN = 0;
 
-    // Send the RDATA command
-    SPI2BUF = (uint16_t)ADC24_CMD_RDATA;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
-
-    // Read three bytes of status and discard
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
-
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
+    spi2_exchange(ADC24_CMD_RDATA);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    temp = SPI2BUF;
-
-    // Read 24-bit CH1 value
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val1 = (int32_t)SPI2BUF;
-
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val1 = (val1 << 8) | SPI2BUF;
-
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val1 = (val1 << 8) | SPI2BUF;
-
-    // Read 24-bit CH2 value
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val2 = (int32_t)SPI2BUF;
+    // Delay for 4 clock periods (7.25 µs) for multibyte instruction decode
+    delay_us(8);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val2 = (val2 << 8) | SPI2BUF;
+    spi2_transfer((uint8_t *)NULL, data, 9);
 
-    SPI2BUF = 0;
-    while (SPI2STATbits.SPIRBF == 0) {}
-    val2 = (val2 << 8) | SPI2BUF;
+    val1 = ((int32_t)data[3] << 16) | ((uint16_t)data[4] << 8) | data[5];
+    val2 = ((int32_t)data[6] << 16) | ((uint16_t)data[7] << 8) | data[8];
 
     // Delay for 4 clock periods (7.25 µs) before raising CSN
-    for (i = 22; i; i--) {}
+    delay_us(8);
 
     ADC_CSN = 1;
 
     // Delay for 3 clock periods (5.5 µs) to meet minimum CSN high time
-    for (i = 16; i; i--) {}
+    delay_us(6);
 
     // Sign extend CH1 value to 32 bits
     if (val1 > 0x7FFFFF)
@@ -742,15 +685,21 @@ void adc24_read_data(int32_t *ch1val, int32_t *ch2val) {
 void adc24_meas_both(int32_t *ch1val, int32_t *ch2val) {
     int32_t val1, val2;
 
-    ADC_START = 1;
+    if (!adc24_can_convert()) {
+        *ch1val = 0;
+        *ch2val = 0;
+        return;
+    }
+
+    adc24_start();
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&val1, &val2);
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&val1, &val2);
 
-    ADC_START = 0;
+    adc24_stop();
 
     *ch1val = val1 - adc24_ch1offset;
     *ch2val = val2 - adc24_ch2offset;
@@ -760,23 +709,29 @@ void adc24_meas_both_avg(int32_t *ch1val, int32_t *ch2val) {
     uint16_t i;
     int32_t val1, val2;
 
+    if (!adc24_can_convert()) {
+        *ch1val = 0;
+        *ch2val = 0;
+        return;
+    }
+
     *ch1val = 0;
     *ch2val = 0;
 
-    ADC_START = 1;
+    adc24_start();
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&val1, &val2);
 
     for (i = 0; i < 9; i++) {
-        while (ADC_DRDY == 1) {}
+        adc24_wait_drdy();
         adc24_read_data(&val1, &val2);
 
         *ch1val += val1;
         *ch2val += val2;
     }
 
-    ADC_START = 0;
+    adc24_stop();
 
     *ch1val = (*ch1val / 9) - adc24_ch1offset;
     *ch2val = (*ch2val / 9) - adc24_ch2offset;
@@ -785,20 +740,88 @@ void adc24_meas_both_avg(int32_t *ch1val, int32_t *ch2val) {
 void adc24_meas_both_raw(int32_t *ch1val, int32_t *ch2val) {
     int32_t val1, val2;
 
-    ADC_START = 1;
+    if (!adc24_can_convert()) {
+        *ch1val = 0;
+        *ch2val = 0;
+        return;
+    }
+
+    adc24_start();
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&val1, &val2);
 
-    while (ADC_DRDY == 1) {}
+    adc24_wait_drdy();
     adc24_read_data(&val1, &val2);
 
-    ADC_START = 0;
+    adc24_stop();
 
     *ch1val = val1;
     *ch2val = val2;
 }
 
+// Drives the ADS1292's START pin, relaying it to the slaves on a sync 
+// master; on a sync slave, START follows the master's instead (see sync.h)
+void adc24_set_start(uint16_t level) {
+    if (sync_mode == SYNC_SLAVE)
+        return;
+    ADC_START = level;
+    if (sync_mode == SYNC_MASTER)
+        SYNC_START = level;
+}
+
+// Returns 1 if the ADS1292 converts once adc24_set_start(1) is called, as 
+// it does unless it is on a sync slave whose master is not converting; 
+// otherwise logs a DRDY timeout at once, rather than after waiting for 
+// DRDY in vain, so that the command's reply is flagged, and returns 0
+uint16_t adc24_can_convert(void) {
+    if ((sync_mode == SYNC_SLAVE) && !SYNC_START_IN) {
+        timeout_error(TIMEOUT_DRDY);
+        return 0;
+    }
+    return 1;
+}
+
+// Continuous conversions are reference counted so that a stream can keep the
+// ADS1292 running while one-shot measurements come and go.
+void adc24_start(void) {
+    if (adc24_run_count == 0)
+        adc24_set_start(1);
+    adc24_run_count++;
+}
+
+void adc24_stop(void) {
+    if (adc24_run_count == 0)
+        return;
+    adc24_run_count--;
+    if (adc24_run_count == 0)
+        adc24_set_start(0);
+}
+
+int16_t adc24_poll(int32_t *ch1val, int32_t *ch2val) {
+    int32_t val1, val2;
+
+    if ((adc24_run_count == 0) || (ADC_DRDY == 1))
+        return 0;
+    timer_stamp(TIMER_STAMP_ADC24);
+
+    adc24_read_data(&val1, &val2);
+
+    *ch1val = val1 - adc24_ch1offset;
+    *ch2val = val2 - adc24_ch2offset;
+    return 1;
+}
+
+// Returns the time between ADC24 frames in instruction cycles: 4096 >> DR 
+// periods of the ADS1292's clock, which OC1 makes FCY / (OC1RS + 1), or on 
+// a sync slave, FCY / 28 from the master
+uint32_t adc24_frame_ticks(void) {
+    uint16_t clock;
+
+    clock = (sync_mode == SYNC_SLAVE) ? 28 : OC1RS + 1;
+    return (uint32_t)clock * (4096 >> (adc24_read_reg(ADC24_REG_CONFIG1) & 0x07));
+}
+
 void adc24_set_ch1offset(int32_t val) {
     adc24_ch1offset = val;
 }
@@ -815,10 +838,154 @@ int32_t adc24_get_ch2offset(void) {
     return adc24_ch2offset;
 }
 
+// Functions for erasing, reading, and writing program memory
+void flash_erase_page(uint16_t page, uint16_t offset) {
+    TIMEOUT_T timeout;
+
+    trace_log(TRACE_FLASH_ERASE, offset);
+    NVMCON = 0x4042;                // set up NVMCON to erase a page of program memory
+    __asm__("push _TBLPAG");        // save the value of TBLPAG
+    TBLPAG = page;
+    __builtin_tblwtl(offset, 0x0000);
+    __asm__("disi #16");            // disable interrupts for 16 cycles
+    __builtin_write_NVM();          // issue the unlock sequence and perform the erase
+    PERF_BEGIN(PERF_WAIT_NVM);
+    timeout_start(&timeout, TIMEOUT_NVM_US);
+    while (NVMCONbits.WR == 1) {    // wait until the erase is complete
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_NVM);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_NVM);
+    NVMCONbits.WREN = 0;            // disable further writes to program memory
+    __asm__("pop _TBLPAG");         // restore original value to TBLPAG
+}
+
+// Reads num instructions starting at page:offset into data, packed as three 
+// bytes per instruction (bits 7:0, 15:8, and 23:16), crossing into the next 
+// page of the table address space if necessary.
+void flash_read(uint16_t page, uint16_t offset, uint8_t *data, uint16_t num) {
+    WORD temp;
+
+    __asm__("push _TBLPAG");        // save the value of TBLPAG
+    TBLPAG = page;
+    for (; num; num--) {
+        temp.w = __builtin_tblrdl(offset);
+        *data++ = temp.b[0];
+        *data++ = temp.b[1];
+        *data++ = (uint8_t)__builtin_tblrdh(offset);
+        offset += 2;
+        if (offset == 0)
+            TBLPAG++;
+    }
+    __asm__("pop _TBLPAG");         // restore original value to TBLPAG
+}
+
+// Programs the row of FLASH_ROW_INSTRUCTIONS instructions at page:offset with
+// data packed as three bytes per instruction, as returned by flash_read().
+void flash_write_row(uint16_t page, uint16_t offset, uint8_t *data) {
+    uint16_t i;
+    WORD temp;
+    TIMEOUT_T timeout;
+
+    trace_log(TRACE_FLASH_WRITE, offset);
+    NVMCON = 0x4001;                // set up NVMCON to program a row of program memory
+    __asm__("push _TBLPAG");        // save the value of TBLPAG
+    TBLPAG = page;
+    offset &= ~(2 * FLASH_ROW_INSTRUCTIONS - 1);
+    for (i = 0; i < FLASH_ROW_INSTRUCTIONS; i++) {
+        temp.b[0] = *data++;
+        temp.b[1] = *data++;
+        __builtin_tblwtl(offset, temp.w);
+        __builtin_tblwth(offset, (uint16_t)*data++);
+        offset += 2;
+    }
+    __asm__("disi #16");            // disable interrupts for 16 cycles
+    __builtin_write_NVM();          // issue the unlock sequence and perform the write
+    PERF_BEGIN(PERF_WAIT_NVM);
+    timeout_start(&timeout, TIMEOUT_NVM_US);
+    while (NVMCONbits.WR == 1) {    // wait until the write is done
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_NVM);
+            break;
+        }
+    }
+    PERF_END(PERF_WAIT_NVM);
+    NVMCONbits.WREN = 0;            // disable further writes to program memory
+    __asm__("pop _TBLPAG");         // restore original value to TBLPAG
+}
+
+// Functions for the unit ID
+
+// Fills in the serial number string with the unit ID, or if it has not been 
+// set, leaves the serial number out of the device descriptor, so that 
+// boards without one do not all report the same serial number
+void init_unit_id(void) {
+    uint32_t id;
+    uint16_t i, digit;
+
+    id = unit_id_read();
+    Device[DEVICE_SERIAL_INDEX] = (id == UNIT_ID_NONE) ? 0 : DEVICE_SERIAL_STRING;
+    for (i = 0; i < 8; i++) {
+        digit = (uint16_t)(id >> (28 - 4 * i)) & 0x000F;
+        String3[2 + 2 * i] = (digit < 10) ? '0' + digit : 'A' + digit - 10;
+    }
+}
+
+uint32_t unit_id_read(void) {
+    uint8_t data[6];
+    WORD32 id;
+
+    flash_read(UNIT_ID_PAGE, UNIT_ID_OFFSET, data, 2);
+    id.b[0] = data[0];
+    id.b[1] = data[1];
+    id.b[2] = data[3];
+    id.b[3] = data[4];
+    return id.ul;
+}
+
+// Erases the unit ID's page and programs the new ID into it, updating the 
+// serial number string, which a host sees the next time that the board 
+// enumerates
+void unit_id_write(uint32_t id) {
+    uint8_t data[FLASH_ROW_BYTES];
+    uint16_t i;
+    WORD32 temp;
+
+    for (i = 0; i < FLASH_ROW_BYTES; i++)
+        data[i] = 0xFF;
+    temp.ul = id;
+    data[0] = temp.b[0];
+    data[1] = temp.b[1];
+    data[2] = 0x00;
+    data[3] = temp.b[2];
+    data[4] = temp.b[3];
+    data[5] = 0x00;
+
+    flash_erase_page(UNIT_ID_PAGE, UNIT_ID_OFFSET);
+    flash_write_row(UNIT_ID_PAGE, UNIT_ID_OFFSET, data);
+    init_unit_id();
+}
+
+// Returns the address of the first page past the application
+uint32_t flash_writable_start(void) {
+    return (flash_program_end() + FLASH_PAGE_ADDRESSES - 1) & ~(uint32_t)(FLASH_PAGE_ADDRESSES - 1);
+}
+
+// Returns 1 if program memory address page:offset is outside the pages that 
+// FLASH commands may erase or program (the bootloader, the vector tables, 
+// the application, the unit ID, and the configuration words), or 0 if not
+uint16_t flash_protected(uint16_t page, uint16_t offset) {
+    uint32_t address;
+
+    address = ((uint32_t)page << 16) | offset;
+    return ((address < flash_writable_start()) || (address >= FLASH_WRITABLE_END)) ? 1 : 0;
+}
+
 // Functions relating to the BLE module (RN4871)
 void init_ble(void) {
     uint8_t *RPOR, *RPINR;
-    uint16_t i;
 
     RPOR = (uint8_t *)&RPOR0;
     RPINR = (uint8_t *)&RPINR0;
@@ -870,7 +1037,7 @@ void init_ble(void) {
     U1STAbits.UTXEN = 1;        // enable UART1 data transmission
 
     BLE_RST_N = 0;
-    for (i = 1000; i; i--) {}
+    delay_us(300);
     BLE_RST_N = 1;
 }
 
@@ -892,6 +1059,10 @@ void ble_puts(uint8_t *str) {
     U1flushTxBuffer();
 }
 
+uint16_t ble_tx_buffer_space(void) {
+    return U1TXbuffer.length - U1TXbuffer.count;
+}
+
 uint16_t dummy_in_waiting(void) {
     return 0;
 }
@@ -910,13 +1081,15 @@ void dummy_puts(uint8_t *str) {
 
 void __attribute__((interrupt, auto_psv)) _U1TXInterrupt(void) {
     uint8_t ch;
+    uint16_t count;
 
     IFS0bits.U1TXIF = 0;            // lower UART1 TX interrupt flag
 
     if (U1TXbuffer.count == 0)      // if nothing left in UART1 TX buffer, 
         U1STAbits.UTXEN = 0;        //   disable data transmission
 
-    while ((U1STAbits.UTXBF == 0) && (U1TXbuffer.count != 0)) {
+    count = 0;
+    while (uart1_tx_ready() && (U1TXbuffer.count != 0)) {
         disable_interrupts();
         ch = U1TXbuffer.data[U1TXbuffer.head];
         U1TXbuffer.head++;
@@ -924,22 +1097,31 @@ void __attribute__((interrupt, auto_psv)) _U1TXInterrupt(void) {
             U1TXbuffer.head = 0;
         U1TXbuffer.count--;
         enable_interrupts();
-        U1TXREG = (uint16_t)ch;
+        uart1_tx(ch);
+        count++;
     }
+    if (count)
+        trace_log(TRACE_U1TX, count);
 }
 
 void __attribute__((interrupt, auto_psv)) _U1RXInterrupt(void) {
+    uint16_t count;
+
     IFS0bits.U1RXIF = 0;            // lower UART1 RX interrupt flag
 
-    while ((U1STAbits.URXDA == 1) && (U1RXbuffer.count != U1RXbuffer.length)) {
+    count = 0;
+    while (uart1_rx_ready() && (U1RXbuffer.count != U1RXbuffer.length)) {
         disable_interrupts();
-        U1RXbuffer.data[U1RXbuffer.tail] = (uint8_t)U1RXREG;
+        U1RXbuffer.data[U1RXbuffer.tail] = uart1_rx();
         U1RXbuffer.tail++;
         if (U1RXbuffer.tail == U1RXbuffer.length)
             U1RXbuffer.tail = 0;
         U1RXbuffer.count++;
         enable_interrupts();
+        count++;
     }
+    if (count)
+        trace_log(TRACE_U1RX, count);
 }
 
 uint16_t U1inWaiting(void) {
@@ -952,8 +1134,15 @@ void U1flushTxBuffer(void) {
 }
 
 void U1putc(uint8_t ch) {
-    while (U1TXbuffer.count == U1TXbuffer.length) {}    // wait until UART1 TX 
-                                                        //   buffer is not full
+    TIMEOUT_T timeout;
+
+    timeout_start(&timeout, TIMEOUT_U1_US);
+    while (U1TXbuffer.count == U1TXbuffer.length) {     // wait until UART1 TX 
+        if (timeout_expired(&timeout)) {                //   buffer is not full
+            timeout_error(TIMEOUT_U1TX);
+            return;
+        }
+    }
     disable_interrupts();
     U1TXbuffer.data[U1TXbuffer.tail] = ch;
     U1TXbuffer.tail++;
@@ -969,8 +1158,15 @@ void U1putc(uint8_t ch) {
 
 uint8_t U1getc(void) {
     uint8_t ch;
+    TIMEOUT_T timeout;
 
-    while (U1RXbuffer.count == 0) {}    // wait until UART1 RX buffer is not empty
+    timeout_start(&timeout, TIMEOUT_U1_US);
+    while (U1RXbuffer.count == 0) {     // wait until UART1 RX buffer is not empty
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_U1RX);
+            return 0;
+        }
+    }
 
     disable_interrupts();
     ch = U1RXbuffer.data[U1RXbuffer.head];
@@ -54,6 +54,15 @@
 #define RE5_DIR             TRISEbits.TRISE5
 #define RE6_DIR             TRISEbits.TRISE6
 
+// Remappable pin numbers of the digital header pins (RD6 and RE0 to RE6 
+// cannot be remapped to peripheral outputs)
+#define RD0_RP              11
+#define RD1_RP              24
+#define RD2_RP              23
+#define RD3_RP              22
+#define RD4_RP              25
+#define RD5_RP              20
+
 // DAC16 (DAC8565) pin definitions
 #define DAC_CSN             LATDbits.LATD8
 #define DAC_SCK             LATDbits.LATD11
@@ -122,6 +131,7 @@
 #define INT2_RP             2
 #define INT3_RP             3
 #define INT4_RP             4
+#define T4CK_RP             8
 
 #define MOSI1_RP            7
 #define SCK1OUT_RP          8
@@ -198,6 +208,60 @@
 #define ADC24_REG_RESP2     0x0A
 #define ADC24_REG_GPIO      0x0B
 
+// Program memory geometry (in instructions; each instruction occupies two 
+// program memory addresses and three bytes when packed)
+#define FLASH_ROW_INSTRUCTIONS  64
+#define FLASH_PAGE_INSTRUCTIONS 512
+#define FLASH_ROW_BYTES     (3 * FLASH_ROW_INSTRUCTIONS)
+
+// FLASH:ERASE, FLASH:WRITE, and FLASH:WRITEBIN only change the pages from 
+// the first one past the application up to the unit ID's page
+#define FLASH_PAGE_ADDRESSES    (2 * FLASH_PAGE_INSTRUCTIONS)
+#define FLASH_WRITABLE_END  0x15000
+
+// The board's unit ID, reported as the USB serial number (eight hex 
+// digits), is kept in the first two instructions of the last page of 
+// application memory (0x15000), which the linker script and the bootloader 
+// tools leave alone; it reads as UNIT_ID_NONE until FLASH:SERIAL sets it.
+#define UNIT_ID_PAGE        0x0001
+#define UNIT_ID_OFFSET      0x5000
+#define UNIT_ID_NONE        0xFFFFFFFF
+
+// Timer2/3 timebase counts instruction cycles (FCY = 16 MHz)
+#define TIMER_TICKS_PER_US  16
+
+// Kinds of timestamps kept in timer_stamps[], each the Timer2/3 time of the 
+// latest event of its kind: the end of the last ADC16 conversion used in a 
+// result, the falling edge of ADC24 DRDY (as polled), the updates of the 
+// DAC10, DAC16, and digital outputs, the trigger sample of a logic 
+// capture, and the firing of the trigger subsystem
+#define TIMER_STAMP_ADC16   0
+#define TIMER_STAMP_ADC24   1
+#define TIMER_STAMP_DAC10   2
+#define TIMER_STAMP_DAC16   3
+#define TIMER_STAMP_DIGOUT  4
+#define TIMER_STAMP_LOGIC   5
+#define TIMER_STAMP_TRIGGER 6
+#define TIMER_STAMPS        7
+
+// SPI bus clocks: the DAC8564 accepts SCLK up to 50 MHz and the ADS1292 up 
+// to 20 MHz, so both buses run at the fastest SCK that the PIC24's SPI 
+// master can produce, FCY / 2
+#define FCY_HZ              16000000
+#define DAC16_SPI_FREQ      8000000
+#define DAC16_SPI_MODE      2
+#define ADC24_SPI_FREQ      8000000
+#define ADC24_SPI_MODE      1
+
+// DAC8564 channels and the load-control bits (LD1:LD0) of its control byte, 
+// which is LD1:LD0 << 4 | DAC select << 1: write a DAC's buffer only, write 
+// its buffer and load it, or write its buffer and load all four DACs from 
+// their buffers simultaneously
+#define DAC16_CHANNELS      4
+#define DAC16_LOAD_NONE     0x00
+#define DAC16_LOAD_ONE      0x10
+#define DAC16_LOAD_ALL      0x20
+
 #define U1TX_BUFFER_LENGTH  1024
 #define U1RX_BUFFER_LENGTH  1024
 
@@ -213,9 +277,18 @@ extern RINGBUFFER U1TXbuffer, U1RXbuffer;
 extern uint8_t U1TX_buffer[];
 extern uint8_t U1RX_buffer[];
 extern uint16_t U1TXthreshold;
+extern uint16_t adc24_run_count;
+extern uint32_t timer_stamps[];
 
 void init_smu_base(void);
 
+void init_timer(void);
+uint32_t timer_read(void);
+void timer_stamp(uint16_t which);
+uint32_t timer_period(uint32_t cycles, uint16_t *tckps, uint16_t *pr);
+
+uint32_t spi_config(uint16_t bus, uint32_t freq, uint16_t mode);
+
 void init_adc16(void);
 void adc16_calibrate(void);
 int16_t adc16_meas_ch1_raw(void);
@@ -228,14 +301,10 @@ int16_t adc16_get_offset(void);
 uint16_t adc16_get_max_val(void);
 
 void init_dac16(void);
-uint16_t dac16_get_dac0(void);
-void dac16_set_dac0(uint16_t val);
-uint16_t dac16_get_dac1(void);
-void dac16_set_dac1(uint16_t val);
-uint16_t dac16_get_dac2(void);
-void dac16_set_dac2(uint16_t val);
-uint16_t dac16_get_dac3(void);
-void dac16_set_dac3(uint16_t val);
+void dac16_write(uint8_t control, uint16_t val);
+uint16_t dac16_get(uint16_t dac);
+void dac16_set(uint16_t dac, uint16_t val);
+void dac16_set_many(uint16_t mask, uint16_t *vals);
 void dac16_set_ch1(uint16_t pos, uint16_t neg);
 void dac16_set_ch2(uint16_t pos, uint16_t neg);
 
@@ -244,20 +313,38 @@ void adc24_calibrate(void);
 void adc24_command(uint8_t cmd);
 void adc24_write_reg(uint8_t reg, uint8_t val);
 uint8_t adc24_read_reg(uint8_t reg);
+void adc24_wait_drdy(void);
 void adc24_read_data(int32_t *ch1val, int32_t *ch2val);
 void adc24_meas_both(int32_t *ch1val, int32_t *ch2val);
 void adc24_meas_both_avg(int32_t *ch1val, int32_t *ch2val);
 void adc24_meas_both_raw(int32_t *ch1val, int32_t *ch2val);
+void adc24_set_start(uint16_t level);
+uint16_t adc24_can_convert(void);
+uint32_t adc24_frame_ticks(void);
+void adc24_start(void);
+void adc24_stop(void);
+int16_t adc24_poll(int32_t *ch1val, int32_t *ch2val);
 void adc24_set_ch1offset(int32_t val);
 int32_t adc24_get_ch1offset(void);
 void adc24_set_ch2offset(int32_t val);
 int32_t adc24_get_ch2offset(void);
 
+void flash_erase_page(uint16_t page, uint16_t offset);
+void flash_read(uint16_t page, uint16_t offset, uint8_t *data, uint16_t num);
+void flash_write_row(uint16_t page, uint16_t offset, uint8_t *data);
+
+void init_unit_id(void);
+uint32_t unit_id_read(void);
+void unit_id_write(uint32_t id);
+uint32_t flash_writable_start(void);
+uint16_t flash_protected(uint16_t page, uint16_t offset);
+
 void init_ble(void);
 uint16_t ble_in_waiting(void);
 void ble_putc(uint8_t ch);
 uint8_t ble_getc(void);
 void ble_puts(uint8_t *str);
+uint16_t ble_tx_buffer_space(void);
 
 uint16_t dummy_in_waiting(void);
 void dummy_putc(uint8_t ch);
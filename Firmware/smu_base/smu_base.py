@@ -1,22 +1,83 @@
 import serial
 import serial.tools.list_ports as list_ports
 import string, array
+import zlib
+import time
+import os, sys
+
+USB_VID = 0x6666
+USB_PID = 0xCDC2
+
+# A board whose unit ID has not been set reports no serial number, or with
+# firmware from before it left the serial number out, this one
+SERIAL_NONE = 'FFFFFFFF'
+
+def find_boards(serial_number = None):
+    '''Return the serial ports of all of the boards connected by USB, or of 
+    the one with the specified serial number (its unit ID, as a string of 
+    hex digits or as a number), as serial.tools.list_ports entries, in 
+    order of their serial numbers (boards without one last, in order of 
+    their port names).  The ports are found from their USB descriptors 
+    alone, without being opened.
+    '''
+    devices = [device for device in list_ports.comports() 
+               if device.vid == USB_VID and device.pid == USB_PID]
+    if serial_number is not None:
+        if isinstance(serial_number, int):
+            serial_number = f'{serial_number:08X}'
+        devices = [device for device in devices 
+                   if (device.serial_number or '').upper() == serial_number.upper()]
+    return sorted(devices, key = lambda device: (board_name(device) == device.device, board_name(device)))
+
+def board_name(device):
+    '''Return the name of a board found by find_boards(): its serial number, 
+    or its port name if its unit ID has not been set.
+    '''
+    if device.serial_number is None or device.serial_number.upper() == SERIAL_NONE:
+        return device.device
+    return device.serial_number
+
+def import_ble_serial():
+    '''Import ble_serial from smu_ble.py, which lives in Software, alongside
+    this file or two levels up from the copy in Firmware/smu_base.
+    '''
+    here = os.path.dirname(os.path.abspath(__file__))
+    for path in (here, os.path.join(here, '..', '..', 'Software')):
+        path = os.path.normpath(path)
+        if os.path.isfile(os.path.join(path, 'smu_ble.py')) and path not in sys.path:
+            sys.path.append(path)
+    from smu_ble import ble_serial
+    return ble_serial
 
 class smu_base:
 
-    def __init__(self, port = ''):
-        if port == '':
+    def __init__(self, port = '', serial_number = None):
+        if port == 'ble' or port.startswith('ble:'):
+            # Connect over BLE to the RN4871 transparent UART service, either
+            # to the first such device found (port = 'ble') or to a device
+            # with the specified name or address (port = 'ble:<name>').
+            try:
+                ble_serial = import_ble_serial()
+            except ImportError as error:
+                print(f'BLE is unavailable ({error})...')
+                self.dev = None
+                self.connected = False
+            else:
+                self.dev = ble_serial(port[4:])
+                self.connected = True
+                print(f'Connected to {self.dev.name} over BLE...')
+        elif port == '':
+            # Connect to the first board found, or to the one with the 
+            # specified serial number
             self.dev = None
             self.connected = False
-            devices = list_ports.comports()
-            for device in devices:
-                if device.vid == 0x6666 and device.pid == 0xCDC2:
-                    try:
-                        self.dev = serial.Serial(device.device)
-                        self.connected = True
-                        print(f'Connected to {device.device}...')
-                    except:
-                        pass
+            for device in find_boards(serial_number):
+                try:
+                    self.dev = serial.Serial(device.device)
+                    self.connected = True
+                    print(f'Connected to {device.device}...')
+                except:
+                    pass
                 if self.connected:
                     break
         else:
@@ -36,8 +97,33 @@ class smu_base:
             self.dev.write(f'{command}\r'.encode())
 
     def read(self):
-        if self.connected:
-            return self.dev.readline().decode()
+        '''Return the next line that the board replies with, raising 
+        RuntimeError if the board has marked it with a '!' because a wait 
+        for its hardware timed out while the command ran, leaving a value in 
+        the reply stale (see time_timeouts() for which wait).
+        '''
+        if self.connected:
+            reply = self.dev.readline().decode()
+            if any(field.startswith('!') for field in reply.split(',')):
+                raise RuntimeError(f'a hardware wait timed out on the board; stale reply {reply.strip()!r}')
+            return reply
+
+    def write_block(self, payload):
+        if self.connected:
+            payload = bytes(payload)
+            self.dev.write(b'#' + len(payload).to_bytes(2, 'little') + payload + 
+                           zlib.crc32(payload).to_bytes(4, 'little'))
+
+    def read_block(self):
+        if self.connected:
+            header = self.dev.read(3)
+            if len(header) != 3 or header[0] != ord('#'):
+                return None
+            payload = self.dev.read(int.from_bytes(header[1:3], 'little'))
+            crc = self.dev.read(4)
+            if int.from_bytes(crc, 'little') != zlib.crc32(payload):
+                return None
+            return payload
 
     def toggle_led1(self):
         if self.connected:
@@ -190,6 +276,19 @@ class smu_base:
             vals = [int(s, 16) for s in ret.split(',')]
             return vals[0] - vals[1]
 
+    def dac16_set_all(self, vals):
+        '''Set DAC0 to DAC3 to the four values in vals, with all four 
+        outputs changing at the same time.
+        '''
+        if self.connected:
+            if len(vals) == 4 and all(0 <= val <= 65535 for val in vals):
+                self.write('DAC16:ALL {:X},{:X},{:X},{:X}'.format(*[int(val) for val in vals]))
+
+    def dac16_get_all(self):
+        if self.connected:
+            self.write('DAC16:ALL?')
+            return [int(s, 16) for s in self.read().split(',')]
+
     def adc16_get_ch1(self):
         if self.connected:
             self.write('ADC16:CH1?')
@@ -368,6 +467,866 @@ class smu_base:
                 self.write(f'ADC24:REG? {int(reg):X}')
                 return int(self.read(), 16)
 
+    def adc24_stream_start(self, timed = False):
+        '''Start the ADC24 stream; if timed is True, each frame carries the 
+        device time at which its samples were taken.
+        '''
+        if self.connected:
+            self.write('ADC24:STREAM {}'.format('TIME' if timed else 'ON'))
+
+    def adc24_stream_stop(self):
+        if self.connected:
+            self.write('ADC24:STREAM OFF')
+            # Discard frames already in flight up to the reply to this query,
+            # skipping each one whole by its sync byte and length, since 
+            # their payloads may hold any byte values
+            self.write('ADC24:STREAM?')
+            lengths = {0xA5: 7, 0xA6: 11}
+            while True:
+                sync = self.dev.read(1)
+                if len(sync) == 0:
+                    break
+                if sync[0] in lengths:
+                    self.dev.read(lengths[sync[0]])
+                    continue
+                line = sync
+                while not line.endswith(b'\n'):
+                    ch = self.dev.read(1)
+                    if len(ch) == 0:
+                        break
+                    line += ch
+                if line == b'0\r\n':
+                    break
+
+    def adc24_stream_read(self, num_frames = 1):
+        '''Read num_frames ADC24 stream frames, each returned as a list of the
+        form [seq, ch1, ch2], or [seq, ch1, ch2, time] for a timed stream, 
+        with time in instruction cycles (16 per microsecond) of the device's 
+        32-bit timebase.  A gap in the 8-bit sequence numbers means that the 
+        device dropped frames because the link could not keep up.
+        '''
+        if self.connected:
+            frames = []
+            while len(frames) < num_frames:
+                sync = self.dev.read(1)
+                while sync[0] not in (0xA5, 0xA6):
+                    sync = self.dev.read(1)
+                if sync[0] == 0xA5:
+                    frame = self.dev.read(7)
+                    frames.append([frame[0], int.from_bytes(frame[1:4], 'little', signed = True),
+                                   int.from_bytes(frame[4:7], 'little', signed = True)])
+                else:
+                    frame = self.dev.read(11)
+                    frames.append([frame[0], int.from_bytes(frame[5:8], 'little', signed = True),
+                                   int.from_bytes(frame[8:11], 'little', signed = True), 
+                                   int.from_bytes(frame[1:5], 'little')])
+            return frames
+
+    def bench_run(self):
+        '''Run the firmware's micro-benchmarks and return a dictionary of the 
+        average number of instruction cycles (at 16 MHz) taken by each 
+        operation measured.
+        '''
+        if self.connected:
+            self.write('BENCH:RUN')
+            self.write('BENCH:RESULTS?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            names = ['str_tok_r', 'dispatch', 'dispatch_deep', 'hex2str_alt', 
+                     'reply', 'cdc_putc', 'U1putc', 'adc24_frame']
+            return dict(zip(names, vals))
+
+    perf_probes = ['usb_service', 'parser_state', 'dispatch', 'stream', 'wait_drdy', 
+                   'wait_spi1', 'wait_spi2', 'wait_sdadc', 'wait_nvm']
+
+    def perf_get(self, probe):
+        '''Return what the specified profiling probe (an index or a name from
+        perf_probes) has accumulated as a dictionary of its count and its 
+        total, minimum, mean, and maximum instruction cycles.  The probes
+        count only in firmware built with them compiled in (scons perf=1).
+        '''
+        if self.connected:
+            if isinstance(probe, str):
+                probe = self.perf_probes.index(probe)
+            self.write(f'PERF? {int(probe):X}')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            count = (vals[1] << 16) + vals[0]
+            total = (vals[5] << 48) + (vals[4] << 32) + (vals[3] << 16) + vals[2]
+            return {'count': count, 'total': total, 'min': (vals[7] << 16) + vals[6], 
+                    'mean': total / count if count else 0., 'max': (vals[9] << 16) + vals[8]}
+
+    def perf_get_all(self):
+        if self.connected:
+            return {name: self.perf_get(probe) for probe, name in enumerate(self.perf_probes)}
+
+    def perf_hist(self):
+        '''Return the main loop iteration histogram, whose nth bin counts 
+        iterations that took 2**n to 2**(n + 1) - 1 instruction cycles.
+        '''
+        if self.connected:
+            self.write('PERF:HIST?')
+            return [int(s, 16) for s in self.read().split(',')]
+
+    def perf_reset(self):
+        if self.connected:
+            self.write('PERF:RESET')
+
+    def trace_enable(self, val = True):
+        if self.connected:
+            self.write('TRACE:ENABLE {}'.format('ON' if val else 'OFF'))
+
+    def trace_clear(self):
+        if self.connected:
+            self.write('TRACE:CLEAR')
+
+    def trace_mark(self, val):
+        if self.connected:
+            self.write(f'TRACE:MARK {int(val) & 0xFFFF:X}')
+
+    def trace_dump(self):
+        '''Return the device's event trace, oldest event first, as a list of 
+        [time, event, arg] records, with time in instruction cycles (16 per 
+        microsecond) of the device's 32-bit timebase.  smu_trace.py decodes 
+        the records into a timeline.
+        '''
+        if self.connected:
+            self.write('TRACE:DUMP?')
+            data = self.read_block()
+            if data is None:
+                return None
+            return [[int.from_bytes(data[i:i + 4], 'little'), 
+                     int.from_bytes(data[i + 4:i + 6], 'little'), 
+                     int.from_bytes(data[i + 6:i + 8], 'little')] for i in range(0, len(data), 8)]
+
+    def trace_commands(self):
+        '''Return the commands of the device's root dispatch table, in order, 
+        whose indices the trace's DISPATCH events log, or None if the 
+        firmware does not list them (older firmware ignores the command, so 
+        the reply is waited for for 1 s only).
+        '''
+        if self.connected:
+            timeout = self.dev.timeout
+            self.dev.timeout = 1.
+            self.write('TRACE:COMMANDS?')
+            reply = self.read().strip()
+            self.dev.timeout = timeout
+            return reply.split(',') if reply else None
+
+    time_stamps = ['adc16', 'adc24', 'dac10', 'dac16', 'digout', 'logic', 'trigger']
+
+    def time_get(self):
+        '''Return the device time in instruction cycles (16 per microsecond)
+        of its 32-bit timebase, which rolls over every 268 s.
+        '''
+        if self.connected:
+            self.write('TIME?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return (vals[1] << 16) + vals[0]
+
+    def time_stamp(self, which):
+        '''Return the device time of the latest event of the specified kind
+        (an index or a name from time_stamps): the end of the last ADC16 
+        conversion, the last ADC24 conversion, the last update of the 
+        DAC10, DAC16, or digital outputs, or the trigger of the last logic 
+        capture.
+        '''
+        if self.connected:
+            if isinstance(which, str):
+                which = self.time_stamps.index(which)
+            self.write(f'TIME:STAMP? {int(which):X}')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return (vals[1] << 16) + vals[0]
+
+    def time_sof(self):
+        '''Return the 11-bit frame number of the latest USB start of frame 
+        and the device time at which it was seen, as [frame, time].
+        '''
+        if self.connected:
+            self.write('TIME:SOF?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return [vals[0], (vals[2] << 16) + vals[1]]
+
+    def time_correlate(self, num_queries = 16):
+        '''Relate device time to host time (time.perf_counter()) by querying 
+        the device time num_queries times and keeping the query with the 
+        shortest round trip, taking the device time to correspond to its 
+        midpoint.  Returns a dictionary of the device time, the host time, 
+        and the round trip time in seconds, which bounds the error.  Two 
+        correlations some seconds apart give the device clock's rate.
+        '''
+        if self.connected:
+            best = None
+            for i in range(num_queries):
+                start = time.perf_counter()
+                device_time = self.time_get()
+                end = time.perf_counter()
+                if best is None or end - start < best['rtt']:
+                    best = {'device': device_time, 'host': (start + end) / 2, 'rtt': end - start}
+            return best
+
+    timeouts = ['spi1', 'spi2', 'sdadc', 'drdy', 'nvm', 'u1tx', 'u1rx', 'usb_se0']
+
+    def time_timeouts(self):
+        '''Return a dictionary of the number of times that each of the 
+        device's waits on its peripherals has timed out.
+        '''
+        if self.connected:
+            self.write('TIME:TIMEOUTS?')
+            return dict(zip(self.timeouts, [int(s, 16) for s in self.read().split(',')]))
+
+    pwm_clock = 16e6
+
+    def pwm_set(self, ch, freq, duty = 0.5, phase = 0.):
+        '''Set PWM channel ch (0 to 5, driven by output compare modules OC2 
+        to OC7) to the frequency nearest freq that the 16-MHz clock gives 
+        (244 Hz to 8 MHz), the specified duty cycle (0 to 1), and the phase 
+        (in degrees) by which its rising edges lag those of a channel of the 
+        same frequency with phase 0, once started.  Returns the frequency.
+        '''
+        if self.connected:
+            if 0 <= ch < 6 and 0 < freq:
+                period = min(max(round(self.pwm_clock / freq), 2), 65535)
+                high = round(min(max(duty, 0.), 1.) * period)
+                delay = round((phase % 360.) / 360. * period) % period
+                self.write(f'PWM:SET {int(ch):X},{period:X},{high:X},{delay:X}')
+                return self.pwm_clock / period
+
+    def pwm_get(self, ch):
+        '''Return the frequency, duty cycle, and phase of PWM channel ch.
+        '''
+        if self.connected:
+            if 0 <= ch < 6:
+                self.write(f'PWM:SET? {int(ch):X}')
+                period, high, delay = [int(s, 16) for s in self.read().split(',')]
+                return [self.pwm_clock / period, high / period, 360. * delay / period]
+
+    def pwm_set_pin(self, ch, pin):
+        '''Drive header pin RD<pin> (0 to 5) from PWM channel ch, or with 
+        pin = None, hand the pin that channel ch drives back to its DIGOUT 
+        value.
+        '''
+        if self.connected:
+            if 0 <= ch < 6:
+                if pin is None:
+                    self.write(f'PWM:PIN {int(ch):X},OFF')
+                elif 0 <= pin < 6:
+                    self.write(f'PWM:PIN {int(ch):X},{int(pin):X}')
+
+    def pwm_get_pin(self, ch):
+        if self.connected:
+            if 0 <= ch < 6:
+                self.write(f'PWM:PIN? {int(ch):X}')
+                pin = int(self.read(), 16)
+                return None if pin == 0xFFFF else pin
+
+    def pwm_start(self, channels = None):
+        '''Start the listed PWM channels together, stopping any others, or 
+        if channels is None, start all of the channels that drive pins.
+        '''
+        if self.connected:
+            if channels is None:
+                self.write('PWM:START')
+            else:
+                mask = 0
+                for ch in channels:
+                    if 0 <= ch < 6:
+                        mask |= 1 << ch
+                self.write(f'PWM:START {mask:X}')
+
+    def pwm_stop(self):
+        if self.connected:
+            self.write('PWM:STOP')
+
+    def pwm_get_running(self):
+        if self.connected:
+            self.write('PWM:RUNNING?')
+            mask = int(self.read(), 16)
+            return [ch for ch in range(6) if mask & (1 << ch)]
+
+    def patgen_load(self, vectors):
+        '''Load a pattern of up to 256 vectors into the pattern generator. 
+        Bits 0 to 6 of each vector drive RD0 to RD6 and bits 8 to 14 drive 
+        RE0 to RE6.  Returns 0 if the whole pattern was loaded, or else the 
+        device's error status for the block that failed.
+        '''
+        if self.connected:
+            if not 0 < len(vectors) <= 256:
+                return None
+            for offset in range(0, len(vectors), 128):
+                payload = b''.join(int(v).to_bytes(2, 'little') for v in vectors[offset:offset + 128])
+                self.write(f'PATGEN:LOAD {offset:X}')
+                self.write_block(payload)
+                status = int(self.read(), 16)
+                if status != 0:
+                    return status
+            return 0
+
+    def patgen_set_rate(self, rate):
+        '''Set the rate at which vectors are played, in vectors per second 
+        (up to 50k), and return the rate set.
+        '''
+        if self.connected:
+            if rate > 0:
+                period = min(max(round(16e6 / rate), 320), 0xFFFFFFFF)
+                self.write(f'PATGEN:PERIOD {period & 0xFFFF:X},{period >> 16:X}')
+                self.write('PATGEN:PERIOD?')
+                vals = [int(s, 16) for s in self.read().split(',')]
+                return 16e6 / ((vals[1] << 16) + vals[0])
+
+    def patgen_set_count(self, count):
+        '''Play the pattern count times, or with count = 0, until stopped.
+        '''
+        if self.connected:
+            if 0 <= count <= 65535:
+                self.write(f'PATGEN:COUNT {int(count):X}')
+
+    def patgen_set_mask(self, mask):
+        '''Select the pins that the pattern drives, as bits of a vector.
+        '''
+        if self.connected:
+            self.write(f'PATGEN:MASK {int(mask) & 0x7F7F:X}')
+
+    def patgen_set_trigger(self, source = None, rising = True):
+        '''Start the pattern on an edge of a header pin ('RD0' to 'RD6' or 
+        'RE0' to 'RE6'), which becomes an input while armed, or of SW1 
+        ('SW1', which falls when pressed), or with source = None, as soon as 
+        it is started.
+        '''
+        if self.connected:
+            if source is None:
+                self.write('PATGEN:TRIGGER OFF')
+            elif source == 'SW1':
+                self.write(f'PATGEN:TRIGGER SW1,{int(bool(rising))}')
+            elif source[:2] in ('RD', 'RE') and 0 <= int(source[2:]) < 7:
+                bit = int(source[2:]) + (8 if source[:2] == 'RE' else 0)
+                self.write(f'PATGEN:TRIGGER {bit:X},{int(bool(rising))}')
+
+    def patgen_start(self):
+        if self.connected:
+            self.write('PATGEN:START')
+
+    def patgen_stop(self):
+        if self.connected:
+            self.write('PATGEN:STOP')
+
+    patgen_states = ['idle', 'armed', 'running']
+
+    def patgen_get_state(self):
+        if self.connected:
+            self.write('PATGEN:STATE?')
+            return self.patgen_states[int(self.read(), 16)]
+
+    def logic_set_inputs(self, mask):
+        '''Select the header pins to make inputs for a logic capture, as bits 
+        of a sample (0 to 6 for RD0 to RD6 and 8 to 14 for RE0 to RE6).  They 
+        stay inputs until logic_stop() is called.
+        '''
+        if self.connected:
+            self.write(f'LOGIC:INPUTS {int(mask) & 0x7F7F:X}')
+
+    def logic_set_rate(self, rate):
+        '''Set the logic capture's sample rate, in samples per second (up to 
+        33k), and return the rate set.
+        '''
+        if self.connected:
+            if rate > 0:
+                period = min(max(round(16e6 / rate), 480), 0xFFFFFFFF)
+                self.write(f'LOGIC:PERIOD {period & 0xFFFF:X},{period >> 16:X}')
+                self.write('LOGIC:PERIOD?')
+                vals = [int(s, 16) for s in self.read().split(',')]
+                return 16e6 / ((vals[1] << 16) + vals[0])
+
+    def logic_set_trigger(self, mask = 0, value = 0):
+        '''Trigger the capture on the first sample whose bits selected by 
+        mask equal those of value; with mask = 0, on the first sample.
+        '''
+        if self.connected:
+            self.write(f'LOGIC:TRIGGER {int(mask) & 0x7F7F:X},{int(value) & int(mask) & 0x7F7F:X}')
+
+    def logic_set_depth(self, pre, post):
+        '''Keep up to pre samples from before the trigger and take post 
+        samples after it.
+        '''
+        if self.connected:
+            if 0 <= pre <= 0xFFFF and 0 <= post <= 0xFFFFFFFF:
+                self.write(f'LOGIC:PRE {int(pre):X}')
+                self.write(f'LOGIC:POST {int(post) & 0xFFFF:X},{int(post) >> 16:X}')
+
+    def logic_start(self):
+        if self.connected:
+            self.write('LOGIC:START')
+
+    def logic_stop(self):
+        if self.connected:
+            self.write('LOGIC:STOP')
+
+    logic_states = ['idle', 'armed', 'triggered', 'done']
+
+    def logic_get_state(self):
+        if self.connected:
+            self.write('LOGIC:STATE?')
+            return self.logic_states[int(self.read(), 16)]
+
+    def logic_read(self):
+        '''Return the last logic capture as a list of [sample, count] runs, 
+        oldest first, and the number of the trigger sample (None if the 
+        capture never triggered).  The list is empty while a capture runs.
+        '''
+        if self.connected:
+            self.write('LOGIC:DATA?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            trigger = (vals[1] << 16) + vals[0]
+            payload = self.read_block()
+            if payload is None:
+                return None
+            runs = [[int.from_bytes(payload[i:i + 2], 'little'), 
+                     int.from_bytes(payload[i + 2:i + 4], 'little')] for i in range(0, len(payload), 4)]
+            return runs, None if trigger == 0xFFFFFFFF else trigger
+
+    @staticmethod
+    def logic_expand(runs):
+        '''Expand the runs returned by logic_read() into a list of samples.
+        '''
+        samples = []
+        for value, count in runs:
+            samples.extend([value] * count)
+        return samples
+
+    trigger_sources = ['soft', 'pin', 'sw1', 'adc24']
+    trigger_actions = {'adc24': 0x01, 'patgen': 0x02, 'logic': 0x04, 'pwm': 0x08}
+
+    def trigger_set_source(self, source = 'soft', rising = True, pin = 0, 
+                           channel = 1, level = 0):
+        '''Select what fires the trigger: 'soft' (trigger_force() only), 'pin' 
+        (an edge on header pin RD<pin>, 0 to 5, which becomes an input while 
+        armed), 'sw1' (an edge of SW1, which falls when pressed), or 'adc24' 
+        (ADC24 channel 1 or 2 crossing level, in offset-corrected codes, in 
+        the direction given by rising).
+        '''
+        if self.connected:
+            if source in self.trigger_sources:
+                self.write(f'TRIGGER:SOURCE {self.trigger_sources.index(source):X},{int(bool(rising))}')
+                if source == 'pin' and 0 <= pin < 6:
+                    self.write(f'TRIGGER:PIN {int(pin):X}')
+                elif source == 'adc24' and channel in (1, 2):
+                    level = int(level) & 0xFFFFFFFF
+                    self.write(f'TRIGGER:LEVEL {channel:X},{level & 0xFFFF:X},{level >> 16:X}')
+
+    def trigger_set_actions(self, actions):
+        '''Select the actions started when the trigger fires, from 'adc24' 
+        (a capture read with trigger_read()), 'patgen', 'logic', and 'pwm' 
+        (the PWM channels mapped onto pins).
+        '''
+        if self.connected:
+            mask = 0
+            for action in actions:
+                mask |= self.trigger_actions.get(action, 0)
+            self.write(f'TRIGGER:ACTIONS {mask:X}')
+
+    def trigger_set_mode(self, auto = False, holdoff = 0.):
+        '''Stop after the first trigger, or with auto = True, re-arm once 
+        holdoff seconds have passed since each trigger (and its ADC24 capture 
+        has finished and been read by trigger_read()).
+        '''
+        if self.connected:
+            cycles = min(max(round(holdoff * 16e6), 0), 0xFFFFFFFF)
+            self.write(f'TRIGGER:MODE {int(bool(auto))}')
+            self.write(f'TRIGGER:HOLDOFF {cycles & 0xFFFF:X},{cycles >> 16:X}')
+
+    def trigger_set_out(self, pin = None):
+        '''Raise header pin pin ('RD0' to 'RD6' or 'RE0' to 'RE6') when the 
+        trigger fires, lowering it again when it is armed, or with 
+        pin = None, use no trigger-out pin.
+        '''
+        if self.connected:
+            if pin is None:
+                self.write('TRIGGER:OUT OFF')
+            elif pin[:2] in ('RD', 'RE') and 0 <= int(pin[2:]) < 7:
+                bit = int(pin[2:]) + (8 if pin[:2] == 'RE' else 0)
+                self.write(f'TRIGGER:OUT {bit:X}')
+
+    def trigger_set_depth(self, pre, post):
+        '''Keep up to pre ADC24 frames from before the trigger and take post 
+        frames from the trigger on, 32 frames in all.
+        '''
+        if self.connected:
+            if 0 <= pre < 32 and 0 < post <= 32:
+                self.write(f'TRIGGER:DEPTH {int(pre):X},{int(post):X}')
+
+    def trigger_arm(self):
+        if self.connected:
+            self.write('TRIGGER:ARM')
+
+    def trigger_force(self):
+        if self.connected:
+            self.write('TRIGGER:FORCE')
+
+    def trigger_stop(self):
+        if self.connected:
+            self.write('TRIGGER:STOP')
+
+    trigger_states = ['idle', 'armed', 'fired', 'done']
+
+    def trigger_get_state(self):
+        '''Return the trigger's state and the number of times that it has 
+        fired since it was armed.
+        '''
+        if self.connected:
+            self.write('TRIGGER:STATE?')
+            state, fires = [int(s, 16) for s in self.read().split(',')]
+            return self.trigger_states[state], fires
+
+    def trigger_read(self):
+        '''Return the last ADC24 capture as lists of CH1 and CH2 samples, 
+        oldest first, and the index of the first sample taken after the 
+        trigger.  The lists are empty until a capture is complete.  In auto 
+        mode, reading a capture lets the trigger re-arm.
+        '''
+        if self.connected:
+            self.write('TRIGGER:DATA?')
+            index = int(self.read(), 16)
+            payload = self.read_block()
+            if payload is None:
+                return None
+            ch1, ch2 = [], []
+            for i in range(0, len(payload), 6):
+                ch1.append(int.from_bytes(payload[i:i + 3], 'little', signed = True))
+                ch2.append(int.from_bytes(payload[i + 3:i + 6], 'little', signed = True))
+            return ch1, ch2, index
+
+    sync_modes = ['off', 'master', 'slave']
+
+    def sync_set_mode(self, mode):
+        '''Make the board a sync master ('master'), which exports its ADS1292 
+        clock, START, and epoch pulses on RD0 to RD2, or a slave ('slave'), 
+        which follows them, or neither ('off').  While synchronized, the 
+        ADS1292 samples at 558 S/s.
+        '''
+        if self.connected:
+            if mode in self.sync_modes:
+                self.write(f'SYNC:MODE {self.sync_modes.index(mode):X}')
+
+    def sync_get_mode(self):
+        if self.connected:
+            self.write('SYNC:MODE?')
+            return self.sync_modes[int(self.read(), 16)]
+
+    def sync_reset(self):
+        '''Mark a new epoch on a sync master and its slaves.
+        '''
+        if self.connected:
+            self.write('SYNC:RESET')
+
+    def sync_get_epoch(self):
+        '''Return the timebase time of the last epoch and the number of 
+        epochs that the board has seen.
+        '''
+        if self.connected:
+            self.write('SYNC:EPOCH?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return (vals[1] << 16) + vals[0], vals[2]
+
+    def sync_time(self, ticks):
+        '''Convert a time from the board's timebase (a timestamp, or a time 
+        from a timed ADC24 stream frame) into seconds since the last epoch.
+        '''
+        if self.connected:
+            epoch, count = self.sync_get_epoch()
+            return ((ticks - epoch) % 2**32) / 16e6
+
+    def lockin_set(self, dac = 1, offset = 0x8000, amplitude = 0x1000, 
+                   points = 16, cycles = 10):
+        '''Set up the lock-in: a sine of the specified offset and amplitude 
+        (in DAC16 codes) on DAC16 output dac (0 to 3), taking points (4 to 
+        256) ADC24 frames per cycle, so that its frequency is the ADC24 
+        sample rate divided by points, with a result taken every cycles 
+        cycles.  Settings are ignored while the lock-in runs.
+        '''
+        if self.connected:
+            self.write(f'LOCKIN:DAC {int(dac):X}')
+            self.write(f'LOCKIN:LEVEL {int(offset):X},{int(amplitude):X}')
+            self.write(f'LOCKIN:POINTS {int(points):X}')
+            self.write(f'LOCKIN:CYCLES {int(cycles):X}')
+
+    def lockin_start(self):
+        if self.connected:
+            self.write('LOCKIN:START')
+
+    def lockin_stop(self):
+        if self.connected:
+            self.write('LOCKIN:STOP')
+
+    lockin_states = ['idle', 'settling', 'running']
+
+    def lockin_get_state(self):
+        '''Return the lock-in's state, the number of results taken since it 
+        was started, and the number of results discarded since then because 
+        the board missed an ADC24 frame.
+        '''
+        if self.connected:
+            self.write('LOCKIN:STATE?')
+            state, results, missed = [int(s, 16) for s in self.read().split(',')]
+            return self.lockin_states[state], results, missed
+
+    def lockin_read(self):
+        '''Return the latest lock-in result as the CH1 and CH2 phasors, each a
+        complex number I + jQ in ADC24 codes (whose abs() and cmath.phase() 
+        are the channel's amplitude and phase relative to the sine), and the 
+        number of results taken since the lock-in was started.  With CH1 
+        sensing voltage and CH2 current, ch1 / ch2 is proportional to the 
+        impedance.
+        '''
+        if self.connected:
+            self.write('LOCKIN:RESULT?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            parts = []
+            for i in range(0, 8, 2):
+                val = (vals[i + 1] << 16) + vals[i]
+                parts.append(val - (1 << 32) if val & 0x80000000 else val)
+            return complex(parts[0], parts[1]), complex(parts[2], parts[3]), vals[8]
+
+    def pulse_set(self, dac = 1, base = 0x8000, level = 0x9000, period = 10e-3, 
+                  width = 5e-3, delay = 0., frames = 1, count = 1):
+        '''Set up the pulse generator: pulses of DAC16 output dac (0 to 3) 
+        from base to level (in DAC16 codes), width seconds long and period 
+        seconds apart (up to about 1 s), with the first frames (1 to 128) 
+        ADC24 frames of a capture window opened delay seconds into each pulse 
+        averaged into its result, for count pulses, or with a count of 0, 
+        until stopped.  The ADS1292 takes a few frame periods to deliver its 
+        first frame after the window opens, so that pulses shorter than 
+        about 10 ms need a higher ADC24 data rate.  Settings are ignored while 
+        the pulse generator runs, and timings that do not fit in one another 
+        are ignored.
+        '''
+        if self.connected:
+            self.write(f'PULSE:DAC {int(dac):X}')
+            self.write(f'PULSE:LEVEL {int(base):X},{int(level):X}')
+            ticks = [int(round(t * 16e6)) for t in (period, width, delay)]
+            self.write('PULSE:TIMING ' + ','.join(f'{t & 0xFFFF:X},{t >> 16:X}' for t in ticks))
+            self.write(f'PULSE:FRAMES {int(frames):X}')
+            self.write(f'PULSE:COUNT {int(count):X}')
+
+    def pulse_start(self):
+        if self.connected:
+            self.write('PULSE:START')
+
+    def pulse_stop(self):
+        if self.connected:
+            self.write('PULSE:STOP')
+
+    pulse_states = ['idle', 'running']
+
+    def pulse_get_state(self):
+        '''Return the pulse generator's state and the numbers of pulses run, 
+        results taken, and pulses missed (whose capture windows closed before 
+        any ADC24 frame arrived) since it was started.
+        '''
+        if self.connected:
+            self.write('PULSE:STATE?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return self.pulse_states[vals[0]], vals[1], vals[2], vals[3]
+
+    def pulse_read(self):
+        '''Return the results of the last (up to 16) pulses as lists of 
+        average CH1 and CH2 samples, oldest first.
+        '''
+        if self.connected:
+            self.write('PULSE:DATA?')
+            count = int(self.read(), 16)
+            payload = self.read_block()
+            if payload is None:
+                return None
+            ch1, ch2 = [], []
+            for i in range(0, len(payload), 6):
+                ch1.append(int.from_bytes(payload[i:i + 3], 'little', signed = True))
+                ch2.append(int.from_bytes(payload[i + 3:i + 6], 'little', signed = True))
+            return ch1, ch2
+
+    def stats_set(self, frames = 1000, window = 0.):
+        '''Set up the ADC24 statistics: each block ends after frames frames 
+        or once window seconds have passed since its first frame, whichever 
+        comes first (a limit of 0 is not applied, but not both).  Settings 
+        are ignored while statistics are running.
+        '''
+        if self.connected:
+            frames = int(frames)
+            window = int(round(window * 16e6))
+            if frames == 0 and window == 0:
+                return
+            # Set the limit that is kept first, so that both are never 0
+            limits = [f'FRAMES {frames & 0xFFFF:X},{frames >> 16:X}', 
+                      f'WINDOW {window & 0xFFFF:X},{window >> 16:X}']
+            if frames == 0:
+                limits.reverse()
+            for limit in limits:
+                self.write('STATS:' + limit)
+
+    def stats_start(self):
+        if self.connected:
+            self.write('STATS:START')
+
+    def stats_stop(self):
+        if self.connected:
+            self.write('STATS:STOP')
+
+    stats_states = ['idle', 'running']
+
+    def stats_get_state(self):
+        '''Return the statistics' state and the number of blocks completed 
+        since they were started.
+        '''
+        if self.connected:
+            self.write('STATS:STATE?')
+            state, results = [int(s, 16) for s in self.read().split(',')]
+            return self.stats_states[state], results
+
+    def stats_read(self):
+        '''Return the latest block of ADC24 statistics as a dictionary 
+        holding its number of frames, the time (in seconds) from its first 
+        frame to its last, the number of blocks completed since statistics 
+        were started, and for 'ch1' and 'ch2', a dictionary of the exact 
+        sum, sum of squares, minimum, and maximum of the channel's samples 
+        with the mean, variance, standard deviation, and RMS formed from them 
+        (in ADC24 codes).
+        '''
+        if self.connected:
+            self.write('STATS:DATA?')
+            results = int(self.read(), 16)
+            payload = self.read_block()
+            if payload is None or len(payload) < 56:
+                return None
+            frames = int.from_bytes(payload[0:4], 'little')
+            stats = {'frames': frames, 
+                     'time': int.from_bytes(payload[4:8], 'little') / 16e6, 
+                     'results': results}
+            for i, name in enumerate(('ch1', 'ch2')):
+                part = payload[8 + 24 * i:32 + 24 * i]
+                total = int.from_bytes(part[0:8], 'little', signed = True)
+                sumsq = int.from_bytes(part[8:18], 'little')
+                ch = {'sum': total, 'sumsq': sumsq, 
+                      'min': int.from_bytes(part[18:21], 'little', signed = True), 
+                      'max': int.from_bytes(part[21:24], 'little', signed = True)}
+                if frames:
+                    variance = (sumsq * frames - total * total) / (frames * frames)
+                    ch['mean'] = total / frames
+                    ch['variance'] = variance
+                    ch['std'] = variance ** 0.5
+                    ch['rms'] = (sumsq / frames) ** 0.5
+                stats[name] = ch
+            return stats
+
+    hist_sources = ['adc24 ch1', 'adc24 ch2', 'adc16 ch1', 'adc16 ch2']
+
+    def hist_set(self, source = 'adc24 ch1', low = -32, shift = 0, bins = 64):
+        '''Set up the histogram: count samples of source (one of 
+        hist_sources) in bins (1 to 64) bins, each 2**shift codes wide 
+        (shift from 0 to 24), the first starting at code low.  Settings are 
+        ignored while the histogram runs.
+        '''
+        if self.connected:
+            if source in self.hist_sources:
+                self.write(f'HIST:SOURCE {self.hist_sources.index(source):X}')
+            low = int(low) & 0xFFFFFFFF
+            self.write(f'HIST:RANGE {low & 0xFFFF:X},{low >> 16:X},{int(shift):X},{int(bins):X}')
+
+    def hist_start(self):
+        if self.connected:
+            self.write('HIST:START')
+
+    def hist_stop(self):
+        if self.connected:
+            self.write('HIST:STOP')
+
+    hist_states = ['idle', 'running']
+
+    def hist_get_state(self):
+        '''Return the histogram's state and the number of samples counted 
+        since it was started.
+        '''
+        if self.connected:
+            self.write('HIST:STATE?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return self.hist_states[vals[0]], (vals[2] << 16) + vals[1]
+
+    def hist_read(self):
+        '''Return the histogram's counts as a list, one per bin, followed 
+        by the counts of samples below the first bin and beyond the last.
+        '''
+        if self.connected:
+            self.write('HIST:DATA?')
+            bins = int(self.read(), 16)
+            payload = self.read_block()
+            if payload is None:
+                return None
+            counts = [int.from_bytes(payload[i:i + 4], 'little') for i in range(0, len(payload), 4)]
+            return counts[2:], counts[0], counts[1]
+
+    fft_sources = hist_sources
+
+    def fft_set(self, source = 'adc24 ch1', shift = 0, averages = 16):
+        '''Set up the spectrum: take blocks of 128 samples of source (one 
+        of fft_sources), relative to the first sample and shifted right by 
+        shift bits (0 to 16) to fit in 16 bits, and average the power 
+        spectra of averages blocks, or with 0, of blocks until stopped.  
+        Settings are ignored while a spectrum is being taken.
+        '''
+        if self.connected:
+            if source in self.fft_sources:
+                self.write(f'FFT:SOURCE {self.fft_sources.index(source):X}')
+            self.write(f'FFT:SHIFT {int(shift):X}')
+            self.write(f'FFT:AVERAGES {int(averages):X}')
+
+    def fft_start(self):
+        if self.connected:
+            self.write('FFT:START')
+
+    def fft_stop(self):
+        if self.connected:
+            self.write('FFT:STOP')
+
+    fft_states = ['idle', 'running', 'done']
+
+    def fft_get_state(self):
+        '''Return the spectrum's state and the numbers of blocks averaged 
+        and samples clipped since it was started.
+        '''
+        if self.connected:
+            self.write('FFT:STATE?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return self.fft_states[vals[0]], vals[1], vals[2]
+
+    def fft_read(self, sample_rate = None):
+        '''Return the averaged spectrum as a dictionary holding the number 
+        of blocks averaged, the average power of each of the 64 bins (the 
+        mean |X[k]|**2 of the 128-point DFT of the Hann-windowed samples, in 
+        codes**2 of the source, taking the shift into account), and from it, 
+        the amplitude (in codes) of a sine centered on each bin.  With the 
+        source's sample rate (in S/s), it also holds the frequency of each 
+        bin (in Hz) and the noise spectral density of each bin (in codes / 
+        sqrt(Hz)).
+        '''
+        if self.connected:
+            self.write('FFT:SHIFT?')
+            shift = int(self.read(), 16)
+            self.write('FFT:DATA?')
+            blocks, exponent = [int(s, 16) for s in self.read().split(',')]
+            payload = self.read_block()
+            if payload is None:
+                return None
+            if exponent & 0x8000:
+                exponent -= 0x10000
+            n = 128
+            sums = [int.from_bytes(payload[i:i + 4], 'little') for i in range(0, len(payload), 4)]
+            scale = 4.**(exponent + shift) / blocks if blocks else 0.
+            power = [s * scale for s in sums]
+            # A Hann window has a coherent gain of 1/2 and a noise power gain of 3/8
+            spectrum = {'blocks': blocks, 'power': power, 
+                        'amplitude': [(2. if k else 1.) * p**0.5 / (n / 2) for k, p in enumerate(power)]}
+            if sample_rate:
+                spectrum['frequency'] = [k * sample_rate / n for k in range(len(power))]
+                spectrum['density'] = [((2. if k else 1.) * p / (sample_rate * n * 3 / 8))**0.5 
+                                       for k, p in enumerate(power)]
+            return spectrum
+
     def set_portd(self, val):
         if self.connected:
             self.write(f'DIGOUT:PORTD {int(val):X}')
@@ -453,3 +1412,106 @@ class smu_base:
         if self.connected:
             self.write('FLASH:ERASE {:X},{:X}'.format(int(address) >> 16, int(address) & 0xFFFF))
 
+    def flash_read_block(self, address, num_instructions):
+        if self.connected:
+            self.write('FLASH:READBIN {:X},{:X},{:X}'.format(int(address) >> 16, int(address) & 0xFFFF, int(num_instructions)))
+            return self.read_block()
+
+    def flash_write_row(self, address, data):
+        if self.connected:
+            if len(data) != 192 or int(address) & 0x7F:
+                return None
+            self.write('FLASH:WRITEBIN {:X},{:X}'.format(int(address) >> 16, int(address) & 0xFFFF))
+            self.write_block(data)
+            return int(self.read(), 16)
+
+    def flash_dump(self, address, num_instructions):
+        '''Read num_instructions instructions of program memory starting at 
+        the given (even) address, returned as bytes packed three per 
+        instruction (least-significant byte first).
+        '''
+        if self.connected:
+            data = b''
+            while num_instructions > 0:
+                count = min(num_instructions, 512)
+                block = self.flash_read_block(address, count)
+                if block is None:
+                    return None
+                data += block
+                address += 2 * count
+                num_instructions -= count
+            return data
+
+    def flash_set_serial(self, val):
+        '''Give the board the specified unit ID (a 32-bit number), which it
+        reports as its USB serial number from the next time that it is 
+        plugged in or reset.  The bootloader tools keep the unit ID when 
+        they write the firmware.
+        '''
+        if self.connected:
+            self.write('FLASH:SERIAL {:X},{:X}'.format(int(val) & 0xFFFF, (int(val) >> 16) & 0xFFFF))
+
+    def flash_get_serial(self):
+        if self.connected:
+            self.write('FLASH:SERIAL?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return (vals[1] << 16) + vals[0]
+
+    def flash_get_writable(self):
+        '''Return the first program memory address that the device lets the 
+        FLASH commands erase or write and the address past the last one.
+        '''
+        if self.connected:
+            self.write('FLASH:WRITABLE?')
+            vals = [int(s, 16) for s in self.read().split(',')]
+            return (vals[1] << 16) + vals[0], (vals[3] << 16) + vals[2]
+
+    def flash_write_region(self, address, data):
+        '''Write data (packed three bytes per instruction) to program memory 
+        starting at the given (even) address.  Each 512-instruction page 
+        touched is read, merged with the new data, erased, and rewritten a 
+        row at a time, skipping rows that are left blank.  Returns 0 on 
+        success, 5 (an address error) without erasing anything if a page 
+        lies outside flash_get_writable(), or the first nonzero status code 
+        replied by the device.
+        '''
+        if self.connected:
+            data = bytes(data)
+            end = address + 2 * (len(data) // 3)
+            page = address & ~0x3FF
+            first, last = self.flash_get_writable()
+            if page < first or end > last:
+                return 5
+            while page < end:
+                contents = self.flash_dump(page, 512)
+                if contents is None:
+                    return None
+                contents = bytearray(contents)
+                start = max(address, page)
+                stop = min(end, page + 0x400)
+                contents[3 * ((start - page) >> 1):3 * ((stop - page) >> 1)] = data[3 * ((start - address) >> 1):3 * ((stop - address) >> 1)]
+                self.flash_erase(page)
+                for row in range(8):
+                    row_data = bytes(contents[192 * row:192 * (row + 1)])
+                    if row_data != b'\xFF' * 192:
+                        status = self.flash_write_row(page + 0x80 * row, row_data)
+                        if status != 0:
+                            return status
+                page += 0x400
+            return 0
+
+def sync_group(master, slaves):
+    '''Synchronize a group of boards whose digital headers are wired together 
+    (RD0 to RD2 of the master to the same pins of each slave, with their 
+    grounds in common): make the slaves follow the master, so that their 
+    ADS1292s sample together, and mark a shared epoch for their timestamps.  
+    Returns True if every board saw the epoch.
+    '''
+    boards = [master] + list(slaves)
+    for slave in slaves:
+        slave.sync_set_mode('slave')
+    master.sync_set_mode('master')
+    before = [board.sync_get_epoch()[1] for board in boards]
+    master.sync_reset()
+    after = [board.sync_get_epoch()[1] for board in boards]
+    return all((a - b) % 65536 == 1 for a, b in zip(after, before))
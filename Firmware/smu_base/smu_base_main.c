@@ -2,6 +2,7 @@
 #include "parser.h"
 #include "usb.h"
 #include "cdc.h"
+#include "perf.h"
 
 void set_config_callback(void) {
     USB_setup_class_callback = cdc_setup_callback;
@@ -42,10 +43,16 @@ int16_t main(void) {
 //    }
 
     while (1) {
+        PERF_LOOP();
+
+        PERF_BEGIN(PERF_PARSER_STATE);
         parser_state();
+        PERF_END(PERF_PARSER_STATE);
 
 #ifndef USB_INTERRUPT
+        PERF_BEGIN(PERF_USB_SERVICE);
         usb_service();
+        PERF_END(PERF_USB_SERVICE);
 #endif
     }
 }
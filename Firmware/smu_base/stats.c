@@ -0,0 +1,109 @@
+#include "stats.h"
+#include "smu_base.h"
+
+uint32_t stats_frames, stats_window;
+uint16_t stats_state;
+STATS_RESULT_T stats_result;
+uint16_t stats_results;
+
+// The block under way and the time of its first frame
+STATS_RESULT_T stats_block;
+uint32_t stats_begin;
+
+void stats_clear(STATS_RESULT_T *block) {
+    uint16_t i;
+
+    block->frames = 0;
+    block->time = 0;
+    for (i = 0; i < 2; i++) {
+        block->ch[i].sum = 0;
+        block->ch[i].sumsq = 0;
+        block->ch[i].sumsq_hi = 0;
+        block->ch[i].min = 0;
+        block->ch[i].max = 0;
+    }
+}
+
+void init_stats(void) {
+    stats_frames = 1000;
+    stats_window = 0;
+    stats_state = STATS_IDLE;
+    stats_results = 0;
+    stats_clear(&stats_result);
+}
+
+// Sets the most frames in a block and the longest time that it spans, in
+// Timer2/3 ticks; returns 0, or 1 if both are 0
+uint16_t stats_set_limits(uint32_t frames, uint32_t window) {
+    if ((frames == 0) && (window == 0))
+        return 1;
+    stats_frames = frames;
+    stats_window = window;
+    return 0;
+}
+
+// Starts the ADS1292 and the first block, discarding any result from before
+void stats_start(void) {
+    stats_stop();
+
+    stats_clear(&stats_block);
+    stats_clear(&stats_result);
+    stats_results = 0;
+    stats_state = STATS_RUNNING;
+    adc24_start();
+}
+
+// Stops taking statistics, leaving the last result in place
+void stats_stop(void) {
+    if (stats_state == STATS_IDLE)
+        return;
+    stats_state = STATS_IDLE;
+    adc24_stop();
+}
+
+void stats_add(STATS_CHANNEL_T *ch, int32_t val) {
+    uint64_t sumsq;
+
+    if (stats_block.frames == 0) {
+        ch->min = val;
+        ch->max = val;
+    } else if (val < ch->min)
+        ch->min = val;
+    else if (val > ch->max)
+        ch->max = val;
+    ch->sum += val;
+    sumsq = ch->sumsq;
+    ch->sumsq += (uint64_t)((int64_t)val * val);
+    if (ch->sumsq < sumsq)
+        ch->sumsq_hi++;
+}
+
+// Returns 1 while statistics are running
+uint16_t stats_adc24_wanted(void) {
+    return (stats_state == STATS_IDLE) ? 0 : 1;
+}
+
+// Takes each ADC24 frame read while statistics are running, adding it to
+// the block under way and, at the end of the block, keeping it as the
+// latest result
+void stats_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    uint32_t now;
+
+    if (stats_state == STATS_IDLE)
+        return;
+
+    now = timer_read();
+    if (stats_block.frames == 0)
+        stats_begin = now;
+    stats_add(&stats_block.ch[0], ch1val);
+    stats_add(&stats_block.ch[1], ch2val);
+    stats_block.frames++;
+    stats_block.time = now - stats_begin;
+
+    if ((stats_frames && (stats_block.frames >= stats_frames)) ||
+        (stats_window && (stats_block.time >= stats_window))) {
+        stats_result = stats_block;
+        stats_results++;
+        stats_clear(&stats_block);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+
+// Running statistics of the ADC24: adds each frame to a block's count and
+// per-channel sum, sum of squares (80 bits), minimum, and maximum, and keeps
+// the block as the latest result after stats_frames frames or stats_window
+// ticks, whichever comes first (a limit of 0 is not applied).
+#define STATS_IDLE          0
+#define STATS_RUNNING       1
+
+typedef struct {
+    int64_t sum;
+    uint64_t sumsq;         // bits 0 to 63 of the sum of squares
+    uint16_t sumsq_hi;      //   and bits 64 to 79
+    int32_t min;
+    int32_t max;
+} STATS_CHANNEL_T;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t time;          // ticks from the first frame to the last
+    STATS_CHANNEL_T ch[2];
+} STATS_RESULT_T;
+
+// STATS:DATA? packs a result into 56 bytes: frames and time (4 each), then
+// per channel the sum (8), sum of squares (10), minimum and maximum (3 each)
+#define STATS_RESULT_LENGTH 56
+
+extern uint32_t stats_frames, stats_window;
+extern uint16_t stats_state;
+extern STATS_RESULT_T stats_result;
+extern uint16_t stats_results;
+
+void init_stats(void);
+uint16_t stats_set_limits(uint32_t frames, uint32_t window);
+void stats_start(void);
+void stats_stop(void);
+uint16_t stats_adc24_wanted(void);
+void stats_adc24_frame(int32_t ch1val, int32_t ch2val);
+
+#endif
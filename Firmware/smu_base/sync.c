@@ -0,0 +1,151 @@
+#include "sync.h"
+#include "smu_base.h"
+#include "pwm.h"
+#include "delay.h"
+
+uint16_t sync_mode;
+uint32_t sync_epoch;
+uint16_t sync_epochs;
+
+void init_sync(void) {
+    IEC1bits.INT2IE = 0;
+    IPC7bits.INT2IP = 6;    // above the paced ISRs, to relay START promptly
+    IEC3bits.INT3IE = 0;
+    IPC13bits.INT3IP = 6;
+
+    sync_mode = SYNC_OFF;
+    sync_epoch = 0;
+    sync_epochs = 0;
+}
+
+// Hands the sync pins back to DIGOUT as outputs, driven low, and puts the
+// ADS1292's clock back on FCY / 29.  A slave's Timer4 is put back as
+// init_pwm() leaves it, stopped and clocked by FCY, while a master's is
+// left alone, since its PWM channels may be running off it.
+void sync_release(void) {
+    uint8_t *RPOR;
+
+    IEC1bits.INT2IE = 0;
+    IEC3bits.INT3IE = 0;
+    OC8CON1 = 0;
+    if (sync_mode == SYNC_SLAVE) {
+        T4CON = 0x0000;
+        TMR4 = 0;
+        PR4 = 0xFFFF;
+    }
+
+    RPOR = (uint8_t *)&RPOR0;
+    __builtin_write_OSCCONL(OSCCON & 0xBF);
+    RPOR[RD0_RP] = 0;
+    __builtin_write_OSCCONL(OSCCON | 0x40);
+
+    LATD &= ~SYNC_PINS;
+    TRISD &= ~SYNC_PINS;
+
+    OC1CON1 = 0;
+    OC1CON2 = 0x001F;
+    OC1RS = 28;
+    OC1R = 14;
+    OC1CON1 = 0x1C06;       // OCTSEL = 111 (FCY), edge-aligned PWM
+}
+
+void sync_set_mode(uint16_t mode) {
+    uint8_t *RPOR, *RPINR;
+    uint16_t i;
+
+    if (mode > SYNC_SLAVE)
+        return;
+
+    if (sync_mode != SYNC_OFF) {
+        sync_release();
+        sync_mode = SYNC_OFF;
+        adc24_set_start(adc24_run_count ? 1 : 0);
+    }
+    if (mode == SYNC_OFF)
+        return;
+
+    // Free the sync pins of any PWM channels mapped onto them
+    for (i = 0; i < PWM_CHANNELS; i++)
+        if ((pwm_pin[i] != PWM_PIN_NONE) && ((1 << pwm_pin[i]) & SYNC_PINS))
+            pwm_assign(i, PWM_PIN_NONE);
+
+    RPOR = (uint8_t *)&RPOR0;
+    RPINR = (uint8_t *)&RPINR0;
+
+    if (mode == SYNC_MASTER) {
+        OC1CON1 = 0;
+        OC1RS = 27;
+        OC1R = 14;
+        OC1CON1 = 0x1C06;   // FCY / 28 to the ADS1292
+
+        OC8CON2 = 0x001F;
+        OC8RS = 13;
+        OC8R = 7;
+        OC8CON1 = 0x1C06;   // FCY / 14 to the slaves
+
+        __builtin_write_OSCCONL(OSCCON & 0xBF);
+        RPOR[RD0_RP] = OC8_RP;
+        __builtin_write_OSCCONL(OSCCON | 0x40);
+
+        sync_mode = SYNC_MASTER;
+        adc24_set_start(adc24_run_count ? 1 : 0);
+    } else {
+        pwm_stop();
+        TRISD |= SYNC_PINS;
+
+        __builtin_write_OSCCONL(OSCCON & 0xBF);
+        RPINR[T4CK_RP] = RD0_RP;
+        RPINR[INT2_RP] = RD1_RP;
+        RPINR[INT3_RP] = RD2_RP;
+        __builtin_write_OSCCONL(OSCCON | 0x40);
+
+        TMR4 = 0;
+        PR4 = 0xFFFF;
+        T4CON = 0x8302;     // TON = 1, TECS = 11 (T4CK), TCS = 1 (external)
+
+        OC1CON1 = 0;
+        OC1RS = 1;
+        OC1R = 1;
+        OC1CON1 = 0x0806;   // OCTSEL = 010 (Timer4), so half the master's
+                            //   clock to the ADS1292
+
+        ADC_START = SYNC_START_IN;
+        INTCON2bits.INT2EP = ADC_START;
+        IFS1bits.INT2IF = 0;
+        IEC1bits.INT2IE = 1;
+
+        INTCON2bits.INT3EP = 0;
+        IFS3bits.INT3IF = 0;
+        IEC3bits.INT3IE = 1;
+
+        sync_mode = SYNC_SLAVE;
+    }
+}
+
+// Marks a new epoch on a master and its slaves with a pulse on RD2
+void sync_reset(void) {
+    if (sync_mode != SYNC_MASTER)
+        return;
+
+    SYNC_RESET = 1;
+    sync_epoch = timer_read();
+    sync_epochs++;
+    delay_us(2);
+    SYNC_RESET = 0;
+}
+
+// Copies each edge of the master's START onto the ADS1292's START
+void __attribute__((interrupt, auto_psv)) _INT2Interrupt(void) {
+    IFS1bits.INT2IF = 0;            // lower INT2 interrupt flag
+
+    ADC_START = SYNC_START_IN;
+    INTCON2bits.INT2EP = ADC_START; // next, the opposite edge
+}
+
+// Records the time of the master's epoch pulse
+void __attribute__((interrupt, auto_psv)) _INT3Interrupt(void) {
+    IFS3bits.INT3IF = 0;            // lower INT3 interrupt flag
+
+    sync_epoch = timer_read();
+    sync_epochs++;
+}
@@ -0,0 +1,28 @@
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include <stdint.h>
+
+// Multi-board synchronization over the digital header: the master exports
+// the ADS1292 clock on RD0 (FCY / 14, halved by each slave's OC1), its START
+// on RD1 (copied by each slave's INT2 ISR), and SYNC:RESET epoch pulses on
+// RD2; the ADS1292s then run at FCY / 28.
+#define SYNC_OFF            0
+#define SYNC_MASTER         1
+#define SYNC_SLAVE          2
+
+#define SYNC_PINS           0x0007
+
+#define SYNC_START          LATDbits.LATD1
+#define SYNC_RESET          LATDbits.LATD2
+#define SYNC_START_IN       PORTDbits.RD1
+
+extern uint16_t sync_mode;
+extern uint32_t sync_epoch;
+extern uint16_t sync_epochs;
+
+void init_sync(void);
+void sync_set_mode(uint16_t mode);
+void sync_reset(void);
+
+#endif
@@ -0,0 +1,42 @@
+#include "trace.h"
+#include "hal.h"
+#include "smu_base.h"
+
+TRACE_RECORD_T trace_ring[TRACE_LENGTH];
+uint16_t trace_head, trace_count, trace_enabled;
+
+void init_trace(void) {
+    trace_clear();
+    trace_enabled = TRUE;
+}
+
+void trace_clear(void) {
+    disable_interrupts();
+    trace_head = 0;
+    trace_count = 0;
+    enable_interrupts();
+}
+
+void trace_log(uint16_t event, uint16_t arg) {
+    TRACE_RECORD_T *record;
+    uint16_t tail;
+
+    if (!trace_enabled)
+        return;
+
+    disable_interrupts();
+    tail = trace_head + trace_count;
+    if (tail >= TRACE_LENGTH)
+        tail -= TRACE_LENGTH;
+    record = &trace_ring[tail];
+    record->time = tmr23_read();
+    record->event = event;
+    record->arg = arg;
+    if (trace_count == TRACE_LENGTH) {
+        trace_head++;
+        if (trace_head == TRACE_LENGTH)
+            trace_head = 0;
+    } else
+        trace_count++;
+    enable_interrupts();
+}
@@ -0,0 +1,47 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+// Event trace: a ring of the most recent TRACE_LENGTH events logged by the 
+// USB, CDC, UART, parser, acquisition, flash, and timeout code, each stamped 
+// with the Timer2/3 timebase.  Logging is safe from ISRs and takes a few tens of 
+// cycles; when the ring is full, the oldest events are overwritten.
+#define TRACE_LENGTH        64
+
+// Trace events, with the meaning of each event's argument
+#define TRACE_MARK          0   // TRACE:MARK from a host; the value sent
+#define TRACE_USB_RESET     1   // USB bus reset; 0
+#define TRACE_USB_ERROR     2   // USB error; U1EIR
+#define TRACE_USB_STALL     3   // USB stall handshake sent; 0
+#define TRACE_USB_TRN       4   // USB transaction complete; U1STAT
+#define TRACE_CDC_TX        5   // CDC IN packet queued; its length
+#define TRACE_CDC_RX        6   // CDC OUT packet taken; its length
+#define TRACE_CDC_RX_FULL   7   // CDC OUT packet held back; its length
+#define TRACE_U1TX          8   // UART1 TX ISR; bytes sent
+#define TRACE_U1RX          9   // UART1 RX ISR; bytes received
+#define TRACE_DISPATCH      10  // command dispatched; channel (0 = CDC, 
+                                //   1 = BLE) << 8 | root table index, as
+                                //   listed by TRACE:COMMANDS?
+#define TRACE_ADC24_FRAME   11  // ADC24 stream frame read; its sequence number
+#define TRACE_FRAME_DROP    12  // ADC24 stream frame dropped; channel
+#define TRACE_FLASH_ERASE   13  // flash page erased; offset
+#define TRACE_FLASH_WRITE   14  // flash row written; offset
+#define TRACE_TIMEOUT       15  // spin-wait timed out; its TIMEOUT_* code
+#define TRACE_TRIGGER       16  // trigger fired; its TRIGGER_SRC_* source
+
+// TRACE:DUMP? sends the records as laid out here
+typedef struct {
+    uint32_t time;
+    uint16_t event;
+    uint16_t arg;
+} TRACE_RECORD_T;
+
+extern TRACE_RECORD_T trace_ring[TRACE_LENGTH];
+extern uint16_t trace_head, trace_count, trace_enabled;
+
+void init_trace(void);
+void trace_clear(void);
+void trace_log(uint16_t event, uint16_t arg);
+
+#endif
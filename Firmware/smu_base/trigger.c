@@ -0,0 +1,310 @@
+#include "trigger.h"
+#include "smu_base.h"
+#include "pwm.h"
+#include "patgen.h"
+#include "logic.h"
+#include "trace.h"
+
+TRIGGER_FRAME_T trigger_ring[TRIGGER_LENGTH];
+uint16_t trigger_source, trigger_edge, trigger_pin, trigger_channel;
+int32_t trigger_level;
+uint16_t trigger_mode, trigger_actions, trigger_out;
+uint16_t trigger_pre, trigger_post;
+uint32_t trigger_holdoff;
+volatile uint16_t trigger_state;
+uint16_t trigger_fires;
+uint16_t trigger_adc24;
+
+// State of an armed trigger: the settings latched by trigger_arm(), the
+// last level of SW1 or side of the ADC24 level seen (for finding edges),
+// the time at which it fired, whether its actions are still to start,
+// the ADC24 capture's oldest frame, number of frames, post-trigger frames
+// still to take, and number of the first frame after the trigger, and
+// whether the capture is still to be read
+uint16_t trigger_armed_source, trigger_armed_actions, trigger_armed_out;
+uint16_t trigger_last;
+uint32_t trigger_time;
+volatile uint16_t trigger_pending;
+uint16_t trigger_head, trigger_count, trigger_remaining, trigger_index;
+uint16_t trigger_unread;
+
+#define TRIGGER_LAST_UNKNOWN    0xFFFF
+#define TRIGGER_INDEX_NONE      0xFFFF
+
+void init_trigger(void) {
+    IEC1bits.INT1IE = 0;
+    IPC5bits.INT1IP = 5;    // level with the pattern generator and logic
+                            //   capture
+
+    trigger_source = TRIGGER_SRC_SOFT;
+    trigger_edge = TRIGGER_RISING;
+    trigger_pin = 0;
+    trigger_channel = 1;
+    trigger_level = 0;
+    trigger_mode = TRIGGER_SINGLE;
+    trigger_actions = 0;
+    trigger_out = TRIGGER_OUT_NONE;
+    trigger_holdoff = 0;
+    trigger_set_depth(TRIGGER_LENGTH / 4, TRIGGER_LENGTH - TRIGGER_LENGTH / 4);
+
+    trigger_armed_source = TRIGGER_SRC_SOFT;
+    trigger_armed_actions = 0;
+    trigger_armed_out = TRIGGER_OUT_NONE;
+    trigger_adc24 = FALSE;
+    trigger_fires = 0;
+    trigger_pending = FALSE;
+    trigger_count = 0;
+    trigger_index = TRIGGER_INDEX_NONE;
+    trigger_unread = FALSE;
+    trigger_state = TRIGGER_IDLE;
+}
+
+// Sets the most frames to keep from before the trigger and the frames to
+// take from the trigger on (at least 1), trimming the latter so that both
+// fit in the ring
+void trigger_set_depth(uint16_t pre, uint16_t post) {
+    if (pre > TRIGGER_LENGTH - 1)
+        pre = TRIGGER_LENGTH - 1;
+    if (post == 0)
+        post = 1;
+    if (post > TRIGGER_LENGTH - pre)
+        post = TRIGGER_LENGTH - pre;
+    trigger_pre = pre;
+    trigger_post = post;
+}
+
+void trigger_out_write(uint16_t level) {
+    uint16_t bit;
+
+    if (trigger_armed_out < 8) {
+        bit = 1 << trigger_armed_out;
+        LATD = level ? (LATD | bit) : (LATD & ~bit);
+    } else if (trigger_armed_out < 16) {
+        bit = 1 << (trigger_armed_out - 8);
+        LATE = level ? (LATE | bit) : (LATE & ~bit);
+    }
+}
+
+// Lets go of the INT1 input pin and of the ADS1292, leaving the trigger-out
+// pin as it is
+void trigger_release(void) {
+    IEC1bits.INT1IE = 0;
+    IFS1bits.INT1IF = 0;
+    if (trigger_armed_source == TRIGGER_SRC_PIN)
+        TRISD &= ~(1 << trigger_pin);
+    trigger_armed_source = TRIGGER_SRC_SOFT;
+
+    if (trigger_adc24) {
+        trigger_adc24 = FALSE;
+        adc24_stop();
+    }
+}
+
+// Starts waiting for the next trigger, discarding the last ADC24 capture
+void trigger_rearm(void) {
+    trigger_head = 0;
+    trigger_count = 0;
+    trigger_remaining = trigger_post;
+    trigger_index = TRIGGER_INDEX_NONE;
+    trigger_unread = (trigger_armed_actions & TRIGGER_ACTION_ADC24) ? TRUE : FALSE;
+    trigger_last = (trigger_armed_source == TRIGGER_SRC_SW1) ? (SW1 ? 1 : 0) : TRIGGER_LAST_UNKNOWN;
+    trigger_pending = FALSE;
+    trigger_out_write(0);
+    trigger_state = TRIGGER_ARMED;
+}
+
+void trigger_arm(void) {
+    uint8_t *RPINR;
+
+    trigger_stop();
+
+    trigger_armed_source = trigger_source;
+    trigger_armed_actions = trigger_actions & TRIGGER_ACTIONS_ALL;
+    trigger_armed_out = trigger_out;
+    if (trigger_armed_out < 8)
+        TRISD &= ~(1 << trigger_armed_out);
+    else if (trigger_armed_out < 16)
+        TRISE &= ~(1 << (trigger_armed_out - 8));
+
+    if ((trigger_armed_source == TRIGGER_SRC_ADC24) ||
+        (trigger_armed_actions & TRIGGER_ACTION_ADC24)) {
+        trigger_adc24 = TRUE;
+        adc24_start();
+    }
+
+    trigger_fires = 0;
+    trigger_rearm();
+
+    if (trigger_armed_source == TRIGGER_SRC_PIN) {
+        TRISD |= 1 << trigger_pin;
+
+        RPINR = (uint8_t *)&RPINR0;
+        __builtin_write_OSCCONL(OSCCON & 0xBF);
+        RPINR[INT1_RP] = pwm_pin_rp[trigger_pin];
+        __builtin_write_OSCCONL(OSCCON | 0x40);
+
+        INTCON2bits.INT1EP = (trigger_edge == TRIGGER_FALLING) ? 1 : 0;
+        IFS1bits.INT1IF = 0;
+        IEC1bits.INT1IE = 1;
+    }
+}
+
+// Disarms the trigger and lowers the trigger-out pin; actions that it has
+// started run on until stopped themselves
+void trigger_stop(void) {
+    trigger_release();
+    trigger_out_write(0);
+    trigger_state = TRIGGER_IDLE;
+}
+
+// Fires an armed trigger, leaving its trigger-out pin and actions to
+// trigger_act(); called from the INT1 ISR as well as from the main loop
+// (with INT1 held off)
+void trigger_fire(void) {
+    if (trigger_state != TRIGGER_ARMED)
+        return;
+
+    timer_stamp(TIMER_STAMP_TRIGGER);
+    trigger_time = timer_stamps[TIMER_STAMP_TRIGGER];
+    trigger_fires++;
+    trigger_pending = TRUE;
+    trigger_state = TRIGGER_FIRED;
+}
+
+// Raises the trigger-out pin and starts the actions of a trigger that has
+// fired since the last call; called from the main loop only
+void trigger_act(void) {
+    if (!trigger_pending)
+        return;
+    trigger_pending = FALSE;
+
+    trigger_out_write(1);
+    if (trigger_armed_actions & TRIGGER_ACTION_PWM)
+        pwm_start(pwm_mapped());
+    if (trigger_armed_actions & TRIGGER_ACTION_PATGEN)
+        patgen_start();
+    if (trigger_armed_actions & TRIGGER_ACTION_LOGIC)
+        logic_start();
+
+    trace_log(TRACE_TRIGGER, trigger_armed_source);
+}
+
+void trigger_force(void) {
+    uint16_t enabled;
+
+    enabled = IEC1bits.INT1IE;
+    IEC1bits.INT1IE = 0;
+    trigger_fire();
+    IEC1bits.INT1IE = enabled;
+    trigger_act();
+}
+
+// Starts the actions of a trigger fired by INT1, watches SW1 while armed,
+// and once fired, finishes the trigger when its ADC24 capture is complete
+// and the holdoff has passed (and, to re-arm, the capture has been read);
+// called from the main loop
+void trigger_service(void) {
+    uint16_t level;
+
+    trigger_act();
+
+    if (trigger_state == TRIGGER_ARMED) {
+        if (trigger_armed_source != TRIGGER_SRC_SW1)
+            return;
+        level = SW1 ? 1 : 0;
+        if ((level != trigger_last) && (level == trigger_edge))
+            trigger_force();
+        trigger_last = level;
+    } else if (trigger_state == TRIGGER_FIRED) {
+        if ((trigger_armed_actions & TRIGGER_ACTION_ADC24) && trigger_remaining)
+            return;
+        if (timer_read() - trigger_time < trigger_holdoff)
+            return;
+        if (trigger_mode == TRIGGER_AUTO) {
+            if (trigger_unread)
+                return;
+            trigger_rearm();
+        }
+        else {
+            trigger_release();
+            trigger_state = TRIGGER_DONE;
+        }
+    }
+}
+
+// Returns 1 while the trigger holds the ADS1292 running for its frames
+uint16_t trigger_adc24_wanted(void) {
+    return trigger_adc24 ? 1 : 0;
+}
+
+// Takes each ADC24 frame read while the trigger holds the ADS1292 running:
+// checks it against the level for an ADC24 source and keeps it in the ring
+// for the ADC24 action, dropping the oldest once trigger_pre frames are
+// held while armed
+void trigger_adc24_frame(int32_t ch1val, int32_t ch2val) {
+    uint16_t above, tail;
+
+    if (trigger_state == TRIGGER_ARMED) {
+        if (trigger_armed_source == TRIGGER_SRC_ADC24) {
+            above = (((trigger_channel == 2) ? ch2val : ch1val) >= trigger_level) ? 1 : 0;
+            if ((trigger_last != TRIGGER_LAST_UNKNOWN) && (above != trigger_last) &&
+                (above == trigger_edge))
+                trigger_force();
+            trigger_last = above;
+        }
+    }
+
+    if (!(trigger_armed_actions & TRIGGER_ACTION_ADC24))
+        return;
+
+    if (trigger_state == TRIGGER_ARMED) {
+        if (trigger_pre == 0)
+            return;
+        if (trigger_count == trigger_pre) {
+            trigger_head++;
+            if (trigger_head == TRIGGER_LENGTH)
+                trigger_head = 0;
+            trigger_count--;
+        }
+    } else if ((trigger_state == TRIGGER_FIRED) && trigger_remaining) {
+        if (trigger_index == TRIGGER_INDEX_NONE)
+            trigger_index = trigger_count;
+        trigger_remaining--;
+    } else
+        return;
+
+    tail = trigger_head + trigger_count;
+    if (tail >= TRIGGER_LENGTH)
+        tail -= TRIGGER_LENGTH;
+    trigger_ring[tail].ch1 = ch1val;
+    trigger_ring[tail].ch2 = ch2val;
+    trigger_count++;
+}
+
+// Finds the frames of the last complete ADC24 capture to send to a host:
+// the first one (as an index into trigger_ring) and the number of the first
+// frame after the trigger among them.  Returns the number of frames, or 0
+// while no capture is complete.
+uint16_t trigger_window(uint16_t *first, uint16_t *index) {
+    *first = trigger_head;
+    *index = trigger_index;
+    if ((trigger_state != TRIGGER_FIRED) && (trigger_state != TRIGGER_DONE))
+        return 0;
+    if (!(trigger_armed_actions & TRIGGER_ACTION_ADC24) || trigger_remaining)
+        return 0;
+    return trigger_count;
+}
+
+// Marks the last complete ADC24 capture as read, letting a trigger in
+// TRIGGER_AUTO mode re-arm
+void trigger_read(void) {
+    trigger_unread = FALSE;
+}
+
+// Fires the trigger on the selected edge of the header pin remapped onto
+// INT1
+void __attribute__((interrupt, auto_psv)) _INT1Interrupt(void) {
+    IFS1bits.INT1IF = 0;            // lower INT1 interrupt flag
+
+    trigger_fire();
+}
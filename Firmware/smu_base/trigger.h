@@ -0,0 +1,70 @@
+#ifndef _TRIGGER_H_
+#define _TRIGGER_H_
+
+#include <stdint.h>
+
+// Trigger: once armed, fires on an edge of a header pin (INT1), an edge of
+// SW1, an ADC24 level crossing, or TRIGGER:FORCE, and then the main loop
+// raises the trigger-out pin and starts the selected actions.  The ADC24
+// action keeps up to trigger_pre frames from before the trigger and
+// trigger_post frames from after it.
+#define TRIGGER_LENGTH      32
+
+#define TRIGGER_SRC_SOFT    0
+#define TRIGGER_SRC_PIN     1
+#define TRIGGER_SRC_SW1     2
+#define TRIGGER_SRC_ADC24   3
+
+#define TRIGGER_FALLING     0
+#define TRIGGER_RISING      1
+
+#define TRIGGER_SINGLE      0
+#define TRIGGER_AUTO        1
+
+// Actions started when the trigger fires: an ADC24 capture, the pattern
+// generator, a logic capture, and the PWM channels mapped onto pins
+#define TRIGGER_ACTION_ADC24    0x01
+#define TRIGGER_ACTION_PATGEN   0x02
+#define TRIGGER_ACTION_LOGIC    0x04
+#define TRIGGER_ACTION_PWM      0x08
+#define TRIGGER_ACTIONS_ALL     0x0F
+
+// The trigger-out pin is given by its bit number in a pattern generator
+// vector (0 to 6 for RD0 to RD6 and 8 to 14 for RE0 to RE6)
+#define TRIGGER_OUT_NONE    0xFFFF
+
+#define TRIGGER_IDLE        0
+#define TRIGGER_ARMED       1
+#define TRIGGER_FIRED       2
+#define TRIGGER_DONE        3
+
+// A captured frame goes out in the layout of an ADC24 stream frame
+#define TRIGGER_FRAME_LENGTH    6
+
+typedef struct {
+    int32_t ch1;
+    int32_t ch2;
+} TRIGGER_FRAME_T;
+
+extern TRIGGER_FRAME_T trigger_ring[TRIGGER_LENGTH];
+extern uint16_t trigger_source, trigger_edge, trigger_pin, trigger_channel;
+extern int32_t trigger_level;
+extern uint16_t trigger_mode, trigger_actions, trigger_out;
+extern uint16_t trigger_pre, trigger_post;
+extern uint32_t trigger_holdoff;
+extern volatile uint16_t trigger_state;
+extern uint16_t trigger_fires;
+extern uint16_t trigger_adc24;
+
+void init_trigger(void);
+void trigger_set_depth(uint16_t pre, uint16_t post);
+void trigger_arm(void);
+void trigger_stop(void);
+void trigger_force(void);
+void trigger_service(void);
+uint16_t trigger_adc24_wanted(void);
+void trigger_adc24_frame(int32_t ch1val, int32_t ch2val);
+uint16_t trigger_window(uint16_t *first, uint16_t *index);
+void trigger_read(void);
+
+#endif
@@ -1,5 +1,8 @@
 #include "pic24fj.h"
 #include "usb.h"
+#include "hal.h"
+#include "trace.h"
+#include "delay.h"
 
 BUFDESC __attribute__ ((aligned (512))) BD[32];
 
@@ -14,6 +17,8 @@ uint8_t USB_curr_config;
 uint8_t USB_device_status;
 uint8_t USB_USTAT;
 uint8_t USB_USWSTAT;
+uint16_t USB_sof_frame;
+uint32_t USB_sof_time;
 
 USB_CALLBACK_T USB_set_config_callback = (USB_CALLBACK_T)NULL;
 USB_CALLBACK_T USB_get_descriptor_callback = (USB_CALLBACK_T)NULL;
@@ -55,6 +60,8 @@ void usb_set_address_callback(void) {
 }
 
 void init_usb(void) {
+    TIMEOUT_T timeout;
+
     IEC5bits.USB1IE = 0;                    // disable USB interrupt
 
     U1CONbits.PPBRST = 1;
@@ -82,7 +89,13 @@ void init_usb(void) {
     USB_request.setup.bRequest = NO_REQUEST;
     USB_request.bytes_left.w = 0;
     USB_request.done_callback = (USB_CALLBACK_T)NULL;
-    while (U1CONbits.SE0) {}
+    timeout_start(&timeout, TIMEOUT_USB_SE0_US);
+    while (U1CONbits.SE0) {
+        if (timeout_expired(&timeout)) {
+            timeout_error(TIMEOUT_USB_SE0);
+            break;
+        }
+    }
 
 #ifdef USB_INTERRUPT
     U1IE = 0xFF;
@@ -97,9 +110,12 @@ void usb_service(void) {
     uint8_t ep;
 
     if (U1IRbits.UERRIF) {
+        trace_log(TRACE_USB_ERROR, U1EIR);
         U1EIR = 0xFF;                       // clear all flags in U1EIR to clear U1EIR
         U1IR = U1IR_UERRIF;                 // clear UERRIF
     } else if (U1IRbits.SOFIF) {
+        USB_sof_time = tmr23_read();        // timestamp the start of frame
+        USB_sof_frame = ((uint16_t)U1FRMH << 8) | U1FRML;
         U1IR = U1IR_SOFIF;                  // clear SOFIF
     } else if (U1IRbits.IDLEIF) {
         U1IR = U1IR_IDLEIF;                 // clear IDLEIF
@@ -108,8 +124,10 @@ void usb_service(void) {
         U1IR = U1IR_RESUMEIF;               // clear RESUMEIF
 //      U1PWRCbits.USUSPND = 0;             // resume USB module operation
     } else if (U1IRbits.STALLIF) {
+        trace_log(TRACE_USB_STALL, 0);
         U1IR = U1IR_STALLIF;                // clear STALLIF
     } else if (U1IRbits.URSTIF) {
+        trace_log(TRACE_USB_RESET, 0);
         USB_curr_config = 0;
         while (U1IRbits.TRNIF) {
             U1IR = U1IR_TRNIF;              // clear TRNIF to advance the U1STAT FIFO
@@ -138,6 +156,7 @@ void usb_service(void) {
         USB_buffer_desc.bytecount = buf_desc_ptr->bytecount;
         USB_buffer_desc.address = buf_desc_ptr->address;
         USB_USTAT = U1STAT;                 // save the USB status register
+        trace_log(TRACE_USB_TRN, USB_USTAT);
         U1IR = U1IR_TRNIF;                  // clear TRNIF
         USB_error_flags = 0;                // clear USB error flags
         switch (USB_buffer_desc.status & 0x3C) {    // extract PID bits
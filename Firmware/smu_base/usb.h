@@ -7,7 +7,7 @@
 
 #define NUM_CONFIGURATIONS      1
 #define NUM_INTERFACES          2
-#define NUM_STRINGS             3
+#define NUM_STRINGS             4
 #define MAX_PACKET_SIZE         64      // maximum packet size for low-speed peripherals is 8 bytes, for full-speed peripherals it can be 8, 16, 32, or 64 bytes
 
 // states that the USB interface can be in
@@ -167,6 +167,12 @@ extern uint8_t USB_device_status;
 extern uint8_t USB_USTAT;
 extern uint8_t USB_USWSTAT;
 
+// Frame number of the latest USB start-of-frame packet and the Timer2/3 time 
+// at which usb_service() saw it, for relating the device's timebase to the 
+// host's 1-kHz frame clock
+extern uint16_t USB_sof_frame;
+extern uint32_t USB_sof_time;
+
 extern USB_CALLBACK_T USB_set_config_callback;
 extern USB_CALLBACK_T USB_get_descriptor_callback;
 extern USB_CALLBACK_T USB_setup_class_callback;
@@ -174,9 +180,15 @@ extern USB_CALLBACK_T USB_setup_vendor_callback;
 extern USB_CALLBACK_T USB_in_callbacks[];
 extern USB_CALLBACK_T USB_out_callbacks[];
 
-extern uint8_t __attribute__ ((space(auto_psv))) Device[];
+// Offset of iSerialNumber in the device descriptor, and the string that it 
+// names while the board has a serial number
+#define DEVICE_SERIAL_INDEX 16
+#define DEVICE_SERIAL_STRING    3
+
+extern uint8_t Device[];
 extern uint8_t __attribute__ ((space(auto_psv))) *Configurations[];
 extern uint8_t __attribute__ ((space(auto_psv))) *Strings[];
+extern uint8_t String3[];
 
 extern void init_usb(void);
 extern void usb_service(void);
@@ -0,0 +1,202 @@
+
+import asyncio
+import threading
+from bleak import BleakClient, BleakScanner
+from bleak.exc import BleakError
+from itertools import count, takewhile
+
+UART_SERVICE_UUID = '49535343-fe7d-4ae5-8fa9-9fafd205e455'
+UART_RX_CHAR_UUID = '49535343-8841-43f4-a8d4-ecbe34729bb3'
+UART_TX_CHAR_UUID = '49535343-1e4d-4bd9-ba61-23c647249616'
+
+def packetize(data, n):
+    return takewhile(len, (data[i : i + n] for i in count(0, n)))
+
+async def find_uart_device(name = '', timeout = 10.):
+    '''Scan for a BLE device supporting the Microchip UART service.
+
+    If name is given, it is matched against both the advertised name and the
+    address of each device seen.  Otherwise, the first device advertising the
+    UART service is returned, falling back to connecting to each device in
+    turn to inspect its services (as mcp_uart_service.py does), because the
+    RN4871 does not always include the service UUID in its advertisements.
+    '''
+    devices = await BleakScanner.discover(timeout = timeout, return_adv = True)
+
+    for device, adv_data in devices.values():
+        if name != '':
+            if (device.name == name) or (device.address.upper() == name.upper()):
+                return device
+        elif UART_SERVICE_UUID in adv_data.service_uuids:
+            return device
+
+    if name == '':
+        for device, adv_data in devices.values():
+            try:
+                async with BleakClient(device, timeout = 2.) as client:
+                    if client.services.get_service(UART_SERVICE_UUID) is not None:
+                        return device
+            except (asyncio.TimeoutError, BleakError):
+                pass
+
+    return None
+
+class ble_uart:
+    '''Asynchronous client for the RN4871 transparent UART service.
+
+    Writes are split into packets of max_write_without_response_size bytes
+    and queued to a writer task that issues them back to back as write
+    without response requests, so a caller never waits on a round trip per
+    packet.  Notifications from the TX characteristic are appended to a
+    receive buffer from which replies are assembled by read() and readline().
+    '''
+
+    def __init__(self, device):
+        self.device = device
+        self.client = None
+        self.connected = False
+        self.rx_char = None
+        self.packet_size = 20
+        self.rx_buffer = bytearray()
+        self.rx_event = asyncio.Event()
+        self.tx_queue = asyncio.Queue()
+        self.tx_task = None
+
+    def disconnect_callback(self, client):
+        self.connected = False
+        self.rx_event.set()
+
+    def rx_callback(self, ch, data):
+        self.rx_buffer += data
+        self.rx_event.set()
+
+    async def tx_worker(self):
+        while True:
+            packet = await self.tx_queue.get()
+            try:
+                await self.client.write_gatt_char(self.rx_char, packet, response = False)
+            except BleakError:
+                pass
+            self.tx_queue.task_done()
+
+    async def connect(self, timeout = 10.):
+        self.client = BleakClient(self.device, disconnected_callback = self.disconnect_callback, timeout = timeout)
+        await self.client.connect()
+        await self.client.start_notify(UART_TX_CHAR_UUID, self.rx_callback)
+        uart_service = self.client.services.get_service(UART_SERVICE_UUID)
+        self.rx_char = uart_service.get_characteristic(UART_RX_CHAR_UUID)
+        self.packet_size = self.rx_char.max_write_without_response_size
+        self.tx_task = asyncio.create_task(self.tx_worker())
+        self.connected = True
+
+    async def disconnect(self):
+        if self.tx_task is not None:
+            self.tx_task.cancel()
+            self.tx_task = None
+        if self.client is not None:
+            await self.client.disconnect()
+        self.connected = False
+
+    def write_nowait(self, data):
+        for packet in packetize(bytes(data), self.packet_size):
+            self.tx_queue.put_nowait(packet)
+
+    async def write(self, data):
+        self.write_nowait(data)
+
+    async def flush(self):
+        await self.tx_queue.join()
+
+    async def wait_for(self, done, timeout):
+        loop = asyncio.get_running_loop()
+        deadline = None if timeout is None else loop.time() + timeout
+        while not done() and self.connected:
+            self.rx_event.clear()
+            if deadline is None:
+                await self.rx_event.wait()
+            else:
+                remaining = deadline - loop.time()
+                if remaining <= 0.:
+                    break
+                try:
+                    await asyncio.wait_for(self.rx_event.wait(), remaining)
+                except asyncio.TimeoutError:
+                    break
+
+    async def read(self, size = 1, timeout = None):
+        await self.wait_for(lambda: len(self.rx_buffer) >= size, timeout)
+        data = bytes(self.rx_buffer[:size])
+        del self.rx_buffer[:size]
+        return data
+
+    async def readline(self, timeout = None):
+        await self.wait_for(lambda: b'\n' in self.rx_buffer, timeout)
+        end = self.rx_buffer.find(b'\n')
+        end = len(self.rx_buffer) if end < 0 else end + 1
+        data = bytes(self.rx_buffer[:end])
+        del self.rx_buffer[:end]
+        return data
+
+    def in_waiting(self):
+        return len(self.rx_buffer)
+
+    def reset_input_buffer(self):
+        self.rx_buffer.clear()
+
+class ble_serial:
+    '''Blocking, pyserial-like wrapper around ble_uart.
+
+    The asyncio event loop that runs the BLE client lives in a background
+    thread, so an instance can stand in for a serial.Serial object (e.g., as
+    the dev attribute of an smu_base object) without the caller having to
+    be written as a coroutine.
+    '''
+
+    def __init__(self, name = '', timeout = None, scan_timeout = 10.):
+        self.timeout = timeout
+        self.loop = asyncio.new_event_loop()
+        self.thread = threading.Thread(target = self.loop.run_forever, daemon = True)
+        self.thread.start()
+        self.uart = None
+        device = self.run(find_uart_device(name, scan_timeout))
+        if device is None:
+            raise BleakError(f'No BLE device found supporting the Microchip UART service{" named " + name if name != "" else ""}.')
+        self.uart = self.run(self.create_uart(device))
+        self.run(self.uart.connect())
+        self.name = device.name
+
+    async def create_uart(self, device):
+        return ble_uart(device)
+
+    def run(self, coro):
+        return asyncio.run_coroutine_threadsafe(coro, self.loop).result()
+
+    @property
+    def is_open(self):
+        return self.uart is not None and self.uart.connected
+
+    @property
+    def in_waiting(self):
+        return self.uart.in_waiting()
+
+    def write(self, data):
+        self.loop.call_soon_threadsafe(self.uart.write_nowait, bytes(data))
+        return len(data)
+
+    def flush(self):
+        self.run(self.uart.flush())
+
+    def read(self, size = 1):
+        return self.run(self.uart.read(size, self.timeout))
+
+    def readline(self):
+        return self.run(self.uart.readline(self.timeout))
+
+    def reset_input_buffer(self):
+        self.loop.call_soon_threadsafe(self.uart.reset_input_buffer)
+
+    def close(self):
+        if self.uart is not None:
+            self.run(self.uart.disconnect())
+            self.uart = None
+        self.loop.call_soon_threadsafe(self.loop.stop)
@@ -0,0 +1,102 @@
+import heapq
+from concurrent.futures import ThreadPoolExecutor
+from smu_base import smu_base, find_boards, board_name, sync_group
+
+TICKS_PER_SECOND = 16e6
+
+class smu_manager:
+    '''Drives all of the boards connected by USB at once.
+
+    Each board is opened as an smu_base and known by its USB serial number
+    (its unit ID), or by its port name if its unit ID has not been set.
+    Calls on all of the boards run in parallel, one thread per board, since
+    the serial I/O of each one blocks while it waits on its own board; a
+    rack of boards thus takes about as long as one board does.  Results are
+    returned as dictionaries keyed by serial number.
+    '''
+
+    def __init__(self, serials = None):
+        '''Open the boards with the specified serial numbers, or all of the
+        boards found if serials is None.
+        '''
+        ports = {}
+        for device in find_boards():
+            name = board_name(device)
+            if serials is None or name in serials:
+                ports[name] = device.device
+        self.pool = ThreadPoolExecutor(max_workers = max(len(ports), 1))
+        boards = self.map_ports(ports, smu_base)
+        self.boards = {name: board for name, board in boards.items() if board.connected}
+        self.origins = {}
+
+    def map_ports(self, items, func):
+        futures = {name: self.pool.submit(func, item) for name, item in items.items()}
+        return {name: future.result() for name, future in futures.items()}
+
+    def close(self):
+        for board in self.boards.values():
+            board.dev.close()
+        self.boards = {}
+        self.pool.shutdown()
+
+    def serials(self):
+        return list(self.boards)
+
+    def map(self, func, *args, **kwargs):
+        '''Call func(board, *args, **kwargs) on every board in parallel and
+        return the results.
+        '''
+        return self.map_ports(self.boards, lambda board: func(board, *args, **kwargs))
+
+    def call(self, method, *args, **kwargs):
+        '''Call the smu_base method of the specified name on every board in
+        parallel and return the results, e.g., call('adc24_get_both').
+        '''
+        return self.map(lambda board: getattr(board, method)(*args, **kwargs))
+
+    def sync(self, master):
+        '''Make the board with the specified serial number the sync master
+        of the others (see sync_group), after which stream() puts the frames
+        of all of the boards on the time axis of the shared epoch.  Returns
+        True if every board saw the epoch.
+        '''
+        slaves = [board for name, board in self.boards.items() if name != master]
+        if not sync_group(self.boards[master], slaves):
+            return False
+        self.origins = self.map(lambda board: (board.sync_get_epoch()[0], 0.))
+        return True
+
+    def correlate(self):
+        '''Relate each board's timebase to host time (see time_correlate),
+        after which stream() puts the frames of all of the boards on the host's
+        time axis, to within the round trip time of the correlation.
+        '''
+        correlations = self.call('time_correlate')
+        self.origins = {name: (c['device'], c['host']) for name, c in correlations.items()}
+
+    def board_time(self, name, ticks):
+        origin, offset = self.origins[name]
+        return offset + ((ticks - origin) % 2**32) / TICKS_PER_SECOND
+
+    def stream(self, num_frames):
+        '''Take num_frames timed ADC24 stream frames from every board in
+        parallel and return them merged in order of time, each as a list of
+        the form [time, serial, seq, ch1, ch2], with time in seconds on the
+        axis set by sync() or correlate() (whichever was called last;
+        correlate() is called first if neither has been).  Frames of boards
+        that are not synchronized are ordered only to within the error of
+        the correlation.
+        '''
+        if not self.origins:
+            self.correlate()
+
+        def take(board):
+            board.adc24_stream_start(timed = True)
+            frames = board.adc24_stream_read(num_frames)
+            board.adc24_stream_stop()
+            return frames
+
+        frames = self.map(take)
+        runs = [[[self.board_time(name, frame[3]), name] + frame[:3] for frame in run]
+                for name, run in frames.items()]
+        return list(heapq.merge(*runs, key = lambda frame: frame[0]))
@@ -0,0 +1,79 @@
+
+import sys
+from smu_base import smu_base
+
+# Event codes and names, as defined in trace.h
+EVENTS = ['MARK', 'USB_RESET', 'USB_ERROR', 'USB_STALL', 'USB_TRN', 'CDC_TX',
+          'CDC_RX', 'CDC_RX_FULL', 'U1TX', 'U1RX', 'DISPATCH', 'ADC24_FRAME',
+          'FRAME_DROP', 'FLASH_ERASE', 'FLASH_WRITE', 'TIMEOUT', 'TRIGGER']
+
+# Waits that can time out, as defined in delay.h
+TIMEOUTS = ['SPI1', 'SPI2', 'SDADC', 'DRDY', 'NVM', 'U1TX', 'U1RX', 'USB_SE0']
+
+# Trigger sources, as defined in trigger.h
+TRIGGER_SOURCES = ['SOFT', 'PIN', 'SW1', 'ADC24']
+
+# Commands in the order of the firmware's root dispatch table (parser.c),
+# used if the device cannot list them (TRACE:COMMANDS?)
+ROOT_COMMANDS = ['UI', 'PWR', 'DAC10', 'DAC16', 'ADC16', 'ADC24', 'DIGOUT',
+                 'BLE', 'FLASH', 'BENCH', 'PERF', 'PERF?', 'TRACE',
+                 'TIME', 'TIME?', 'PWM', 'PATGEN', 'LOGIC', 'TRIGGER', 'SYNC',
+                 'LOCKIN', 'PULSE', 'STATS', 'HIST', 'FFT']
+
+TICKS_PER_US = 16
+
+def describe(event, arg, commands = ROOT_COMMANDS):
+    name = EVENTS[event] if event < len(EVENTS) else f'EVENT_{event}'
+    if name == 'USB_TRN':
+        detail = 'EP{} {}'.format(arg >> 4, 'IN' if arg & 0x08 else 'OUT')
+    elif name == 'DISPATCH':
+        index = arg & 0xFF
+        command = commands[index] if index < len(commands) else f'#{index}'
+        detail = '{} from {}'.format(command, 'BLE' if arg >> 8 else 'CDC')
+    elif name == 'FRAME_DROP':
+        detail = 'BLE' if arg else 'CDC'
+    elif name == 'TIMEOUT':
+        detail = TIMEOUTS[arg] if arg < len(TIMEOUTS) else f'#{arg}'
+    elif name == 'TRIGGER':
+        detail = TRIGGER_SOURCES[arg] if arg < len(TRIGGER_SOURCES) else f'#{arg}'
+    elif name in ('USB_ERROR', 'FLASH_ERASE', 'FLASH_WRITE'):
+        detail = f'0x{arg:04X}'
+    elif name in ('USB_RESET', 'USB_STALL'):
+        detail = ''
+    else:
+        detail = str(arg)
+    return name, detail
+
+def timeline(records, commands = ROOT_COMMANDS):
+    '''Return the trace records (as returned by smu_base.trace_dump()) as
+    lines of a timeline, giving each event's time in microseconds since the
+    first event and since the previous one, and naming dispatched commands
+    from commands (as returned by smu_base.trace_commands()).  The 32-bit
+    timebase rolls over every 268 s, so gaps between events are taken modulo
+    2**32 cycles.
+    '''
+    lines = []
+    elapsed = 0
+    for i, (time, event, arg) in enumerate(records):
+        delta = (time - records[i - 1][0]) & 0xFFFFFFFF if i else 0
+        elapsed += delta
+        name, detail = describe(event, arg, commands)
+        lines.append('{:14.3f} {:+12.3f}  {:<12s} {}'.format(elapsed / TICKS_PER_US,
+                                                          delta / TICKS_PER_US, name, detail))
+    return lines
+
+if __name__ == '__main__':
+    dev = smu_base(sys.argv[1] if len(sys.argv) > 1 else '')
+    if not dev.connected:
+        print('No device found.')
+        sys.exit(1)
+    records = dev.trace_dump()
+    if records is None:
+        print('Trace dump failed.')
+        sys.exit(1)
+    commands = dev.trace_commands()
+    if commands is None:
+        commands = ROOT_COMMANDS
+    print('{:>14s} {:>12s}  {}'.format('time (us)', 'delta (us)', 'event'))
+    for line in timeline(records, commands):
+        print(line)